@@ -0,0 +1,37 @@
+#version 460
+
+//In (position only stream)
+layout(location = 0) in vec3 position;
+
+//Out
+//Same transform as mesh.vert, both invariant so the depths are identical
+invariant gl_Position;
+
+//Constants
+
+layout(set = 0,binding = 0) uniform CameraBuffer{
+	mat4 view_proj; //view_proj = proj * view
+} camera;
+
+
+struct RenderEntity{
+	mat4 model;
+	mat4 normal; //inverse transpose of model
+};
+
+layout(std140,set = 0,binding = 2) readonly buffer ObjectTransforms{
+	RenderEntity data[];
+} objects;
+
+//Compacted list of objects that passed culling
+layout(std430,set = 0,binding = 6) readonly buffer VisibleObjects{
+	uint indices[];
+} visible;
+
+
+void main()
+{
+	uint object = visible.indices[gl_InstanceIndex];
+	mat4 model = objects.data[object].model;
+	gl_Position = camera.view_proj  * model * vec4(position,1.0);
+}
@@ -0,0 +1,38 @@
+#version 450
+
+//In
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoords;
+
+
+//Out (G-buffer)
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec4 outSpecular;
+layout(location = 2) out vec4 outNormal;
+
+//Specialization constants
+//Without a specular map the material's specular color is used
+layout(constant_id = 0) const bool SPECULAR_MAP = true;
+
+//Constants
+
+layout(std140,set = 0,binding = 3) uniform Material{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 shiny;
+} material;
+
+layout(set = 0,binding = 4) uniform sampler2D texDiffuse;
+layout(set = 0,binding = 5) uniform sampler2D texSpecular;
+
+
+void main()
+{
+	outAlbedo = vec4(texture(texDiffuse,inTexCoords).xyz,1.0);
+	//Shininess scales the specular term, kept next to the specular color
+	vec3 specular = SPECULAR_MAP ? texture(texSpecular,inTexCoords).xyz : material.specular.xyz;
+	outSpecular = vec4(specular,material.shiny.x);
+	outNormal = vec4(normalize(inNormal),0.0);
+}
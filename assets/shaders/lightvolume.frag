@@ -0,0 +1,93 @@
+#version 450
+
+//In
+layout(location = 0) flat in int inLight;
+layout(location = 1) noperspective in vec2 inNdc;
+
+//Out
+layout(location = 0) out vec4 outColor;
+
+//Specialization constants
+//Same attenuation models as mesh.frag
+layout(constant_id = 0) const int ATTENUATION = 0;
+
+//Constants
+
+layout(set = 0,binding = 0) uniform CameraBuffer{
+	mat4 view_proj; //view_proj = proj * view
+	vec4 eye;
+	vec4 forward;
+	mat4 inv_view_proj;
+} camera;
+
+struct LightEntity{ 
+	vec4 position;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float constant;
+	float linear;
+	float quad;
+	float radius;
+};
+
+layout(std140,set = 0,binding = 1) readonly buffer LightsBuffer{
+	LightEntity data[];
+} lights;
+
+//G-buffer, read from tile memory
+layout(input_attachment_index = 0,set = 0,binding = 2) uniform subpassInput gAlbedo;
+layout(input_attachment_index = 1,set = 0,binding = 3) uniform subpassInput gSpecular;
+layout(input_attachment_index = 2,set = 0,binding = 4) uniform subpassInput gNormal;
+layout(input_attachment_index = 3,set = 0,binding = 5) uniform subpassInput gDepth;
+
+
+void main()
+{
+	float depth = subpassLoad(gDepth).r;
+
+	//Nothing drawn here
+	if (depth >= 1.0) {
+		discard;
+	}
+
+	vec4 world = camera.inv_view_proj * vec4(inNdc,depth,1.0);
+	vec3 position = world.xyz / world.w;
+
+	vec3 dl = lights.data[inLight].position.xyz - position;
+	float len = length(dl);
+
+	if (len >= lights.data[inLight].radius) {
+		discard;
+	}
+
+	vec3 albedo = subpassLoad(gAlbedo).xyz;
+	vec4 specular_shiny = subpassLoad(gSpecular);
+	vec3 normal = subpassLoad(gNormal).xyz;
+
+	//Same terms as mesh.frag
+	vec3 dx = dl / len;
+	vec3 eye_dir = normalize(camera.eye.xyz - position);
+	vec3 light_bounce_dir = normalize(reflect(-dx,normal));
+
+	float ambient_factor = 0.3;
+	float diffuse_factor = max(0,dot(normal,dx));
+	float specular_factor = pow(max(dot(light_bounce_dir,eye_dir),0),64) * specular_shiny.w;
+
+	vec3 ambient = lights.data[inLight].ambient.xyz * albedo * ambient_factor;
+	vec3 diffuse = lights.data[inLight].diffuse.xyz * albedo * diffuse_factor;
+	vec3 specular = lights.data[inLight].specular.xyz * specular_shiny.xyz * specular_factor;
+
+	float falloff;
+	if (ATTENUATION == 1) {
+		falloff = 1.0 / (1.0 + lights.data[inLight].quad * len * len);
+	}
+	else {
+		falloff = 1.0 / (lights.data[inLight].constant + lights.data[inLight].linear * len + lights.data[inLight].quad * len * len);
+	}
+
+	float window = clamp(1.0 - pow(len / lights.data[inLight].radius,4.0),0.0,1.0);
+	falloff *= window * window;
+
+	outColor = vec4(falloff * (ambient + diffuse + specular),0.0);
+}
@@ -0,0 +1,74 @@
+#version 460
+
+//Out
+layout(location = 0) flat out int outLight;
+//Ndc of the fragment, interpolated in screen space
+layout(location = 1) noperspective out vec2 outNdc;
+
+//Constants
+layout(set = 0,binding = 0) uniform CameraBuffer{
+	mat4 view_proj; //view_proj = proj * view
+} camera;
+
+struct LightEntity{ 
+	vec4 position;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float constant;
+	float linear;
+	float quad;
+	float radius;
+};
+
+layout(std140,set = 0,binding = 1) readonly buffer LightsBuffer{
+	LightEntity data[];
+} lights;
+
+layout( push_constant ) uniform constants
+{
+	mat4 view;
+	mat4 proj;
+} params;
+
+//Two triangles over the light's screen rectangle
+const vec2 CORNERS[6] = vec2[](
+	vec2(0.0,0.0),vec2(1.0,0.0),vec2(1.0,1.0),
+	vec2(0.0,0.0),vec2(1.0,1.0),vec2(0.0,1.0)
+);
+
+void main()
+{
+	vec3 center = (params.view * vec4(lights.data[gl_InstanceIndex].position.xyz,1.0)).xyz;
+	float depth = -center.z;
+	float radius = lights.data[gl_InstanceIndex].radius;
+	float z_near = params.proj[3][2] / params.proj[2][2];
+
+	//Whole screen at the near plane when the camera is (nearly) inside the sphere
+	vec2 lo = vec2(-1.0);
+	vec2 hi = vec2(1.0);
+	float front = z_near;
+
+	if (depth - radius > z_near) {
+		//Screen bounds of the box around the sphere, extremes are at its corners
+		vec2 p = vec2(params.proj[0][0],params.proj[1][1]);
+		float d0 = depth - radius;
+		float d1 = depth + radius;
+		vec2 a = p * (center.xy - radius) / d0;
+		vec2 b = p * (center.xy + radius) / d0;
+		vec2 c = p * (center.xy - radius) / d1;
+		vec2 d = p * (center.xy + radius) / d1;
+
+		lo = max(min(min(a,b),min(c,d)),vec2(-1.0));
+		hi = min(max(max(a,b),max(c,d)),vec2(1.0));
+		front = d0;
+	}
+
+	//Depth of the sphere's closest point, geometry in front of it can't be lit
+	vec4 clip = params.proj * vec4(0.0,0.0,-front,1.0);
+
+	vec2 ndc = mix(lo,hi,CORNERS[gl_VertexIndex]);
+	gl_Position = vec4(ndc,clip.z / clip.w,1.0);
+	outLight = gl_InstanceIndex;
+	outNdc = ndc;
+}
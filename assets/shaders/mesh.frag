@@ -9,11 +9,21 @@ layout(location = 2) in vec2 inTexCoords;
 //Out
 layout(location = 0) out vec4 outColor;
 
+//Specialization constants
+layout(constant_id = 0) const bool CLUSTERED_LIGHTING = true;
+//Brute force loop bound, 0 = push_constants.num_lights
+layout(constant_id = 1) const int LIGHT_COUNT = 0;
+//Without a specular map the material's specular color is used
+layout(constant_id = 2) const bool SPECULAR_MAP = true;
+//0: 1 / (c + l*d + q*d^2), 1: 1 / (1 + q*d^2)
+layout(constant_id = 3) const int ATTENUATION = 0;
+
 //Constants
 
 layout(set = 0,binding = 0) uniform CameraBuffer{
 	mat4 view_proj; //view_proj = proj * view
 	vec4 eye;
+	vec4 forward;
 } camera;
 
 struct LightEntity{ 
@@ -24,7 +34,7 @@ struct LightEntity{
 	float constant;
 	float linear;
 	float quad;
-	float dummy;
+	float radius;
 };
 
 layout(std140,set = 0,binding = 1) readonly buffer LightsBuffer{
@@ -41,48 +51,93 @@ layout(std140,set = 0,binding = 3) uniform Material{
 layout(set = 0,binding = 4) uniform sampler2D texDiffuse;
 layout(set = 0,binding = 5) uniform sampler2D texSpecular;
 
+//(offset,count) into indices per cluster, x fastest then y then depth slice
+layout(std430,set = 0,binding = 7) readonly buffer ClusterBuffer{
+	uvec2 data[];
+} clusters;
+
+layout(std430,set = 0,binding = 8) readonly buffer ClusterIndexBuffer{
+	uint data[];
+} clusterIndices;
+
 layout( push_constant ) uniform constants
 {
 	int num_lights;
+	uint cluster_x;
+	uint cluster_y;
+	uint cluster_z;
+	vec2 tile_size;
+	float z_near;
+	//slice = log(depth / z_near) * z_scale
+	float z_scale;
 } push_constants;
 
 
-void main()
+//tex_specular is already scaled by the material's shininess
+vec3 shade(int i,vec3 eye_dir,vec3 tex_diffuse,vec3 tex_specular)
 {
+	vec3 l = lights.data[i].position.xyz;
+	vec3 dl = l - inPosition;
+	float len = length(dl);
+	vec3 dx = dl / len;
+	vec3 light_bounce_dir = normalize(reflect(-dx,inNormal));
 
-	vec3 color = vec3(0);
-	for(int i = 0;i < push_constants.num_lights;i++){
-	
-		vec3 l = lights.data[i].position.xyz;
-		vec3 dl = l - inPosition;
-		float len = length(dl);
-		vec3 dx = dl / len;
-		vec3 eye_dir = normalize(camera.eye.xyz - inPosition);
-		vec3 light_bounce_dir = normalize(reflect(-dx,inNormal));
+
+	//Params
+	float ambient_factor = 0.3;
+	float diffuse_factor = max(0,dot(inNormal,dx));
+	float specular_factor = pow(max(dot(light_bounce_dir,eye_dir),0),64);
 
 
-		//Params
-		float ambient_factor = 0.3;
-		float diffuse_factor = max(0,dot(inNormal,dx));
-		float specular_factor = pow(max(dot(light_bounce_dir,eye_dir),0),64) * material.shiny.x;
+	//Ambient term
+	vec3 ambient = lights.data[i].ambient.xyz * tex_diffuse * ambient_factor;
 
+	//Diffuse term
+	vec3 diffuse = lights.data[i].diffuse.xyz * tex_diffuse * diffuse_factor;
 
-		//Ambient term
-		vec3 ambient = lights.data[i].ambient.xyz * texture(texDiffuse,inTexCoords).xyz * ambient_factor;
+	//Specular term
+	vec3 specular = lights.data[i].specular.xyz * tex_specular * specular_factor;
 
-		//Diffuse term
-		vec3 diffuse = lights.data[i].diffuse.xyz * texture(texDiffuse,inTexCoords).xyz * diffuse_factor;
+	float falloff;
+	if(ATTENUATION == 1){
+		falloff = 1.0 / (1.0 + lights.data[i].quad * len * len);
+	}
+	else{
+		falloff = 1.0 / (lights.data[i].constant + lights.data[i].linear * len + lights.data[i].quad * len * len);
+	}
 
-		//Specular term
-		vec3 specular = lights.data[i].specular.xyz * texture(texSpecular,inTexCoords).xyz * specular_factor;
+	//Fade to 0 at the cutoff radius so cluster edges don't show
+	float window = clamp(1.0 - pow(len / lights.data[i].radius,4.0),0.0,1.0);
+	falloff *= window * window;
 
-		float falloff = 1.0 / (lights.data[i].constant + lights.data[i].linear * len + lights.data[i].quad * len * len);
-		//float falloff = 1.0 / ( lights.data[i].quad * len * len);
+	return falloff*(ambient + diffuse + specular);
+}
 
+void main()
+{
+	vec3 eye_dir = normalize(camera.eye.xyz - inPosition);
+	//Material terms don't depend on the light, fetched once outside the loops
+	vec3 tex_diffuse = texture(texDiffuse,inTexCoords).xyz;
+	vec3 tex_specular = (SPECULAR_MAP ? texture(texSpecular,inTexCoords).xyz : material.specular.xyz) * material.shiny.x;
 
-		color = color + falloff*(ambient + diffuse + specular);
+	vec3 color = vec3(0);
 
+	if(CLUSTERED_LIGHTING){
+		float depth = dot(inPosition - camera.eye.xyz,camera.forward.xyz);
+		uint slice = uint(clamp(log(max(depth,push_constants.z_near) / push_constants.z_near) * push_constants.z_scale,0.0,float(push_constants.cluster_z - 1)));
+		uvec2 tile = min(uvec2(gl_FragCoord.xy / push_constants.tile_size),uvec2(push_constants.cluster_x - 1,push_constants.cluster_y - 1));
 
+		uvec2 cluster = clusters.data[(slice * push_constants.cluster_y + tile.y) * push_constants.cluster_x + tile.x];
+		for(uint j = 0;j < cluster.y;j++){
+			color = color + shade(int(clusterIndices.data[cluster.x + j]),eye_dir,tex_diffuse,tex_specular);
+		}
+	}
+	else{
+		//Constant bound when specialized, the driver can unroll it
+		int light_count = LIGHT_COUNT > 0 ? LIGHT_COUNT : push_constants.num_lights;
+		for(int i = 0;i < light_count;i++){
+			color = color + shade(i,eye_dir,tex_diffuse,tex_specular);
+		}
 	}
 	
 	color = pow(color,vec3(1.0/2.2));
@@ -7,27 +7,48 @@ layout(location = 2) in vec2 texCoords;
 
 
 //Out
+//Must match depth.vert bit for bit for the EQUAL test after a depth pre-pass
+invariant gl_Position;
 layout(location = 0) out vec3 outPosition;
 layout(location = 1) out vec3 outNormal;
 layout(location = 2) out vec2 outTexCoords;
 
 //Constants
 
+//Normal matrices come from the object buffer instead of an inverse per vertex
+layout(constant_id = 0) const bool PRECOMPUTED_NORMALS = true;
+
 layout(set = 0,binding = 0) uniform CameraBuffer{
 	mat4 view_proj; //view_proj = proj * view
 } camera;
 
 
+struct RenderEntity{
+	mat4 model;
+	mat4 normal; //inverse transpose of model
+};
+
 layout(std140,set = 0,binding = 2) readonly buffer ObjectTransforms{
-	mat4 data[];
+	RenderEntity data[];
 } objects;
 
+//Compacted list of objects that passed culling
+layout(std430,set = 0,binding = 6) readonly buffer VisibleObjects{
+	uint indices[];
+} visible;
+
 
 void main()
 {
-	mat4 model = objects.data[gl_InstanceIndex];
+	uint object = visible.indices[gl_InstanceIndex];
+	mat4 model = objects.data[object].model;
 	gl_Position = camera.view_proj  * model * vec4(position,1.0);
 	outPosition = (model * vec4(position,1.0)).xyz;
-	outNormal = mat3(transpose(inverse(model))) * normal;
+	if (PRECOMPUTED_NORMALS) {
+		outNormal = mat3(objects.data[object].normal) * normal;
+	}
+	else {
+		outNormal = mat3(transpose(inverse(model))) * normal;
+	}
 	outTexCoords = texCoords;
-}
\ No newline at end of file
+}
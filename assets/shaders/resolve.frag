@@ -0,0 +1,15 @@
+#version 450
+
+//Out
+layout(location = 0) out vec4 outColor;
+
+//Constants
+layout(input_attachment_index = 0,set = 0,binding = 6) uniform subpassInput lightAccum;
+
+
+void main()
+{
+	vec3 color = subpassLoad(lightAccum).xyz;
+	color = pow(color,vec3(1.0/2.2));
+	outColor = vec4(color,1.0);
+}
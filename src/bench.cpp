@@ -0,0 +1,270 @@
+#include "core/vk_app.h"
+#include "core/vk_args.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* Benchmark scenes */
+struct BenchScene {
+	const char* _name;
+
+	//Starting camera state
+	math::Vec3 _eye;
+	float _theta;
+	float _phi;
+
+	//Scripted camera motion applied every frame (camera local translation)
+	math::Vec3 _velocity;
+	float _dtheta;
+	float _dphi;
+};
+
+static const BenchScene SCENES[] = {
+	//Default view from the app
+	{ "default", math::Vec3{0, 0, -4}, 0.0f, 0.0f, math::Vec3{}, 0.0f, 0.0f },
+	//Whole spiral in view from above
+	{ "overview", math::Vec3{0, 30, 60}, 0.0f, 0.5f, math::Vec3{}, 0.0f, 0.0f },
+	//Circle through the spiral at object height
+	{ "flythrough", math::Vec3{0, 0, 30}, 0.0f, 0.0f, math::Vec3{0, 0, -0.2f}, 0.005f, 0.0f },
+};
+
+struct Stats {
+	double _mean{};
+	double _min{};
+	double _max{};
+	double _p50{};
+	double _p90{};
+	double _p95{};
+	double _p99{};
+};
+
+static Stats computeStats(std::vector<double> samples)
+{
+	Stats stats{};
+	if (samples.empty()) {
+		return stats;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	//Nearest rank percentile
+	auto percentile = [&](double p) {
+		size_t rank = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+		return samples[std::min(rank, samples.size() - 1)];
+	};
+
+	double sum = 0.0;
+	for (double s : samples) {
+		sum += s;
+	}
+
+	stats._mean = sum / samples.size();
+	stats._min = samples.front();
+	stats._max = samples.back();
+	stats._p50 = percentile(0.50);
+	stats._p90 = percentile(0.90);
+	stats._p95 = percentile(0.95);
+	stats._p99 = percentile(0.99);
+
+	return stats;
+}
+
+static void writeStats(std::ostream& out, const Stats& stats)
+{
+	out << "{ \"mean\": " << stats._mean
+		<< ", \"min\": " << stats._min
+		<< ", \"max\": " << stats._max
+		<< ", \"p50\": " << stats._p50
+		<< ", \"p90\": " << stats._p90
+		<< ", \"p95\": " << stats._p95
+		<< ", \"p99\": " << stats._p99 << " }";
+}
+
+struct PassResult {
+	std::string _name;
+	std::vector<double> _gpuMs;
+};
+
+struct SceneResult {
+	const BenchScene* _scene;
+	std::vector<double> _cpuMs;
+	std::vector<double> _gpuMs;
+	//Gpu profiler scopes, in recording order
+	std::vector<PassResult> _passes;
+};
+
+static SceneResult runScene(const BenchScene& scene, const AppConfig& config, uint32_t warmup, uint32_t frames, std::string& deviceName)
+{
+	SceneResult result{};
+	result._scene = &scene;
+
+	VkApp app{};
+	app.init(config);
+
+	deviceName = app.getGpuProperties().deviceName;
+
+	math::Vec3 eye = scene._eye;
+	app._mainCamera.reset(eye, 0.0);
+	app._mainCamera.rotateTheta(scene._theta);
+	app._mainCamera.rotatePhi(scene._phi);
+
+	for (uint32_t i = 0; i < warmup + frames; i++) {
+		app._mainCamera.translate(scene._velocity.x(), scene._velocity.y(), scene._velocity.z());
+		app._mainCamera.rotateTheta(scene._dtheta);
+		app._mainCamera.rotatePhi(scene._dphi);
+
+		auto start = std::chrono::steady_clock::now();
+		app.draw();
+		auto end = std::chrono::steady_clock::now();
+
+		if (i >= warmup) {
+			result._cpuMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+	}
+
+	app.finishFrames();
+
+	for (const GpuFrameTime& time : app.takeGpuFrameTimes()) {
+		if (time._frameNum < warmup) {
+			continue;
+		}
+
+		result._gpuMs.push_back(time._ms);
+
+		for (const auto& scope : time._scopes) {
+			auto pass = std::find_if(result._passes.begin(), result._passes.end(), [&](const PassResult& p) {
+				return p._name == scope._name;
+			});
+			if (pass == result._passes.end()) {
+				result._passes.push_back(PassResult{ scope._name,{} });
+				pass = result._passes.end() - 1;
+			}
+			pass->_gpuMs.push_back(scope._ms);
+		}
+	}
+
+	app.cleanup();
+
+	return result;
+}
+
+int main(int argc, char** argv) {
+
+	AppConfig config{};
+	config._headless = true;
+	config._readback = false;
+	config._fixedTimestep = 1.0 / 60.0;
+	config._seed = 1;
+	config._collectGpuTimes = true;
+
+	//Measured frames per scene
+	config._frameCount = 300;
+
+	uint32_t warmup = 30;
+	std::string sceneName{};
+	std::string outPath{};
+
+	//Everything else configures the app the same way lightBx does
+	auto bench_arg = [&](const std::string& arg, int count, char** values, int& i) {
+		if (arg == "--warmup" && i + 1 < count) {
+			if (!vk_args::parseUint(arg, values[++i], warmup)) {
+				return vk_args::ArgResult::INVALID;
+			}
+		}
+		else if (arg == "--scene" && i + 1 < count) {
+			sceneName = values[++i];
+		}
+		else if (arg == "--out" && i + 1 < count) {
+			outPath = values[++i];
+		}
+		else {
+			return vk_args::ArgResult::UNKNOWN;
+		}
+		return vk_args::ArgResult::PARSED;
+	};
+
+	if (!vk_args::parseAppArgs(argc, argv, config, bench_arg)) {
+		return 1;
+	}
+
+	uint32_t frames = config._frameCount;
+
+	std::vector<SceneResult> results{};
+	std::string deviceName{};
+
+	for (const BenchScene& scene : SCENES) {
+		if (!sceneName.empty() && sceneName != scene._name) {
+			continue;
+		}
+		std::cerr << "Running scene: " << scene._name << std::endl;
+		results.push_back(runScene(scene, config, warmup, frames, deviceName));
+	}
+
+	if (results.empty()) {
+		std::cerr << "No scene named: " << sceneName << std::endl;
+		return 1;
+	}
+
+	std::ofstream file{};
+	if (!outPath.empty()) {
+		file.open(outPath);
+		if (!file.is_open()) {
+			std::cerr << "Couldn't open output: " << outPath << std::endl;
+			return 1;
+		}
+	}
+	std::ostream& out = outPath.empty() ? std::cout : file;
+
+	out << "{\n";
+	out << "  \"device\": \"" << deviceName << "\",\n";
+	out << "  \"width\": " << config._extent.width << ",\n";
+	out << "  \"height\": " << config._extent.height << ",\n";
+	out << "  \"seed\": " << config._seed << ",\n";
+	out << "  \"timestep\": " << config._fixedTimestep << ",\n";
+	out << "  \"warmup\": " << warmup << ",\n";
+	out << "  \"frames\": " << frames << ",\n";
+	out << "  \"lights\": " << config._lightCount << ",\n";
+	out << "  \"renderer\": \"" << (config._renderMode == RenderMode::FORWARD ? "forward" : "deferred") << "\",\n";
+	out << "  \"depth_prepass\": " << (config._depthPrepass ? "true" : "false") << ",\n";
+	out << "  \"clustered\": " << (config._clusteredLighting ? "true" : "false") << ",\n";
+	out << "  \"specular_map\": " << (config._specularMap ? "true" : "false") << ",\n";
+	out << "  \"attenuation\": \"" << (config._attenuation == AttenuationModel::POLYNOMIAL ? "polynomial" : "inverse-square") << "\",\n";
+	out << "  \"compressed_textures\": " << (config._compressedTextures ? "true" : "false") << ",\n";
+	out << "  \"resource_budget_mb\": " << config._resourceBudget << ",\n";
+	out << "  \"texture_filter\": \"" << (config._textureFilter == TextureFilter::BILINEAR ? "bilinear" : config._textureFilter == TextureFilter::TRILINEAR ? "trilinear" : "anisotropic") << "\",\n";
+	out << "  \"objects\": " << config._objectCount << ",\n";
+	out << "  \"animated\": " << (config._animateObjects ? "true" : "false") << ",\n";
+	out << "  \"cull\": \"" << (config._cullMode == CullMode::NONE ? "none" : config._cullMode == CullMode::CPU ? "cpu" : "gpu") << "\",\n";
+	out << "  \"mesh\": \"" << (config._meshPath.empty() ? "cube" : config._meshPath) << "\",\n";
+	out << "  \"precomputed_normals\": " << (config._precomputedNormals ? "true" : "false") << ",\n";
+	out << "  \"scenes\": [\n";
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const SceneResult& result = results[i];
+		out << "    {\n";
+		out << "      \"name\": \"" << result._scene->_name << "\",\n";
+		out << "      \"cpu_ms\": ";
+		writeStats(out, computeStats(result._cpuMs));
+		out << ",\n";
+		out << "      \"gpu_ms\": ";
+		writeStats(out, computeStats(result._gpuMs));
+		out << ",\n";
+		out << "      \"gpu_samples\": " << result._gpuMs.size() << ",\n";
+		out << "      \"passes\": {";
+		for (size_t j = 0; j < result._passes.size(); j++) {
+			out << (j == 0 ? "\n" : ",\n");
+			out << "        \"" << result._passes[j]._name << "\": ";
+			writeStats(out, computeStats(result._passes[j]._gpuMs));
+		}
+		out << (result._passes.empty() ? "}\n" : "\n      }\n");
+		out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+
+	out << "  ]\n";
+	out << "}\n";
+
+	return 0;
+}
@@ -0,0 +1,136 @@
+#include "core/vk_io.h"
+#include "core/vk_cache.h"
+#include "core/vk_compress.h"
+#include "core/vk_jobs.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void printUsage(const char* name)
+{
+	std::cerr << "Usage: " << name << " <input.obj> <output.lbxmesh>" << std::endl;
+	std::cerr << "       " << name << " [--format bc1|bc3|bc7|rgba8] [--linear] [--threads N] <input image> <output.ktx2>" << std::endl;
+}
+
+/* OBJ -> .lbxmesh */
+static int cookMesh(const std::string& input, const std::string& output)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	vk_primitives::mesh::Mesh mesh{};
+	if (!vk_io::loadObj(input.c_str(), mesh)) {
+		return 1;
+	}
+
+	auto parsed = std::chrono::steady_clock::now();
+
+	if (!vk_cache::writeMesh(output.c_str(), mesh)) {
+		return 1;
+	}
+
+	auto written = std::chrono::steady_clock::now();
+
+	std::cout << "Cooked " << input << " -> " << output << std::endl;
+	std::cout << "  vertices: " << mesh._vertices.size() << ", indices: " << mesh._indices.size() << std::endl;
+	std::cout << "  parse: " << std::chrono::duration<double, std::milli>(parsed - start).count() << " ms"
+		<< ", write: " << std::chrono::duration<double, std::milli>(written - parsed).count() << " ms" << std::endl;
+
+	return 0;
+}
+
+/* Image -> mipmapped, block compressed .ktx2 */
+static int cookTexture(const std::string& input, const std::string& output, VkFormat format, uint32_t threads)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	vk_io::ImageData source{};
+	if (!vk_io::decodeImage(input.c_str(), source)) {
+		return 1;
+	}
+
+	auto decoded = std::chrono::steady_clock::now();
+
+	vk_jobs::ThreadPool pool{};
+	pool.init(threads);
+
+	vk_io::ImageData cooked{};
+	vk_compress::compressImage(pool, format, source, cooked);
+
+	pool.destroy();
+
+	auto compressed = std::chrono::steady_clock::now();
+
+	if (!vk_cache::writeTexture(output.c_str(), cooked)) {
+		return 1;
+	}
+
+	auto written = std::chrono::steady_clock::now();
+
+	std::cout << "Cooked " << input << " -> " << output << std::endl;
+	std::cout << "  " << cooked._width << "x" << cooked._height << ", levels: " << cooked._levelOffsets.size()
+		<< ", bytes: " << source._pixels.size() << " -> " << cooked._pixels.size() << std::endl;
+	std::cout << "  decode + mips: " << std::chrono::duration<double, std::milli>(decoded - start).count() << " ms"
+		<< ", compress: " << std::chrono::duration<double, std::milli>(compressed - decoded).count() << " ms"
+		<< ", write: " << std::chrono::duration<double, std::milli>(written - compressed).count() << " ms" << std::endl;
+
+	return 0;
+}
+
+/* Offline cook step: text OBJ -> binary .lbxmesh, images -> .ktx2, both are loaded as they are at runtime */
+int main(int argc, char** argv) {
+
+	std::string format_name{ "bc7" };
+	bool linear = false;
+	uint32_t threads = 0;
+	std::vector<std::string> paths{};
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg{ argv[i] };
+
+		if (arg == "--format" && i + 1 < argc) {
+			format_name = argv[++i];
+		}
+		else if (arg == "--linear") {
+			linear = true;
+		}
+		else if (arg == "--threads" && i + 1 < argc) {
+			threads = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else {
+			paths.push_back(arg);
+		}
+	}
+
+	if (paths.size() != 2) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	if (std::filesystem::path(paths[0]).extension() == ".obj") {
+		return cookMesh(paths[0], paths[1]);
+	}
+
+	//Color textures are sRGB unless --linear (normal maps, masks)
+	VkFormat format;
+	if (format_name == "bc1") {
+		format = linear ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+	}
+	else if (format_name == "bc3") {
+		format = linear ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC3_SRGB_BLOCK;
+	}
+	else if (format_name == "bc7") {
+		format = linear ? VK_FORMAT_BC7_UNORM_BLOCK : VK_FORMAT_BC7_SRGB_BLOCK;
+	}
+	else if (format_name == "rgba8") {
+		format = linear ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8A8_SRGB;
+	}
+	else {
+		std::cerr << "Unknown texture format: " << format_name << std::endl;
+		return 1;
+	}
+
+	return cookTexture(paths[0], paths[1], format, threads);
+}
@@ -0,0 +1,70 @@
+#include "vk_alloc.h"
+#include "vk_util.h"
+#include "vk_log.h"
+
+#include <cstdlib>
+
+void vk_alloc::LinearAllocator::init(VmaAllocator allocator, size_t capacity, VkBufferUsageFlags usage, size_t alignment)
+{
+	_capacity = capacity;
+	_alignment = alignment;
+	_head = 0;
+
+	_buffer = vk_util::createBuffer(allocator, capacity, usage, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+	//Stays mapped until destroy
+	VK_CHECK(vmaMapMemory(allocator, _buffer._allocation, (void**)&_mapped));
+}
+
+void vk_alloc::LinearAllocator::destroy(VmaAllocator allocator)
+{
+	vmaUnmapMemory(allocator, _buffer._allocation);
+	vmaDestroyBuffer(allocator, _buffer._buffer, _buffer._allocation);
+	_mapped = nullptr;
+}
+
+void vk_alloc::LinearAllocator::reset()
+{
+	_head = 0;
+}
+
+vk_alloc::Allocation vk_alloc::LinearAllocator::allocate(size_t size)
+{
+	size_t offset = vk_util::padBufferSize(_alignment, _head);
+
+	if (offset + size > _capacity) {
+		std::cout << "Linear allocator out of memory (" << offset + size << "/" << _capacity << " bytes)" << std::endl;
+		abort();
+	}
+
+	_head = offset + size;
+
+	Allocation allocation{};
+	allocation._buffer = _buffer._buffer;
+	allocation._offset = static_cast<uint32_t>(offset);
+	allocation._data = _mapped + offset;
+
+	return allocation;
+}
+
+void vk_alloc::LinearAllocator::flush(VmaAllocator allocator)
+{
+	if (_head > 0) {
+		vmaFlushAllocation(allocator, _buffer._allocation, 0, _head);
+	}
+}
+
+VkBuffer vk_alloc::LinearAllocator::getBuffer() const
+{
+	return _buffer._buffer;
+}
+
+size_t vk_alloc::LinearAllocator::getCapacity() const
+{
+	return _capacity;
+}
+
+size_t vk_alloc::LinearAllocator::getUsed() const
+{
+	return _head;
+}
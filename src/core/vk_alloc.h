@@ -0,0 +1,40 @@
+#pragma once
+
+#include "vk_types.h"
+#include "vk_mem_alloc.h"
+
+namespace vk_alloc {
+
+	/* Slice of a linear allocator, offset is usable as a dynamic descriptor offset */
+	struct Allocation {
+		VkBuffer _buffer;
+		uint32_t _offset;
+		void* _data;
+	};
+
+	/* Persistently mapped buffer, sub allocated with a bump pointer and reset once per frame */
+	class LinearAllocator {
+	public:
+		void init(VmaAllocator allocator, size_t capacity, VkBufferUsageFlags usage, size_t alignment);
+		void destroy(VmaAllocator allocator);
+
+		//Only call once the gpu is done reading the previous contents
+		void reset();
+
+		Allocation allocate(size_t size);
+
+		//Make writes visible to the gpu (no-op on coherent memory)
+		void flush(VmaAllocator allocator);
+
+		VkBuffer getBuffer() const;
+		size_t getCapacity() const;
+		size_t getUsed() const;
+
+	private:
+		vk_types::AllocatedBuffer _buffer{};
+		uint8_t* _mapped{ nullptr };
+		size_t _capacity{ 0 };
+		size_t _alignment{ 0 };
+		size_t _head{ 0 };
+	};
+}
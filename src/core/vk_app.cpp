@@ -3,6 +3,7 @@
 #include "vk_init.h"
 #include "vk_util.h"
 #include "vk_io.h"
+#include "vk_cache.h"
 #include "settings.h"
 #include "VkBootstrap.h"
 
@@ -18,16 +19,28 @@
 #include <ctime>
 #include <cmath>
 #include <cstring> 
+#include <cstdio>
+#include <algorithm>
+#include <filesystem>
+#include <memory>
 
 #define VMA_IMPLEMENTATION
 #include "vk_mem_alloc.h"
 
-void VkApp::init()
+void VkApp::init(const AppConfig& config)
 {
-	std::srand(std::time(nullptr));
+	_config = config;
+	_windowSize = _config._extent;
+	_startTime = std::chrono::steady_clock::now();
+
+	std::srand(_config._seed != 0 ? _config._seed : static_cast<uint32_t>(std::time(nullptr)));
 
 	initWindow();
 
+	initJobs();
+
+	loadAssets();
+
 	initVulkan();
 
 	initSwapchain();
@@ -36,6 +49,8 @@ void VkApp::init()
 
 	initSync();
 
+	initQueries();
+
 	initSamplers();
 
 	initRenderPasses();
@@ -44,13 +59,21 @@ void VkApp::init()
 
 	initBuffers();
 
-	initImages();
+	//Decodes/parses were queued in loadAssets, create + upload gpu resources as they finish
+	_assetLoader.finish();
+
+	//Buffer/image uploads go out as one batch
+	_uploadQueue.submit();
 
 	initDescriptors();
 
+	initPipelineCache();
+
 	initPipelines();
 
-	initImgui();
+	if (!_config._headless) {
+		initImgui();
+	}
 
 	_init = true;
 
@@ -58,6 +81,13 @@ void VkApp::init()
 
 void VkApp::run()
 {
+	if (_config._headless) {
+		for (uint32_t i = 0; i < _config._frameCount; i++) {
+			draw();
+		}
+		return;
+	}
+
 	while (!glfwWindowShouldClose(_window)) {
 
 		glfwPollEvents();
@@ -99,11 +129,25 @@ void VkApp::draw()
 	VK_CHECK(vkWaitForFences(_device, 1, &frame._renderDoneFence, true, 1000000000));
 	VK_CHECK(vkResetFences(_device, 1, &frame._renderDoneFence));
 
+	//Readback/timings from the last time this frame was used are complete now
+	if (frame._readbackPending) {
+		dumpFrame(frame);
+	}
+	resolveTimestamps(frame);
+
+	//Finish loads started since the last frame, destroy evicted resources no frame in flight uses anymore
+	_assetLoader.poll();
+	_resources.update(_frameNum);
+
+	//Pick up any uploads recorded since the last frame, release staging memory the gpu is done with
+	_uploadQueue.submit();
+	_uploadQueue.collect();
+
 	/* Update frame resources */
 
 	//Update camera info
 	math::Mat4 view = _mainCamera.getViewMatrix();
-	math::Mat4 proj = math::Mat4::perspectiveProjectionVk(70.0 * (3.14 / 180.0), (float)_windowSize.width / (float)_windowSize.height, 0.1f, 200.0f);
+	math::Mat4 proj = math::Mat4::perspectiveProjectionVk(70.0 * (3.14 / 180.0), (float)_windowSize.width / (float)_windowSize.height, CAMERA_NEAR, CAMERA_FAR);
 	//math::Mat4 proj = math::Mat4::orthographicProjectionVk(-10, 10, 10, -10, 0.1, 100);
 
 	//proj[1][1] *= -1;
@@ -111,58 +155,41 @@ void VkApp::draw()
 	gpu_data.view_proj = proj * view;
 	auto eye = _mainCamera.getEye();
 	gpu_data.eye = math::Vec4{ eye.x(),eye.y(),eye.z(),0.0};
+	//Third row of the view matrix is -forward
+	gpu_data.forward = math::Vec4{ -view[0][2],-view[1][2],-view[2][2],0.0 };
+	gpu_data.inv_view_proj = gpu_data.view_proj.inverse();
 
-	//Copy to gpu
-	uint32_t camOffsetSize = vk_util::padBufferSize(_gpuProperties.limits.minUniformBufferOffsetAlignment, sizeof(GPUCameraData));
-	char* data;
-	vmaMapMemory(_allocator, _cameraBuffer._allocation, (void**)&data);
+	//Transient data from the last time this frame was used is no longer read
+	frame._uploadAllocator.reset();
 
-	data += camOffsetSize * frameIdx;
-	memcpy(data, (void*)&gpu_data, camOffsetSize);
+	//Copy to gpu
+	vk_alloc::Allocation camera_alloc = frame._uploadAllocator.allocate(sizeof(GPUCameraData));
+	memcpy(camera_alloc._data, &gpu_data, sizeof(GPUCameraData));
 
-	vmaUnmapMemory(_allocator, _cameraBuffer._allocation);
 
+	//Renderer/shading picked from the menu is drawn once its pipelines have compiled, the previous ones are kept until then
+	const ShadingPipelines& selected_shading = getShadingPipelines(getShadingVariant());
+	if (_pipelines.ready(getRendererPipelines(_config._renderMode, selected_shading))) {
+		_activeRenderMode = _config._renderMode;
+		_activeShading = &selected_shading;
+	}
 
 	//Update light data
-	uint32_t lightOffsetSize = vk_util::padBufferSize(_gpuProperties.limits.minStorageBufferOffsetAlignment, sizeof(LightEntity)) * NUM_LIGHTS;
-	size_t light_buffer_size = vk_util::padBufferSize(_gpuProperties.limits.minStorageBufferOffsetAlignment, sizeof(LightEntity));
-	light_buffer_size *= NUM_LIGHTS * NUM_FRAMES;
-
-	float t = static_cast<float>(glfwGetTime());
-	float min_r = 5.0;
-	float max_r = 20.0;
-	float angle_speed = 1.0;
-
-	//Fill buffer with data
-	void* light_data;
-	vmaMapMemory(_allocator, _lightBuffer._allocation, &light_data);
+	float t = static_cast<float>(getTime());
 
-	LightEntity* light = (LightEntity*)light_data;
-	for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
-		//_lights[i].position = math::Vec4{ 4.0f * i, 6.0f, 2.0f * i + 4.0f * static_cast<float>(sin(glfwGetTime())),0.0 };
-		float src = (sin(t) + 1.0) * 0.5;
-		float r = (1.0 - src) * min_r + src * max_r;
-		float dx = static_cast<float>(i + 1) / NUM_LIGHTS;
-		float angle = t * angle_speed + dx * PI * 2.0;
-		_lights[i].position = math::Vec4{r*cos(angle),10.0,r*sin(angle),0.0};
+	uint32_t light_offsets[3];
+	GPULightingParams lighting = updateLights(frame, t, view, proj, light_offsets);
 
-		//light[i + frameIdx * NUM_LIGHTS].position = math::Vec4{ 4.0f * i, 6.0f, 2.0f * i + 4.0f * static_cast<float>(sin(glfwGetTime())),0.0};
-		//light[0].position = math::Vec4{ 0, 6.0f + 4.0f * static_cast<float>(sin(glfwGetTime())), 0,0.0 };
-		light[i + frameIdx * NUM_LIGHTS].position = _lights[i].position;
-		light[i + frameIdx * NUM_LIGHTS].ambient = _lights[i].ambient;
-		light[i + frameIdx * NUM_LIGHTS].diffuse = _lights[i].diffuse;
-		light[i + frameIdx * NUM_LIGHTS].specular = _lights[i].specular;
+	//Planes from the same view_proj the shaders use
+	math::Frustum frustum = math::Frustum::fromMatrix(gpu_data.view_proj);
+	_visibleObjectCount = updateObjects(frameIdx, t, frustum);
 
-		light[i + frameIdx * NUM_LIGHTS]._constantAttenuation = _lights[i]._constantAttenuation;
-		light[i + frameIdx * NUM_LIGHTS]._linearAttenuation = _lights[i]._linearAttenuation;
-		light[i + frameIdx * NUM_LIGHTS]._quadraticAttenuation = _lights[i]._quadraticAttenuation;
 
+	//Offscreen targets are indexed by frame
+	uint32_t nextImgIndex = frameIdx;
+	if (!_config._headless) {
+		VK_CHECK(vkAcquireNextImageKHR(_device, _swapchain, 1000000000, frame._imgReadyFlag, VK_NULL_HANDLE, &nextImgIndex));
 	}
-	vmaUnmapMemory(_allocator, _lightBuffer._allocation);
-
-
-	uint32_t nextImgIndex;
-	VK_CHECK(vkAcquireNextImageKHR(_device, _swapchain, 1000000000, frame._imgReadyFlag, VK_NULL_HANDLE, &nextImgIndex));
 
 	VkCommandBuffer cmd = frame._commandBuffer;
 
@@ -171,10 +198,23 @@ void VkApp::draw()
 
 	VkCommandBufferBeginInfo begin_info = vk_init::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
-	ImGui::Render();
+	if (!_config._headless) {
+		ImGui::Render();
+	}
 
 	VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
 
+	frame._profiler.begin(cmd);
+	frame._profiledFrameNum = _frameNum;
+	uint32_t frameScope = frame._profiler.beginScope(cmd, "frame");
+
+	//Compute work has to happen outside the render pass
+	if (_config._cullMode == CullMode::GPU) {
+		uint32_t cullScope = frame._profiler.beginScope(cmd, "cull");
+		recordCulling(cmd, frame, frustum);
+		frame._profiler.endScope(cmd, cullScope);
+	}
+
 	VkClearValue clearValue;
 	//float flash = abs(sin(_frameNum / 120.0f));
 	clearValue.color = { {0.0,0.0,0.0,1.0f} };
@@ -182,7 +222,8 @@ void VkApp::draw()
 	VkClearValue clearDepth;
 	clearDepth.depthStencil.depth = 1.0f;
 
-	VkClearValue clearValues[] = { clearValue,clearDepth };
+	//Forward uses the first two, G-buffer/light accumulation clear to 0
+	VkClearValue clearValues[] = { clearValue,clearDepth,clearValue,clearValue,clearValue,clearValue };
 
 	VkRenderPassBeginInfo pass_begin_info{};
 	pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -197,63 +238,125 @@ void VkApp::draw()
 	pass_begin_info.clearValueCount = 2;
 	pass_begin_info.pClearValues = clearValues;
 
-	vkCmdBeginRenderPass(cmd, &pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+	//View/proj
+	uint32_t dynamicOffsets[] = { camera_alloc._offset,light_offsets[0],light_offsets[1],light_offsets[2] };
+
+	if (_activeRenderMode == RenderMode::FORWARD) {
+		vkCmdBeginRenderPass(cmd, &pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+		/* Draw lights */
+		uint32_t scope = frame._profiler.beginScope(cmd, "lights");
+		drawLights(cmd, frame, _pipelines.get(_lightPipeline), dynamicOffsets);
+		frame._profiler.endScope(cmd, scope);
+
+		/* Depth pre-pass, the color pass then only shades the visible surface */
+		//Skipped until both of its pipelines are ready, the regular object pipeline is right either way
+		bool prepass = _config._depthPrepass && _pipelines.ready({ _depthPrepassPipeline,_activeShading->_objectEqual });
+		if (prepass) {
+			scope = frame._profiler.beginScope(cmd, "prepass");
+			drawObjects(cmd, frame, _pipelines.get(_depthPrepassPipeline), dynamicOffsets, lighting, true);
+			frame._profiler.endScope(cmd, scope);
+		}
 
-	/* Draw lights */
+		/* Draw Objects */
+		scope = frame._profiler.beginScope(cmd, "objects");
+		drawObjects(cmd, frame, _pipelines.get(prepass ? _activeShading->_objectEqual : _activeShading->_object), dynamicOffsets, lighting);
+		frame._profiler.endScope(cmd, scope);
+	}
+	else {
+		pass_begin_info.renderPass = _deferredRenderPass;
+		pass_begin_info.framebuffer = _deferredFrameBuffers[nextImgIndex];
+		pass_begin_info.clearValueCount = 6;
 
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _lightPipeline);
+		vkCmdBeginRenderPass(cmd, &pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
 
-	//Bind vertex buffer
-	VkDeviceSize offset = 0;
-	vkCmdBindVertexBuffers(cmd, 0, 1, &_vertexBuffer._buffer, &offset);
+		/* G-buffer */
+		uint32_t scope = frame._profiler.beginScope(cmd, "gbuffer");
+		drawObjects(cmd, frame, _pipelines.get(_activeShading->_gBuffer), dynamicOffsets, lighting);
+		frame._profiler.endScope(cmd, scope);
 
-	//Bind index buffer
-	//vkCmdBindIndexBuffer(cmd, _indexBuffer._buffer, offset, VK_INDEX_TYPE_UINT32);
+		/* Light volumes */
+		vkCmdNextSubpass(cmd, VK_SUBPASS_CONTENTS_INLINE);
+		scope = frame._profiler.beginScope(cmd, "lighting");
 
-	//View/proj
-	//uint32_t dynamicOffset =
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.get(_activeShading->_lightVolume));
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _lightVolumePipelineLayout, 0, 1, &frame._deferredDescriptorSet, 2, dynamicOffsets);
 
-	uint32_t dynamicOffsets[] = { camOffsetSize * frameIdx,lightOffsetSize*frameIdx };
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _lightPipelineLayout, 0, 1, &_lightDescriptorSet, 2, dynamicOffsets);
-	
-	//Instanced draw
-	vkCmdDraw(cmd, _vertices.size(), NUM_LIGHTS, 0, 0);
-	//vkCmdDrawIndexed(cmd, static_cast<uint32_t>(_indices.size()), NUM_LIGHTS, 0, 0, 0);
+		GPULightVolumeParams volume_params{ view,proj };
+		vkCmdPushConstants(cmd, _lightVolumePipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPULightVolumeParams), &volume_params);
 
-	/* Draw Objects */
+		//One screen rectangle per light
+		vkCmdDraw(cmd, 6, _config._lightCount, 0, 0);
 
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _objectPipeline);
+		/* Resolve + light cubes */
+		vkCmdNextSubpass(cmd, VK_SUBPASS_CONTENTS_INLINE);
 
-	//Bind vertex buffer
-	//VkDeviceSize offset = 0;
-	offset = 0;
-	vkCmdBindVertexBuffers(cmd, 0, 1, &_vertexBuffer._buffer, &offset);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.get(_resolvePipeline));
+		vkCmdDraw(cmd, 3, 1, 0, 0);
 
-	//Bind index buffer
-	//vkCmdBindIndexBuffer(cmd, _indexBuffer._buffer, offset, VK_INDEX_TYPE_UINT32);
+		frame._profiler.endScope(cmd, scope);
 
-	//View/proj
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _objectPipelineLayout, 0, 1, &_objectDescriptorSet, 2, dynamicOffsets);
+		scope = frame._profiler.beginScope(cmd, "lights");
+		drawLights(cmd, frame, _pipelines.get(_deferredLightPipeline), dynamicOffsets);
+		frame._profiler.endScope(cmd, scope);
 
-	//Set # lights
-	//int num_lights = NUM_l
-	vkCmdPushConstants(cmd, _objectPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int), &NUM_LIGHTS);
+		//Imgui pipelines are built against _renderPass, draw them in a compatible pass
+		if (!_config._headless) {
+			vkCmdEndRenderPass(cmd);
 
-	//Instanced draw
-	//vkCmdDrawIndexed(cmd, static_cast<uint32_t>(_indices.size()), NUM_OBJECTS, 0, 0, 0);
-	vkCmdDraw(cmd, _vertices.size(), NUM_OBJECTS, 0, 0);
+			pass_begin_info.renderPass = _overlayRenderPass;
+			pass_begin_info.framebuffer = _frameBuffers[nextImgIndex];
+			pass_begin_info.clearValueCount = 0;
+			pass_begin_info.pClearValues = nullptr;
 
+			vkCmdBeginRenderPass(cmd, &pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+		}
+	}
 
 	//Imgui draw commands
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+	if (!_config._headless) {
+		uint32_t scope = frame._profiler.beginScope(cmd, "imgui");
+		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+		frame._profiler.endScope(cmd, scope);
+	}
 	
 	vkCmdEndRenderPass(cmd);
 
+	//Copy offscreen color target to host visible memory
+	bool readback = _config._headless && _config._readback;
+	if (readback) {
+		VkBufferImageCopy copy_region{};
+		copy_region.bufferOffset = 0;
+		copy_region.bufferRowLength = 0;
+		copy_region.bufferImageHeight = 0;
+
+		copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy_region.imageSubresource.mipLevel = 0;
+		copy_region.imageSubresource.baseArrayLayer = 0;
+		copy_region.imageSubresource.layerCount = 1;
+		copy_region.imageExtent = { _windowSize.width,_windowSize.height,1 };
+
+		vkCmdCopyImageToBuffer(cmd, _offscreenImages[frameIdx]._image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame._readbackBuffer._buffer, 1, &copy_region);
+
+		//Make transfer writes visible to host once the fence signals
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.pNext = nullptr;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = frame._readbackBuffer._buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	frame._profiler.endScope(cmd, frameScope);
 
 	VK_CHECK(vkEndCommandBuffer(cmd));
 
-	ImGuiIO& io = ImGui::GetIO(); (void)io;
-
 	/*
 	TODO: Get multi-viewport workingg
 	if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
@@ -262,19 +365,35 @@ void VkApp::draw()
 		ImGui::RenderPlatformWindowsDefault();
 	}*/
 
+	//Make this frame's transient data visible before submitting
+	frame._uploadAllocator.flush(_allocator);
+
 	//Submit recorded buffer to graphics queue
 	VkSubmitInfo submit{};
 	submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit.pNext = nullptr;
 
-	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	//Swapchain image + uploads this frame reads from
+	VkSemaphore waitSemaphores[] = { frame._imgReadyFlag,_uploadQueue.getSemaphore() };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };
+	uint64_t waitValues[] = { 0,_uploadQueue.getSubmittedValue() };
 
-	submit.pWaitDstStageMask = &waitStage;
+	//No swapchain to synchronize with when headless
+	uint32_t semaphoreCount = _config._headless ? 0 : 1;
+	uint32_t firstWait = 1 - semaphoreCount;
 
-	submit.waitSemaphoreCount = 1;
-	submit.pWaitSemaphores = &frame._imgReadyFlag;
+	VkTimelineSemaphoreSubmitInfo timeline_info{};
+	timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_info.pNext = nullptr;
+	timeline_info.waitSemaphoreValueCount = 2 - firstWait;
+	timeline_info.pWaitSemaphoreValues = &waitValues[firstWait];
 
-	submit.signalSemaphoreCount = 1;
+	submit.pNext = &timeline_info;
+
+	submit.waitSemaphoreCount = 2 - firstWait;
+	submit.pWaitSemaphores = &waitSemaphores[firstWait];
+	submit.pWaitDstStageMask = &waitStages[firstWait];
+
+	submit.signalSemaphoreCount = semaphoreCount;
 	submit.pSignalSemaphores = &frame._renderDoneFlag;
 
 	submit.commandBufferCount = 1;
@@ -282,6 +401,13 @@ void VkApp::draw()
 
 	VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submit, frame._renderDoneFence));
 
+	if (_config._headless) {
+		frame._readbackPending = readback;
+		frame._readbackFrameNum = _frameNum;
+		_frameNum++;
+		return;
+	}
+
 	VkPresentInfoKHR present_info{};
 	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	present_info.pNext = nullptr;
@@ -303,22 +429,32 @@ void VkApp::cleanup()
 {
 	if (_init) {
 
-		for (uint32_t i = 0; i < NUM_FRAMES; i++) {
-			VK_CHECK(vkWaitForFences(_device, 1,&_frames[i]._renderDoneFence, true, 1000000000));
-		}
+		finishFrames();
 
-		destroyImgui();
+		//Background pipeline compiles run on the pool
+		_pipelines.wait();
+
+		destroyJobs();
+
+		if (!_config._headless) {
+			destroyImgui();
+		}
 
 		destroyPipelines();
 
+		//Every pipeline has been created by now, including imgui's
+		destroyPipelineCache();
+
 		destroyDescriptors();
 
 		destroyBuffers();
 
-		destroyImages();
+		destroyResources();
 
 		destroySamplers();
 
+		destroyQueries();
+
 		destroySync();
 
 		destroyFrameBuffers();
@@ -331,12 +467,19 @@ void VkApp::cleanup()
 
 		destroyVulkan();
 
-		destroyWindow();
+		if (!_config._headless) {
+			destroyWindow();
+		}
 	}
 }
 
 void VkApp::initWindow()
 {
+	//No window system needed in headless mode
+	if (_config._headless) {
+		return;
+	}
+
 	glfwInit();
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -358,6 +501,29 @@ void VkApp::initWindow()
 	_windowSize.height = height;
 }
 
+void VkApp::initJobs()
+{
+	_threadPool.init(_config._workerThreads);
+	_assetLoader.init(&_threadPool);
+
+	vk_resources::ResourceConfig resource_config{};
+	resource_config._budget = static_cast<size_t>(_config._resourceBudget) * 1024 * 1024;
+	resource_config._cookedTextures = _config._compressedTextures;
+	resource_config._framesInFlight = NUM_FRAMES;
+	_resources.init(resource_config, &_assetLoader);
+}
+
+void VkApp::loadAssets()
+{
+	//Completions run after initBuffers once the upload queue exists
+	_diffuseTexture = _resources.loadTexture(std::string{ IMAGE_DIR } + "crate_diffuse_map.png");
+	_specularTexture = _resources.loadTexture(std::string{ IMAGE_DIR } + "crate_specular_map.png");
+
+	if (!_config._meshPath.empty()) {
+		_loadedMesh = _resources.loadMesh(_config._meshPath);
+	}
+}
+
 void VkApp::initVulkan()
 {
 	//Create instance
@@ -367,6 +533,7 @@ void VkApp::initVulkan()
 		.set_app_name("lightBx")
 		.request_validation_layers(true)
 		.require_api_version(1, 3, 0)
+		.set_headless(_config._headless)
 		.use_default_debug_messenger()
 		.build();
 
@@ -375,20 +542,37 @@ void VkApp::initVulkan()
 	_instance = instance.instance;
 	_debugMessenger = instance.debug_messenger;
 
-	//Create surface
-	VK_CHECK(glfwCreateWindowSurface(_instance, _window, nullptr, &_surface));
-
 	//Create physical device
 	vkb::PhysicalDeviceSelector selector{instance};
+	selector.set_minimum_version(1, 2);
+
+	//Upload completion is tracked with a timeline semaphore
+	VkPhysicalDeviceVulkan12Features features_12{};
+	features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	features_12.timelineSemaphore = VK_TRUE;
+	selector.set_required_features_12(features_12);
+
+	//Create surface (headless devices don't need to present)
+	if (!_config._headless) {
+		VK_CHECK(glfwCreateWindowSurface(_instance, _window, nullptr, &_surface));
+		selector.set_surface(_surface);
+	}
 
 	vkb::PhysicalDevice gpu = selector
-		.set_minimum_version(1, 1)
-		.set_surface(_surface)
 		.select()
 		.value();
 
 	_gpu = gpu.physical_device;
 
+	//Anisotropic filtering is optional, samplers fall back to trilinear without it
+	VkPhysicalDeviceFeatures supported_features{};
+	vkGetPhysicalDeviceFeatures(_gpu, &supported_features);
+	_anisotropySupported = supported_features.samplerAnisotropy == VK_TRUE;
+	gpu.features.samplerAnisotropy = supported_features.samplerAnisotropy;
+	//Optional too, cooked BC textures fall back to their source images without it
+	_bcSupported = supported_features.textureCompressionBC == VK_TRUE;
+	gpu.features.textureCompressionBC = supported_features.textureCompressionBC;
+
 
 	//Create device
 	vkb::DeviceBuilder device_builder{gpu};
@@ -409,6 +593,17 @@ void VkApp::initVulkan()
 	_graphicsFamilyQueueIndex = device.get_queue_index(vkb::QueueType::graphics).value();
 	_graphicsQueue = device.get_queue(vkb::QueueType::graphics).value();
 
+	//Copies run alongside rendering when there's a transfer only queue family
+	auto transfer_queue = device.get_dedicated_queue(vkb::QueueType::transfer);
+	if (transfer_queue) {
+		_transferFamilyQueueIndex = device.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+		_transferQueue = transfer_queue.value();
+	}
+	else {
+		_transferFamilyQueueIndex = _graphicsFamilyQueueIndex;
+		_transferQueue = _graphicsQueue;
+	}
+
 	//Create vma allocator
 
 	VmaAllocatorCreateInfo create_info{};
@@ -420,24 +615,29 @@ void VkApp::initVulkan()
 
 void VkApp::initSwapchain()
 {
-	vkb::SwapchainBuilder swapchain_builder{_gpu, _device, _surface};
-
-	VkSurfaceFormatKHR surface_format{};
-	surface_format.format = VK_FORMAT_B8G8R8A8_UNORM;
-	surface_format.colorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR;
-
-	vkb::Swapchain swapchain = swapchain_builder
-		.use_default_format_selection()
-		.set_desired_format(surface_format)
-		.set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-		.set_desired_extent(_windowSize.width,_windowSize.height)
-		.build()
-		.value();
-
-	_swapchain = swapchain.swapchain;
-	_swapchainFormat = swapchain.image_format;
-	_swapchainImages = swapchain.get_images().value();
-	_swapchainImageViews = swapchain.get_image_views().value();
+	if (_config._headless) {
+		initOffscreenTargets();
+	}
+	else {
+		vkb::SwapchainBuilder swapchain_builder{_gpu, _device, _surface};
+
+		VkSurfaceFormatKHR surface_format{};
+		surface_format.format = VK_FORMAT_B8G8R8A8_UNORM;
+		surface_format.colorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR;
+
+		vkb::Swapchain swapchain = swapchain_builder
+			.use_default_format_selection()
+			.set_desired_format(surface_format)
+			.set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
+			.set_desired_extent(_windowSize.width,_windowSize.height)
+			.build()
+			.value();
+
+		_swapchain = swapchain.swapchain;
+		_swapchainFormat = swapchain.image_format;
+		_swapchainImages = swapchain.get_images().value();
+		_swapchainImageViews = swapchain.get_image_views().value();
+	}
 
 	VkExtent3D depthExtent{
 		_windowSize.width,
@@ -447,7 +647,8 @@ void VkApp::initSwapchain()
 
 	_depthFormat = VK_FORMAT_D32_SFLOAT;
 
-	VkImageCreateInfo img_create_info = vk_init::imageCreateInfo(_depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthExtent);
+	//Also read by the deferred lighting subpass
+	VkImageCreateInfo img_create_info = vk_init::imageCreateInfo(_depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, depthExtent);
 
 	VmaAllocationCreateInfo alloc_info{};
 	alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
@@ -458,6 +659,65 @@ void VkApp::initSwapchain()
 	VkImageViewCreateInfo view_create_info = vk_init::imageViewCreateInfo(_depthFormat, _depthImage._image, VK_IMAGE_ASPECT_DEPTH_BIT);
 
 	VK_CHECK(vkCreateImageView(_device, &view_create_info, nullptr, &_depthImageView));
+
+	/* G-buffer */
+
+	//Never leaves the render pass, tilers can keep it in lazily allocated (on-chip) memory
+	alloc_info.requiredFlags = 0;
+	alloc_info.preferredFlags = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+	VkImageUsageFlags gbuffer_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+	auto create_gbuffer_image = [&](VkFormat format, vk_types::AllocatedImage& image, VkImageView& view) {
+		VkImageCreateInfo gbuffer_info = vk_init::imageCreateInfo(format, gbuffer_usage, depthExtent);
+		VK_CHECK(vmaCreateImage(_allocator, &gbuffer_info, &alloc_info, &image._image, &image._allocation, nullptr));
+
+		VkImageViewCreateInfo gbuffer_view_info = vk_init::imageViewCreateInfo(format, image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+		VK_CHECK(vkCreateImageView(_device, &gbuffer_view_info, nullptr, &view));
+	};
+
+	//Albedo, specular color + shininess, world normal, light accumulation
+	create_gbuffer_image(VK_FORMAT_R8G8B8A8_UNORM, _gBufferAlbedo, _gBufferAlbedoView);
+	create_gbuffer_image(VK_FORMAT_R8G8B8A8_UNORM, _gBufferSpecular, _gBufferSpecularView);
+	create_gbuffer_image(VK_FORMAT_R16G16B16A16_SFLOAT, _gBufferNormal, _gBufferNormalView);
+	create_gbuffer_image(VK_FORMAT_R16G16B16A16_SFLOAT, _lightAccum, _lightAccumView);
+}
+
+void VkApp::initOffscreenTargets()
+{
+	//Same format the swapchain asks for so pipelines don't change
+	_swapchainFormat = VK_FORMAT_B8G8R8A8_UNORM;
+
+	VkExtent3D extent{
+		_windowSize.width,
+		_windowSize.height,
+		1
+	};
+
+	VkImageCreateInfo img_create_info = vk_init::imageCreateInfo(_swapchainFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, extent);
+
+	VmaAllocationCreateInfo alloc_info{};
+	alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	alloc_info.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	size_t readback_size = _windowSize.width * _windowSize.height * 4;
+
+	//One color target + readback buffer per frame in flight
+	_offscreenImages.resize(NUM_FRAMES);
+	_swapchainImages.resize(NUM_FRAMES);
+	_swapchainImageViews.resize(NUM_FRAMES);
+
+	for (uint32_t i = 0; i < NUM_FRAMES; i++) {
+		VK_CHECK(vmaCreateImage(_allocator, &img_create_info, &alloc_info, &_offscreenImages[i]._image, &_offscreenImages[i]._allocation, nullptr));
+		_swapchainImages[i] = _offscreenImages[i]._image;
+
+		VkImageViewCreateInfo view_create_info = vk_init::imageViewCreateInfo(_swapchainFormat, _offscreenImages[i]._image, VK_IMAGE_ASPECT_COLOR_BIT);
+		VK_CHECK(vkCreateImageView(_device, &view_create_info, nullptr, &_swapchainImageViews[i]));
+
+		if (_config._readback) {
+			_frames[i]._readbackBuffer = vk_util::createBuffer(_allocator, readback_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+		}
+	}
 }
 
 void VkApp::initCommands()
@@ -479,6 +739,9 @@ void VkApp::initCommands()
 	VK_CHECK(vkCreateCommandPool(_device, &pool_create_info, nullptr, &_uploadContext._commandPool));
 	VkCommandBufferAllocateInfo buffer_alloc_info = vk_init::commandBufferAllocateInfo(_uploadContext._commandPool, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 	VK_CHECK(vkAllocateCommandBuffers(_device, &buffer_alloc_info, &_uploadContext._commandBuffer));
+
+	_uploadQueue.init(_device, _allocator, _graphicsFamilyQueueIndex, _graphicsQueue, _transferFamilyQueueIndex, _transferQueue);
+	_resources.initDevice(_device, _allocator, &_uploadQueue, _bcSupported);
 }
 
 
@@ -497,7 +760,8 @@ void VkApp::initRenderPasses()
 	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
 	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	//Offscreen targets get copied out instead of presented
+	color_attachment.finalLayout = _config._headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	VkAttachmentDescription depth_attachment{};
 	depth_attachment.format = _depthFormat;
@@ -547,7 +811,16 @@ void VkApp::initRenderPasses()
 	depth_dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
 
-	VkSubpassDependency dependencies[] = {dependency,depth_dependency};
+	//Readback copy waits on color writes
+	VkSubpassDependency readback_dependency{};
+	readback_dependency.srcSubpass = 0;
+	readback_dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+	readback_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	readback_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	readback_dependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	readback_dependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	VkSubpassDependency dependencies[] = {dependency,depth_dependency,readback_dependency};
 
 	/* Render pass */
 
@@ -561,10 +834,175 @@ void VkApp::initRenderPasses()
 	pass_create_info.subpassCount = 1;
 	pass_create_info.pSubpasses = &subpass;
 
-	pass_create_info.dependencyCount = 2;
+	pass_create_info.dependencyCount = _config._headless ? 3 : 2;
 	pass_create_info.pDependencies = dependencies;
 
 	VK_CHECK(vkCreateRenderPass(_device,&pass_create_info,nullptr,&_renderPass));
+
+	/* Deferred render pass */
+
+	//G-buffer is written and read inside the pass, nothing needs to reach memory
+	VkAttachmentDescription gbuffer_attachment{};
+	gbuffer_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	gbuffer_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	gbuffer_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	gbuffer_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	gbuffer_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	gbuffer_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	gbuffer_attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkAttachmentDescription albedo_attachment = gbuffer_attachment;
+	albedo_attachment.format = VK_FORMAT_R8G8B8A8_UNORM;
+	VkAttachmentDescription specular_attachment = gbuffer_attachment;
+	specular_attachment.format = VK_FORMAT_R8G8B8A8_UNORM;
+	VkAttachmentDescription normal_attachment = gbuffer_attachment;
+	normal_attachment.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+	VkAttachmentDescription deferred_depth_attachment = depth_attachment;
+	deferred_depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	deferred_depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	//Linear sum of the light volumes, tone mapped into the color target
+	VkAttachmentDescription accum_attachment = gbuffer_attachment;
+	accum_attachment.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+	//0: color target, 1: depth, 2-4: G-buffer, 5: light accumulation
+	VkAttachmentDescription deferred_attachments[] = { color_attachment,deferred_depth_attachment,albedo_attachment,specular_attachment,normal_attachment,accum_attachment };
+
+	//Subpass 0 (G-buffer)
+	VkAttachmentReference gbuffer_refs[] = {
+		{2,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+		{3,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+		{4,VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
+	};
+
+	VkSubpassDescription gbuffer_subpass{};
+	gbuffer_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	gbuffer_subpass.colorAttachmentCount = 3;
+	gbuffer_subpass.pColorAttachments = gbuffer_refs;
+	gbuffer_subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+	//Subpass 1 (lighting), depth is read only so it can be tested against and read at the same time
+	VkAttachmentReference lighting_depth_ref{};
+	lighting_depth_ref.attachment = 1;
+	lighting_depth_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	VkAttachmentReference input_refs[] = {
+		{2,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+		{3,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+		{4,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+		{1,VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL}
+	};
+
+	VkAttachmentReference accum_ref{};
+	accum_ref.attachment = 5;
+	accum_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription lighting_subpass{};
+	lighting_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	lighting_subpass.colorAttachmentCount = 1;
+	lighting_subpass.pColorAttachments = &accum_ref;
+	lighting_subpass.pDepthStencilAttachment = &lighting_depth_ref;
+	lighting_subpass.inputAttachmentCount = 4;
+	lighting_subpass.pInputAttachments = input_refs;
+
+	//Subpass 2 (resolve), gamma corrects the accumulated light into the color target, then light cubes on top
+	VkAttachmentReference resolve_input_ref{};
+	resolve_input_ref.attachment = 5;
+	resolve_input_ref.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkSubpassDescription resolve_subpass{};
+	resolve_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	resolve_subpass.colorAttachmentCount = 1;
+	resolve_subpass.pColorAttachments = &color_attachment_ref;
+	resolve_subpass.pDepthStencilAttachment = &lighting_depth_ref;
+	resolve_subpass.inputAttachmentCount = 1;
+	resolve_subpass.pInputAttachments = &resolve_input_ref;
+
+	VkSubpassDescription deferred_subpasses[] = { gbuffer_subpass,lighting_subpass,resolve_subpass };
+
+	//G-buffer writes -> input attachment reads, per pixel so it can stay in tile memory
+	VkSubpassDependency gbuffer_dependency{};
+	gbuffer_dependency.srcSubpass = 0;
+	gbuffer_dependency.dstSubpass = 1;
+	gbuffer_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	gbuffer_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	gbuffer_dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	gbuffer_dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+	gbuffer_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+	//Accumulated light -> resolve reads
+	VkSubpassDependency accum_dependency{};
+	accum_dependency.srcSubpass = 1;
+	accum_dependency.dstSubpass = 2;
+	accum_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	accum_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	accum_dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	accum_dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+	accum_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+	VkSubpassDependency deferred_readback_dependency = readback_dependency;
+	deferred_readback_dependency.srcSubpass = 2;
+
+	//Previous frame's lighting reads of the G-buffer are done before it is overwritten
+	VkSubpassDependency gbuffer_external_dependency{};
+	gbuffer_external_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	gbuffer_external_dependency.dstSubpass = 0;
+	gbuffer_external_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	gbuffer_external_dependency.srcAccessMask = 0;
+	gbuffer_external_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	gbuffer_external_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	VkSubpassDependency deferred_dependencies[] = { dependency,depth_dependency,gbuffer_external_dependency,gbuffer_dependency,accum_dependency,deferred_readback_dependency };
+
+	//Color target is first written in the resolve subpass
+	deferred_dependencies[0].dstSubpass = 2;
+
+	pass_create_info.attachmentCount = 6;
+	pass_create_info.pAttachments = deferred_attachments;
+
+	pass_create_info.subpassCount = 3;
+	pass_create_info.pSubpasses = deferred_subpasses;
+
+	pass_create_info.dependencyCount = _config._headless ? 6 : 5;
+	pass_create_info.pDependencies = deferred_dependencies;
+
+	VK_CHECK(vkCreateRenderPass(_device, &pass_create_info, nullptr, &_deferredRenderPass));
+
+	/* Overlay render pass (imgui after deferred) */
+	if (!_config._headless) {
+		VkAttachmentDescription overlay_color_attachment = color_attachment;
+		overlay_color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		overlay_color_attachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		VkAttachmentDescription overlay_depth_attachment = depth_attachment;
+		overlay_depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		overlay_depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		VkAttachmentDescription overlay_attachments[] = { overlay_color_attachment,overlay_depth_attachment };
+
+		//Wait for the lighting subpass to finish writing the color target
+		VkSubpassDependency overlay_dependency{};
+		overlay_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		overlay_dependency.dstSubpass = 0;
+		overlay_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		overlay_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		overlay_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		overlay_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		VkSubpassDependency overlay_dependencies[] = { overlay_dependency,depth_dependency };
+
+		pass_create_info.attachmentCount = 2;
+		pass_create_info.pAttachments = overlay_attachments;
+
+		pass_create_info.subpassCount = 1;
+		pass_create_info.pSubpasses = &subpass;
+
+		pass_create_info.dependencyCount = 2;
+		pass_create_info.pDependencies = overlay_dependencies;
+
+		VK_CHECK(vkCreateRenderPass(_device, &pass_create_info, nullptr, &_overlayRenderPass));
+	}
 }
 
 void VkApp::initFrameBuffers()
@@ -592,6 +1030,20 @@ void VkApp::initFrameBuffers()
 		VK_CHECK(vkCreateFramebuffer(_device,&create_info,nullptr,&_frameBuffers[i]));
 	}
 
+	//Deferred, the overlay pass reuses _frameBuffers
+	create_info.renderPass = _deferredRenderPass;
+	_deferredFrameBuffers.resize(numImages);
+
+	for (uint32_t i = 0; i < numImages; i++) {
+
+		VkImageView attachments[] = { _swapchainImageViews[i],_depthImageView,_gBufferAlbedoView,_gBufferSpecularView,_gBufferNormalView,_lightAccumView };
+
+		create_info.attachmentCount = 6;
+		create_info.pAttachments = attachments;
+
+		VK_CHECK(vkCreateFramebuffer(_device, &create_info, nullptr, &_deferredFrameBuffers[i]));
+	}
+
 }
 
 void VkApp::initSync()
@@ -616,50 +1068,48 @@ void VkApp::initSync()
 	VK_CHECK(vkCreateFence(_device, &fence_create_info, nullptr, &_uploadContext._uploadDoneFence));
 }
 
-void VkApp::initSamplers()
+void VkApp::initQueries()
 {
-	VkSamplerCreateInfo info = vk_init::samplerCreateInfo(VK_FILTER_LINEAR);
+	//Timestamps are only valid if the graphics queue supports them
+	_timestampsSupported = _gpuProperties.limits.timestampComputeAndGraphics == VK_TRUE;
 
-	VK_CHECK(vkCreateSampler(_device, &info, nullptr, &_blockySampler));
+	if (!_timestampsSupported) {
+		std::cout << "GPU timestamps not supported, gpu profiling unavailable" << std::endl;
+		return;
+	}
+
+	for (uint32_t i = 0; i < NUM_FRAMES; i++) {
+		_frames[i]._profiler.init(_device, MAX_PROFILER_SCOPES);
+	}
 }
 
-void VkApp::initPipelines()
+void VkApp::initSamplers()
 {
+	VkSamplerCreateInfo info = vk_init::samplerCreateInfo(VK_FILTER_LINEAR);
 
-	/* Light Pipeline Creation */
-	VkShaderModule vertexShader{};
-	VkShaderModule fragShader{};
-
-	std::string vertexShaderPath = SHADER_DIR + std::string{"light.vert.spv"};
-	std::string fragShaderPath = SHADER_DIR + std::string{"light.frag.spv"};
-
-
-	if (!vk_io::loadShaderModule(_device, vertexShaderPath.c_str(), &vertexShader)) {
-		std::cerr << "Couldn't load vertex shader: " << vertexShaderPath << std::endl;
-	}
-	else {
-		std::cout << "Loaded vertex shader: " << vertexShaderPath << std::endl;
+	if (_config._textureFilter != TextureFilter::BILINEAR) {
+		info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		info.maxLod = VK_LOD_CLAMP_NONE;
 	}
 
-	if (!vk_io::loadShaderModule(_device, fragShaderPath.c_str(), &fragShader)) {
-		std::cerr << "Couldn't load fragment shader: " << fragShaderPath << std::endl;
-	}
-	else {
-		std::cout << "Loaded fragment shader: " << fragShaderPath << std::endl;
+	if (_config._textureFilter == TextureFilter::ANISOTROPIC && _anisotropySupported) {
+		info.anisotropyEnable = VK_TRUE;
+		info.maxAnisotropy = std::min(_config._maxAnisotropy, _gpuProperties.limits.maxSamplerAnisotropy);
 	}
 
-	vk_init::PipelineBuilder pipeline_builder{};
-
+	VK_CHECK(vkCreateSampler(_device, &info, nullptr, &_textureSampler));
+}
 
-	pipeline_builder._shaderStages.emplace_back(
-		vk_init::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, vertexShader)
-	);
+void VkApp::initPipelineCache()
+{
+	_pipelineCache.init(_device, _gpuProperties, _config._pipelineCachePath);
+}
 
-	pipeline_builder._shaderStages.emplace_back(
-		vk_init::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragShader)
-	);
+void VkApp::initPipelines()
+{
+	_pipelines.init(_device, _pipelineCache.getCache(), &_threadPool, _windowSize);
 
-	/* Pipeline layout */
+	/* Pipeline layouts */
 
 	VkPipelineLayoutCreateInfo pipeline_layout_info = vk_init::pipelineLayoutCreateInfo();
 
@@ -668,111 +1118,225 @@ void VkApp::initPipelines()
 
 	VK_CHECK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_lightPipelineLayout));
 
-	/* Vertex input */
-
-	VkPipelineVertexInputStateCreateInfo vertex_input_info = vk_init::pipelineVertexInputStateCreateInfo();
-
-	auto description = vk_primitives::mesh::Vertex_F3_F3_F2::getVertexInputDescription();
-
-	vertex_input_info.vertexBindingDescriptionCount = description._bindingDescriptions.size();
-	vertex_input_info.vertexAttributeDescriptionCount = description._attributeDescriptions.size();
-
-	vertex_input_info.pVertexBindingDescriptions = description._bindingDescriptions.data();
-	vertex_input_info.pVertexAttributeDescriptions = description._attributeDescriptions.data();
-
-	pipeline_builder._vertexInputInfo = vertex_input_info;
-
-	/* Input Assembly */
-
-	pipeline_builder._inputAssembly = vk_init::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-
-	pipeline_builder._viewport.x = 0.0f;
-	pipeline_builder._viewport.y = 0.0f;
-	pipeline_builder._viewport.width = (float)_windowSize.width;
-	pipeline_builder._viewport.height = (float)_windowSize.height;
-	pipeline_builder._viewport.minDepth = 0.0f;
-	pipeline_builder._viewport.maxDepth = 1.0f;
-
-	pipeline_builder._scissor.offset = { 0, 0 };
-	pipeline_builder._scissor.extent = _windowSize;
-
-	pipeline_builder._rasterizer = vk_init::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL);
-
-	//we don't use multisampling, so just run the default one
-	pipeline_builder._multisampling = vk_init::pipelineMultisampleStateCreateInfo();
+	pipeline_layout_info = vk_init::pipelineLayoutCreateInfo();
 
-	//a single blend attachment with no blending and writing to RGBA
-	pipeline_builder._colorBlendAttachment = vk_init::pipelineColorBlendAttachmentState();
+	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &_objectDescriptorLayout;
 
+	//Push constants for number of lights + cluster grid
+	VkPushConstantRange push_constant{};
+	push_constant.offset = 0;
+	push_constant.size = sizeof(GPULightingParams);
+	push_constant.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-	pipeline_builder._depthStencil = vk_init::pipelineDepthStencilStateCreateInfo(true, true, VK_COMPARE_OP_LESS_OR_EQUAL);
+	pipeline_layout_info.pushConstantRangeCount = 1;
+	pipeline_layout_info.pPushConstantRanges = &push_constant;
 
+	VK_CHECK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_objectPipelineLayout));
 
-	pipeline_builder._layout = _lightPipelineLayout;
+	pipeline_layout_info = vk_init::pipelineLayoutCreateInfo();
 
-	_lightPipeline = pipeline_builder.build(_device, _renderPass);
+	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &_deferredDescriptorLayout;
 
+	//View + projection to fit each light's screen rectangle
+	VkPushConstantRange volume_push_constant{};
+	volume_push_constant.offset = 0;
+	volume_push_constant.size = sizeof(GPULightVolumeParams);
+	volume_push_constant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-	vkDestroyShaderModule(_device, vertexShader, nullptr);
-	vkDestroyShaderModule(_device, fragShader, nullptr);
+	pipeline_layout_info.pushConstantRangeCount = 1;
+	pipeline_layout_info.pPushConstantRanges = &volume_push_constant;
+
+	VK_CHECK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_lightVolumePipelineLayout));
+
+	/* Light pipelines */
+	vk_pipelines::PipelineDesc desc{};
+	desc._vertexShader = "light.vert.spv";
+	desc._fragmentShader = "light.frag.spv";
+	desc._layout = _lightPipelineLayout;
+	desc._renderPass = _renderPass;
+
+	_lightPipeline = _pipelines.add(desc);
+
+	//Deferred: same cubes drawn over the resolved image, depth is read only there
+	desc._depthWrite = false;
+	desc._renderPass = _deferredRenderPass;
+	desc._subpass = 2;
+
+	_deferredLightPipeline = _pipelines.add(desc);
+
+	/* Depth pre-pass pipeline, positions only and no fragment shader */
+	desc = vk_pipelines::PipelineDesc{};
+	desc._vertexShader = "depth.vert.spv";
+	desc._vertexInput = vk_pipelines::VertexInput::POSITION;
+	desc._blend = vk_pipelines::BlendMode::NO_COLOR;
+	desc._depthCompare = VK_COMPARE_OP_LESS;
+	desc._layout = _objectPipelineLayout;
+	desc._renderPass = _renderPass;
+
+	_depthPrepassPipeline = _pipelines.add(desc);
+
+	/* Resolve pipeline (deferred), fullscreen triangle from gl_VertexIndex */
+	desc = vk_pipelines::PipelineDesc{};
+	desc._vertexShader = "fullscreen.vert.spv";
+	desc._fragmentShader = "resolve.frag.spv";
+	desc._vertexInput = vk_pipelines::VertexInput::NONE;
+	desc._depthTest = false;
+	desc._depthWrite = false;
+	desc._depthCompare = VK_COMPARE_OP_ALWAYS;
+	desc._layout = _lightVolumePipelineLayout;
+	desc._renderPass = _deferredRenderPass;
+	desc._subpass = 2;
+
+	_resolvePipeline = _pipelines.add(desc);
+
+	/* Object + light volume pipelines of the configured shading variant */
+	_shadingPipelines.clear();
+	_activeShading = &getShadingPipelines(getShadingVariant());
+	_activeRenderMode = _config._renderMode;
+
+	//What the starting renderer draws with is compiled now across the pool, the rest compiles in the background.
+	//Other shading variants are compiled when they're first selected
+	std::vector<vk_pipelines::PipelineId> startup_pipelines = getRendererPipelines(_config._renderMode, *_activeShading);
+	std::vector<vk_pipelines::PipelineId> prepass_pipelines{ _depthPrepassPipeline,_activeShading->_objectEqual };
+
+	if (_config._renderMode == RenderMode::FORWARD && _config._depthPrepass) {
+		startup_pipelines.insert(startup_pipelines.end(), prepass_pipelines.begin(), prepass_pipelines.end());
+	}
 
-	/* Object pipeline creation */
+	_pipelines.compile(startup_pipelines);
 
-	vertexShaderPath = SHADER_DIR + std::string{"mesh.vert.spv"};
-	fragShaderPath = SHADER_DIR + std::string{"mesh.frag.spv"};
+	//Already compiled ones are skipped
+	_pipelines.compileAsync(getRendererPipelines(RenderMode::FORWARD, *_activeShading));
+	_pipelines.compileAsync(prepass_pipelines);
+	_pipelines.compileAsync(getRendererPipelines(RenderMode::DEFERRED, *_activeShading));
 
+	/* Cull pipeline creation (compute) */
 
-	if (!vk_io::loadShaderModule(_device, vertexShaderPath.c_str(), &vertexShader)) {
-		std::cerr << "Couldn't load vertex shader: " << vertexShaderPath << std::endl;
-	}
-	else {
-		std::cout << "Loaded vertex shader: " << vertexShaderPath << std::endl;
-	}
+	VkShaderModule computeShader{};
+	std::string computeShaderPath = SHADER_DIR + std::string{"cull.comp.spv"};
 
-	if (!vk_io::loadShaderModule(_device, fragShaderPath.c_str(), &fragShader)) {
-		std::cerr << "Couldn't load fragment shader: " << fragShaderPath << std::endl;
+	if (!vk_io::loadShaderModule(_device, computeShaderPath.c_str(), &computeShader)) {
+		std::cerr << "Couldn't load compute shader: " << computeShaderPath << std::endl;
 	}
 	else {
-		std::cout << "Loaded fragment shader: " << fragShaderPath << std::endl;
+		std::cout << "Loaded compute shader: " << computeShaderPath << std::endl;
 	}
 
-	//Replace shaders
-	pipeline_builder._shaderStages.clear();
-
-	pipeline_builder._shaderStages.emplace_back(
-		vk_init::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, vertexShader)
-	);
+	pipeline_layout_info = vk_init::pipelineLayoutCreateInfo();
 
-	pipeline_builder._shaderStages.emplace_back(
-		vk_init::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragShader)
-	);
+	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &_cullDescriptorLayout;
 
+	//Frustum planes, object count, mesh radius
+	VkPushConstantRange cull_push_constant{};
+	cull_push_constant.offset = 0;
+	cull_push_constant.size = sizeof(GPUCullParams);
+	cull_push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-	//Replace pipeline layout
-	pipeline_layout_info = vk_init::pipelineLayoutCreateInfo();
+	pipeline_layout_info.pushConstantRangeCount = 1;
+	pipeline_layout_info.pPushConstantRanges = &cull_push_constant;
 
+	VK_CHECK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_cullPipelineLayout));
 
-	pipeline_layout_info.setLayoutCount = 1;
-	pipeline_layout_info.pSetLayouts = &_objectDescriptorLayout;
+	VkComputePipelineCreateInfo compute_info{};
+	compute_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	compute_info.pNext = nullptr;
+	compute_info.stage = vk_init::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, computeShader);
+	compute_info.layout = _cullPipelineLayout;
 
-	//Push constants for number of lights
-	VkPushConstantRange push_constant{};
-	push_constant.offset = 0;
-	push_constant.size = sizeof(int);
-	push_constant.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	VK_CHECK(vkCreateComputePipelines(_device, _pipelineCache.getCache(), 1, &compute_info, nullptr, &_cullPipeline));
 
+	vkDestroyShaderModule(_device, computeShader, nullptr);
+}
 
-	pipeline_layout_info.pushConstantRangeCount = 1;
-	pipeline_layout_info.pPushConstantRanges = &push_constant;
+uint64_t ShadingVariant::getKey() const
+{
+	return (static_cast<uint64_t>(_lightCount) << 32) | (static_cast<uint64_t>(_attenuation) << 2) | (_specularMap ? 2u : 0u) | (_clusteredLighting ? 1u : 0u);
+}
 
-	VK_CHECK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_objectPipelineLayout));
+ShadingVariant VkApp::getShadingVariant() const
+{
+	ShadingVariant variant{};
+	variant._clusteredLighting = _config._clusteredLighting;
+	//The cluster loop bound comes from the light lists, only the brute force loop can use a constant
+	variant._lightCount = _config._clusteredLighting ? 0 : _config._lightCount;
+	variant._specularMap = _config._specularMap;
+	variant._attenuation = _config._attenuation;
+	return variant;
+}
 
-	pipeline_builder._layout = _objectPipelineLayout;
+const ShadingPipelines& VkApp::getShadingPipelines(const ShadingVariant& variant)
+{
+	auto it = _shadingPipelines.find(variant.getKey());
+	if (it != _shadingPipelines.end()) {
+		return it->second;
+	}
 
-	_objectPipeline = pipeline_builder.build(_device, _renderPass);
+	ShadingPipelines& shading = _shadingPipelines[variant.getKey()];
+	shading._variant = variant;
+
+	/* Forward object pipelines */
+	vk_pipelines::PipelineDesc desc{};
+	desc._vertexShader = "mesh.vert.spv";
+	desc._fragmentShader = "mesh.frag.spv";
+	//constant_id 0 in mesh.vert: read normal matrices from the object buffer
+	desc._vertexConstants = { _config._precomputedNormals ? VK_TRUE : VK_FALSE };
+	//constant_id 0-3 in mesh.frag
+	desc._fragmentConstants = {
+		variant._clusteredLighting ? VK_TRUE : VK_FALSE,
+		variant._lightCount,
+		variant._specularMap ? VK_TRUE : VK_FALSE,
+		static_cast<uint32_t>(variant._attenuation)
+	};
+	desc._layout = _objectPipelineLayout;
+	desc._renderPass = _renderPass;
+
+	shading._object = _pipelines.add(desc);
+
+	//After a depth pre-pass: only the fragment that won the depth test is shaded, depth is already written
+	desc._depthWrite = false;
+	desc._depthCompare = VK_COMPARE_OP_EQUAL;
+
+	shading._objectEqual = _pipelines.add(desc);
+
+	/* G-buffer (deferred), same vertex stage and layout as the objects, writes albedo, specular, normal */
+	desc._fragmentShader = "gbuffer.frag.spv";
+	desc._fragmentConstants = { variant._specularMap ? VK_TRUE : VK_FALSE };
+	desc._depthWrite = true;
+	desc._depthCompare = VK_COMPARE_OP_LESS_OR_EQUAL;
+	desc._colorAttachmentCount = 3;
+	desc._renderPass = _deferredRenderPass;
+	desc._subpass = 0;
+
+	//Variants only differing in light count/clustering share this one
+	shading._gBuffer = _pipelines.add(desc);
+
+	/* Light volumes (deferred), vertices come from gl_VertexIndex */
+	desc = vk_pipelines::PipelineDesc{};
+	desc._vertexShader = "lightvolume.vert.spv";
+	desc._fragmentShader = "lightvolume.frag.spv";
+	desc._fragmentConstants = { static_cast<uint32_t>(variant._attenuation) };
+	desc._vertexInput = vk_pipelines::VertexInput::NONE;
+	//Volumes add up, each is depth tested against the nearest point of its light's sphere
+	desc._blend = vk_pipelines::BlendMode::ADDITIVE;
+	desc._depthWrite = false;
+	desc._layout = _lightVolumePipelineLayout;
+	desc._renderPass = _deferredRenderPass;
+	desc._subpass = 1;
+
+	shading._lightVolume = _pipelines.add(desc);
+
+	return shading;
+}
 
-	vkDestroyShaderModule(_device, vertexShader, nullptr);
-	vkDestroyShaderModule(_device, fragShader, nullptr);
+std::vector<vk_pipelines::PipelineId> VkApp::getRendererPipelines(RenderMode mode, const ShadingPipelines& shading) const
+{
+	if (mode == RenderMode::FORWARD) {
+		return { _lightPipeline,shading._object };
+	}
+	return { shading._gBuffer,shading._lightVolume,_resolvePipeline,_deferredLightPipeline };
 }
 
 void VkApp::initImgui()
@@ -833,7 +1397,7 @@ void VkApp::initImgui()
 	init_info.Device = _device;
 	init_info.QueueFamily = _graphicsFamilyQueueIndex;
 	init_info.Queue = _graphicsQueue;
-	init_info.PipelineCache = VK_NULL_HANDLE;
+	init_info.PipelineCache = _pipelineCache.getCache();
 	init_info.DescriptorPool = _imguiDescriptorPool;
 	init_info.Subpass = 0;
 	init_info.MinImageCount = NUM_FRAMES;
@@ -855,19 +1419,15 @@ void VkApp::initImgui()
 void VkApp::initBuffers()
 {
 
-	/* Vertex buffers */
-	/*_vertices = std::vector<vk_primitives::mesh::Vertex_F3_F3>{
-		{ {1.0f,1.0f,0.0}, {0.0f,0.0f,0.0f} },
-		{ {-1.0f,1.0f,0.0}, {1.0f,1.0f,1.0f} },
-		{ {-1.0f,-1.0f,0.0}, {1.0f,0.0f,0.0f} },
-		{ {1.0f,-1.0f,0.0}, {0.0f,1.0f,0.0f} },
-	};*/
+	/* Meshes */
 
-	//_vertices = vk_primitives::shapes::Cube::getVertexData();
-	_vertices = vk_primitives::shapes::Cube::getNonIndexedVertexData();
+	//Lights + default object mesh
+	_cubeMesh = _resources.addMesh("cube", vk_primitives::shapes::Cube::getMesh());
 
-	_lights.resize(NUM_LIGHTS);
-	for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
+	uint32_t light_count = _config._lightCount;
+	_lights.resize(light_count);
+	_lightOrbits.resize(light_count);
+	for (uint32_t i = 0; i < light_count; i++) {
 		_lights[i].position = math::Vec4{ 4.0f * i, 6.0f, 2.0f * i,0.0 };
 		/*float r = static_cast<float>(std::rand()) / RAND_MAX;
 		float g = static_cast<float>(std::rand()) / RAND_MAX;
@@ -876,10 +1436,10 @@ void VkApp::initBuffers()
 		float g = 0;
 		float b = 0;
 
-		if (i >= 0 && i < (NUM_LIGHTS / 3)) {
+		if (i >= 0 && i < (light_count / 3)) {
 			r = 1.0;
 		}
-		else if (i >= (NUM_LIGHTS / 3) && i < 2 * (NUM_LIGHTS / 3)) {
+		else if (i >= (light_count / 3) && i < 2 * (light_count / 3)) {
 			g = 1.0;
 		}
 		else {
@@ -889,79 +1449,45 @@ void VkApp::initBuffers()
 		_lights[i].ambient = math::Vec4{ r,g,b,0 };
 		_lights[i].diffuse = math::Vec4{ r,g,b,0 };
 		_lights[i].specular = math::Vec4{ r,g,b,0 };
-		_lights[i]._constantAttenuation = 0.11;
-		_lights[i]._linearAttenuation = .011;
-		_lights[i]._quadraticAttenuation = .02;
-	}
 
+		if (light_count <= NUM_LIGHTS) {
+			//Ring above the spiral, pulsing in and out
+			_lights[i]._constantAttenuation = 0.11;
+			_lights[i]._linearAttenuation = .011;
+			_lights[i]._quadraticAttenuation = .02;
 
+			float dx = static_cast<float>(i + 1) / light_count;
+			_lightOrbits[i] = LightOrbit{ 5.0f,20.0f,10.0f,dx * PI * 2.0f,1.0f };
+		}
+		else {
+			//Many small lights spread through the spiral (~7 unit range)
+			_lights[i]._constantAttenuation = 1.0;
+			_lights[i]._linearAttenuation = 0.7;
+			_lights[i]._quadraticAttenuation = 1.8;
+
+			float radius = 2.0f + 43.0f * static_cast<float>(std::rand()) / RAND_MAX;
+			float height = -6.0f + 12.0f * static_cast<float>(std::rand()) / RAND_MAX;
+			float phase = 2.0f * PI * static_cast<float>(std::rand()) / RAND_MAX;
+			float speed = 0.1f + 0.4f * static_cast<float>(std::rand()) / RAND_MAX;
+			_lightOrbits[i] = LightOrbit{ radius,radius,height,phase,speed };
+		}
 
-	size_t vertex_buffer_size = _vertices.size() * sizeof(vk_primitives::mesh::Vertex_F3_F3_F2);
-	//Create CPU side staging buffer
-	auto vertexStagingBuffer = vk_util::createBuffer(_allocator, vertex_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-	//Create GPU side vertex buffer
-	_vertexBuffer = vk_util::createBuffer(_allocator, vertex_buffer_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+		_lights[i]._radius = vk_lights::cutoffRadius(_lights[i], _config._attenuation);
+	}
 
-	//Copy data into CPU side staging buffer
 	void* data;
-	vmaMapMemory(_allocator, vertexStagingBuffer._allocation, &data);
-
-	memcpy(data, _vertices.data(), vertex_buffer_size);
-
-	vmaUnmapMemory(_allocator, vertexStagingBuffer._allocation);
-
-	//Transfer data from CPU staging buffer to GPU side buffer
-	immediateSubmit([=](VkCommandBuffer cmd) {
-		VkBufferCopy copy;
-		copy.srcOffset = 0;
-		copy.dstOffset = 0;
-		copy.size = vertex_buffer_size;
-		vkCmdCopyBuffer(cmd, vertexStagingBuffer._buffer, _vertexBuffer._buffer, 1, &copy);
-	});
-	
-	//Cleanup temporary staging buffer
-	vmaDestroyBuffer(_allocator, vertexStagingBuffer._buffer, vertexStagingBuffer._allocation);
-	
-	/* Index buffers */
-	/*_indices = std::vector<uint32_t>{
-		0, 2, 3,
-		0, 1, 2
-	};*/
-
-	/*_indices = vk_primitives::shapes::Cube::getIndexData();
-
-	size_t index_buffer_size = _indices.size() * sizeof(uint32_t);
-	//Create CPU side staging buffer
-	auto indexStagingBuffer = vk_util::createBuffer(_allocator, index_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-	//Create GPU side index buffer
-	_indexBuffer = vk_util::createBuffer(_allocator,index_buffer_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
-
-	//Copy data into CPU side staging buffer
-	vmaMapMemory(_allocator, indexStagingBuffer._allocation, &data);
-
-	memcpy(data, _indices.data(), index_buffer_size);
-
-	vmaUnmapMemory(_allocator, indexStagingBuffer._allocation);
-
-	//Transfer data from CPU staging buffer to GPU side buffer
-	immediateSubmit([=](VkCommandBuffer cmd) {
-		VkBufferCopy copy;
-		copy.srcOffset = 0;
-		copy.dstOffset = 0;
-		copy.size = index_buffer_size;
-		vkCmdCopyBuffer(cmd, indexStagingBuffer._buffer, _indexBuffer._buffer, 1, &copy);
-		});
-
-	//Cleanup temporary staging buffer
-	vmaDestroyBuffer(_allocator, indexStagingBuffer._buffer,indexStagingBuffer._allocation);*/
 
 	/* Uniform buffers */
 
-	//Viewproj matrix per frame
-	size_t camera_buffer_size = vk_util::padBufferSize(_gpuProperties.limits.minUniformBufferOffsetAlignment, sizeof(GPUCameraData));
-	camera_buffer_size *= NUM_FRAMES;
+	//Per frame camera + light data, dynamic offsets must satisfy both uniform and storage alignment
+	size_t upload_alignment = std::max(_gpuProperties.limits.minUniformBufferOffsetAlignment, _gpuProperties.limits.minStorageBufferOffsetAlignment);
 
-	_cameraBuffer = vk_util::createBuffer(_allocator, camera_buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+	//Lights and their clusters scale with the light count (at least one light entry, descriptor ranges can't be empty)
+	size_t upload_size = FRAME_UPLOAD_SIZE + sizeof(LightEntity) * std::max(1u, light_count) + sizeof(vk_lights::Cluster) * vk_lights::CLUSTER_COUNT + sizeof(uint32_t) * vk_lights::MAX_CLUSTER_LIGHTS;
+
+	for (uint32_t i = 0; i < NUM_FRAMES; i++) {
+		_frames[i]._uploadAllocator.init(_allocator, upload_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, upload_alignment);
+	}
 
 	size_t material_buffer_size = vk_util::padBufferSize(_gpuProperties.limits.minUniformBufferOffsetAlignment, sizeof(MaterialEntity));
 
@@ -981,47 +1507,24 @@ void VkApp::initBuffers()
 
 	/* Storage buffers */
 
-	
-	size_t light_buffer_size = vk_util::padBufferSize(_gpuProperties.limits.minStorageBufferOffsetAlignment, sizeof(LightEntity));
-	light_buffer_size *= NUM_LIGHTS * NUM_FRAMES;
-
-	_lightBuffer = vk_util::createBuffer(_allocator, light_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-	//Fill buffer with data
-	vmaMapMemory(_allocator, _lightBuffer._allocation, &data);
-
-	LightEntity* light = (LightEntity*)data;
-	for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
-		for (uint32_t j = 0; j < NUM_FRAMES; j++) {
-			light[i + j * NUM_LIGHTS].position = _lights[i].position;
-			light[i + j * NUM_LIGHTS].ambient = _lights[i].ambient;
-			light[i + j * NUM_LIGHTS].diffuse = _lights[i].diffuse;
-			light[i + j * NUM_LIGHTS].specular = _lights[i].specular;
-
-			light[i + j * NUM_LIGHTS]._constantAttenuation = _lights[i]._constantAttenuation;
-			light[i + j * NUM_LIGHTS]._linearAttenuation = _lights[i]._linearAttenuation;
-			light[i + j * NUM_LIGHTS]._quadraticAttenuation = _lights[i]._quadraticAttenuation;
-
-
-		}
-
-	}
-	vmaUnmapMemory(_allocator, _lightBuffer._allocation);
+	//Frame regions and the visible lists inside them start at storage offset aligned boundaries
+	uint32_t object_count = _config._objectCount;
+	size_t storage_alignment = _gpuProperties.limits.minStorageBufferOffsetAlignment;
+	_visibleListOffset = vk_util::padBufferSize(storage_alignment, sizeof(RenderEntity) * std::max(1u, object_count));
+	_objectRegionSize = _visibleListOffset + vk_util::padBufferSize(storage_alignment, sizeof(uint32_t) * std::max(1u, object_count));
+	_objectBuffer = vk_util::createBuffer(_allocator, _objectRegionSize * NUM_FRAMES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
 
-	size_t object_buffer_size  = vk_util::padBufferSize(_gpuProperties.limits.minStorageBufferOffsetAlignment, sizeof(RenderEntity));
-	object_buffer_size *= NUM_OBJECTS;
-	_objectBuffer = vk_util::createBuffer(_allocator, object_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+	vmaMapMemory(_allocator, _objectBuffer._allocation, &_objectBufferData);
 
-	vmaMapMemory(_allocator, _objectBuffer._allocation, &data);
+	_transforms.resize(object_count);
 
-	RenderEntity* renderable = (RenderEntity*)data;
 	float min_r = 10.0;
 	float max_r = 40.0;
 	float height_range = 5.0;
 	float angle_speed = 64.0;
 
-	for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
-		float dx = static_cast<float>(i + 1) / NUM_OBJECTS;
+	for (uint32_t i = 0; i < object_count; i++) {
+		float dx = static_cast<float>(i + 1) / object_count;
 		float h = static_cast<float>(std::rand()) / RAND_MAX;
 		float r = (1.0 - dx) * min_r + dx * max_r;
 		r *= h;
@@ -1031,33 +1534,30 @@ void VkApp::initBuffers()
 		
 
 
-		renderable[i].model = math::Mat4::fromTranslation(r*cos(angle),h, r * sin(angle));
+		_transforms.setPosition(i, math::Vec3{ r * cos(angle),h, r * sin(angle) });
 	}
 
-	vmaUnmapMemory(_allocator, _objectBuffer._allocation);
-}
-
-void VkApp::initImages()
-{
-	std::string diffuse_img_path = IMAGE_DIR + std::string{"crate_diffuse_map.png"};
-	std::string specular_img_path = IMAGE_DIR + std::string{"crate_specular_map.png"};
-
-	if (vk_io::loadImage(*this, diffuse_img_path.c_str(), _diffuseImage)) {
-		std::cout << "Loaded image: " << diffuse_img_path << std::endl;
+	//Spin speeds in radians per second
+	_objectSpeeds.resize(object_count);
+	for (uint32_t i = 0; i < object_count; i++) {
+		_objectSpeeds[i] = 0.5f + 1.5f * static_cast<float>(std::rand()) / RAND_MAX;
 	}
 
-	if (vk_io::loadImage(*this, specular_img_path.c_str(), _specularImage)) {
-		std::cout << "Loaded image: " << specular_img_path << std::endl;
+	//Gpu culling targets, device local
+	for (uint32_t i = 0; i < NUM_FRAMES; i++) {
+		_frames[i]._indirectBuffer = vk_util::createBuffer(_allocator, sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+		_frames[i]._visibleBuffer = vk_util::createBuffer(_allocator, sizeof(uint32_t) * std::max(1u, object_count), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
 	}
 
+	_visibleScratch.resize(object_count);
+	_batchVisibleCounts.resize((object_count + vk_transforms::TRANSFORM_BATCH_SIZE - 1) / vk_transforms::TRANSFORM_BATCH_SIZE);
 
-	//Create image view for diffuse and specular images
-	VkImageViewCreateInfo create_info = vk_init::imageViewCreateInfo(VK_FORMAT_R8G8B8A8_SRGB, _diffuseImage._image, VK_IMAGE_ASPECT_COLOR_BIT);
-	VK_CHECK(vkCreateImageView(_device, &create_info, nullptr, &_diffuseImageView));
-
-	create_info = vk_init::imageViewCreateInfo(VK_FORMAT_R8G8B8A8_SRGB, _specularImage._image, VK_IMAGE_ASPECT_COLOR_BIT);
-	VK_CHECK(vkCreateImageView(_device, &create_info, nullptr, &_specularImageView));
-
+	//Static objects are only written here
+	for (uint32_t i = 0; i < NUM_FRAMES; i++) {
+		RenderEntity* region = reinterpret_cast<RenderEntity*>(static_cast<char*>(_objectBufferData) + i * _objectRegionSize);
+		_transforms.writeEntities(_threadPool, region);
+	}
+	vmaFlushAllocation(_allocator, _objectBuffer._allocation, 0, VK_WHOLE_SIZE);
 }
 
 void VkApp::initDescriptors()
@@ -1090,19 +1590,59 @@ void VkApp::initDescriptors()
 		//Binding 4 (Diffuse Texture)
 		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
 		//Binding 5 (Specular Texture)
-		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5)
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
+		//Binding 6 (Visible object indices, read through gl_InstanceIndex)
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 6),
+		//Binding 7 (Light clusters, offset + count into binding 8)
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT, 7),
+		//Binding 8 (Light indices of every cluster)
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT, 8)
 	};
 
-	VkDescriptorSetLayoutCreateInfo set1_layout_info = vk_init::descriptorSetLayoutCreateInfo(6, mesh_bindings);
+	VkDescriptorSetLayoutCreateInfo set1_layout_info = vk_init::descriptorSetLayoutCreateInfo(9, mesh_bindings);
 	VK_CHECK(vkCreateDescriptorSetLayout(_device, &set1_layout_info, nullptr, &_objectDescriptorLayout));
 
+	/* Cull set (compute) */
+	VkDescriptorSetLayoutBinding cull_bindings[] =
+	{
+		//Binding 0 (Object transforms)
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		//Binding 1 (Visible object indices)
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		//Binding 2 (Indirect draw command)
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2)
+	};
+
+	VkDescriptorSetLayoutCreateInfo cull_layout_info = vk_init::descriptorSetLayoutCreateInfo(3, cull_bindings);
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &cull_layout_info, nullptr, &_cullDescriptorLayout));
+
+	/* Deferred lighting set */
+	VkDescriptorSetLayoutBinding deferred_bindings[] =
+	{
+		//Binding 0 (View-proj + inverse per frame)
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		//Binding 1 (Light instance storage buffer)
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+		//Binding 2-5 (G-buffer albedo, specular, normal, depth)
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
+		//Binding 6 (Accumulated light, read by the resolve subpass)
+		vk_init::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 6)
+	};
+
+	VkDescriptorSetLayoutCreateInfo deferred_layout_info = vk_init::descriptorSetLayoutCreateInfo(7, deferred_bindings);
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &deferred_layout_info, nullptr, &_deferredDescriptorLayout));
+
 	//Create descriptor pool
 	std::vector<VkDescriptorPoolSize> sizes = {
 		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,10},
 		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,10},
-		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,10},
-		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,10},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,10}
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,20},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,20},
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,10},
+		{VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,10}
 	};
 
 	VkDescriptorPoolCreateInfo pool_info{};
@@ -1122,72 +1662,114 @@ void VkApp::initDescriptors()
 	alloc_info.pNext = nullptr;
 	alloc_info.descriptorPool = _descriptorPool;
 	alloc_info.descriptorSetCount = 1;
-	alloc_info.pSetLayouts = &_lightDescriptorSetLayout;
 
-	VK_CHECK(vkAllocateDescriptorSets(_device, &alloc_info,&_lightDescriptorSet));
+	//Write to descriptor set
+	VkDeviceSize bufferSize;
 
-	alloc_info.pSetLayouts = &_objectDescriptorLayout;
+	for (uint32_t i = 0; i < NUM_FRAMES; i++) {
+		RenderFrame& frame = _frames[i];
 
-	VK_CHECK(vkAllocateDescriptorSets(_device, &alloc_info, &_objectDescriptorSet));
+		alloc_info.pSetLayouts = &_lightDescriptorSetLayout;
+		VK_CHECK(vkAllocateDescriptorSets(_device, &alloc_info, &frame._lightDescriptorSet));
 
+		alloc_info.pSetLayouts = &_objectDescriptorLayout;
+		VK_CHECK(vkAllocateDescriptorSets(_device, &alloc_info, &frame._objectDescriptorSet));
 
-	//Write to descriptor set
-	VkDeviceSize bufferSize;
+		alloc_info.pSetLayouts = &_cullDescriptorLayout;
+		VK_CHECK(vkAllocateDescriptorSets(_device, &alloc_info, &frame._cullDescriptorSet));
 
-	//(Set 0,binding 0)
-	bufferSize = vk_util::padBufferSize(_gpuProperties.limits.minUniformBufferOffsetAlignment, sizeof(GPUCameraData));
-	VkDescriptorBufferInfo buffer_info0_0 = vk_init::descriptorBufferInfo(_cameraBuffer._buffer, 0, bufferSize);
+		alloc_info.pSetLayouts = &_deferredDescriptorLayout;
+		VK_CHECK(vkAllocateDescriptorSets(_device, &alloc_info, &frame._deferredDescriptorSet));
 
-	//(Set 0,binding 1)
-	//bufferSize = vk_util::padBufferSize(_gpuProperties.limits.minStorageBufferOffsetAlignment, sizeof(LightEntity))*NUM_LIGHTS*NUM_FRAMES;
-	bufferSize = vk_util::padBufferSize(_gpuProperties.limits.minStorageBufferOffsetAlignment, sizeof(LightEntity)) * NUM_LIGHTS;
+		//(Set 0,binding 0), dynamic offset picks the slice
+		VkDescriptorBufferInfo buffer_info0_0 = vk_init::descriptorBufferInfo(frame._uploadAllocator.getBuffer(), 0, sizeof(GPUCameraData));
 
-	std::cout << "sz: " << bufferSize << std::endl;
-	VkDescriptorBufferInfo buffer_info0_1 = vk_init::descriptorBufferInfo(_lightBuffer._buffer, 0, bufferSize);
+		//(Set 0,binding 1)
+		VkDescriptorBufferInfo buffer_info0_1 = vk_init::descriptorBufferInfo(frame._uploadAllocator.getBuffer(), 0, sizeof(LightEntity) * std::max(1u, _config._lightCount));
 
-	//(Set 1,binding 0)
-	VkDescriptorBufferInfo buffer_info1_0 = buffer_info0_0;
+		//(Set 1,binding 0)
+		VkDescriptorBufferInfo buffer_info1_0 = buffer_info0_0;
 
-	//(Set 1,binding 1)
-	VkDescriptorBufferInfo buffer_info1_1 = buffer_info0_1;
+		//(Set 1,binding 1)
+		VkDescriptorBufferInfo buffer_info1_1 = buffer_info0_1;
 
-	//(Set 1,binding 2)
-	bufferSize = vk_util::padBufferSize(_gpuProperties.limits.minStorageBufferOffsetAlignment, sizeof(RenderEntity)) * NUM_OBJECTS;
-	VkDescriptorBufferInfo buffer_info1_2 = vk_init::descriptorBufferInfo(_objectBuffer._buffer, 0, bufferSize);
+		//(Set 1,binding 2)
+		VkDescriptorBufferInfo buffer_info1_2 = vk_init::descriptorBufferInfo(_objectBuffer._buffer, i * _objectRegionSize, _visibleListOffset);
 
-	//(Set 1,binding 3)
-	bufferSize = vk_util::padBufferSize(_gpuProperties.limits.minUniformBufferOffsetAlignment, sizeof(MaterialEntity));
-	std::cout << "mat size: " << bufferSize << std::endl;
-	VkDescriptorBufferInfo buffer_info1_3 = vk_init::descriptorBufferInfo(_materialBuffer._buffer, 0, bufferSize);
+		//(Set 1,binding 3)
+		bufferSize = vk_util::padBufferSize(_gpuProperties.limits.minUniformBufferOffsetAlignment, sizeof(MaterialEntity));
+		VkDescriptorBufferInfo buffer_info1_3 = vk_init::descriptorBufferInfo(_materialBuffer._buffer, 0, bufferSize);
 
-	//(Set 1,binding 4)
-	VkDescriptorImageInfo img_info1_4{};
-	img_info1_4.sampler = _blockySampler;
-	img_info1_4.imageView = _diffuseImageView;
-	img_info1_4.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		//(Set 1,binding 4)
+		VkDescriptorImageInfo img_info1_4{};
+		img_info1_4.sampler = _textureSampler;
+		img_info1_4.imageView = _resources.get(_diffuseTexture)._view;
+		img_info1_4.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	//(Set 1,binding 5)
-	VkDescriptorImageInfo img_info1_5{};
-	img_info1_5.sampler = _blockySampler;
-	img_info1_5.imageView = _specularImageView;
-	img_info1_5.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		//(Set 1,binding 5)
+		VkDescriptorImageInfo img_info1_5{};
+		img_info1_5.sampler = _textureSampler;
+		img_info1_5.imageView = _resources.get(_specularTexture)._view;
+		img_info1_5.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	VkWriteDescriptorSet writes[] = 
-	{
-		//Set 0
-		vk_init::writeDescriptorBuffer(_lightDescriptorSet,0,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,&buffer_info0_0),
-		vk_init::writeDescriptorBuffer(_lightDescriptorSet,1,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,&buffer_info0_1),
-
-		//Set 1
-		vk_init::writeDescriptorBuffer(_objectDescriptorSet,0,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,&buffer_info1_0),
-		vk_init::writeDescriptorBuffer(_objectDescriptorSet,1,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,&buffer_info1_1),
-		vk_init::writeDescriptorBuffer(_objectDescriptorSet,2,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,&buffer_info1_2),
-		vk_init::writeDescriptorBuffer(_objectDescriptorSet,3,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,&buffer_info1_3),
-		vk_init::writeDescriptorImage(_objectDescriptorSet,4,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,&img_info1_4),
-		vk_init::writeDescriptorImage(_objectDescriptorSet,5,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,&img_info1_5)
-	};
+		//(Set 1,binding 6), written by cull.comp or by the cpu into the object buffer
+		VkDescriptorBufferInfo buffer_info1_6 = vk_init::descriptorBufferInfo(_objectBuffer._buffer, i * _objectRegionSize + _visibleListOffset, _objectRegionSize - _visibleListOffset);
+		if (_config._cullMode == CullMode::GPU) {
+			buffer_info1_6 = vk_init::descriptorBufferInfo(frame._visibleBuffer._buffer, 0, VK_WHOLE_SIZE);
+		}
 
-	vkUpdateDescriptorSets(_device, 8, writes, 0, nullptr);
+		//(Set 1,binding 7-8), per frame like the lights
+		VkDescriptorBufferInfo buffer_info1_7 = vk_init::descriptorBufferInfo(frame._uploadAllocator.getBuffer(), 0, sizeof(vk_lights::Cluster) * vk_lights::CLUSTER_COUNT);
+		VkDescriptorBufferInfo buffer_info1_8 = vk_init::descriptorBufferInfo(frame._uploadAllocator.getBuffer(), 0, sizeof(uint32_t) * vk_lights::MAX_CLUSTER_LIGHTS);
+
+		//(Cull set, bindings 0-2)
+		VkDescriptorBufferInfo cull_info_0 = buffer_info1_2;
+		VkDescriptorBufferInfo cull_info_1 = vk_init::descriptorBufferInfo(frame._visibleBuffer._buffer, 0, VK_WHOLE_SIZE);
+		VkDescriptorBufferInfo cull_info_2 = vk_init::descriptorBufferInfo(frame._indirectBuffer._buffer, 0, sizeof(VkDrawIndexedIndirectCommand));
+
+		//(Deferred set, bindings 2-5)
+		VkDescriptorImageInfo gbuffer_infos[] = {
+			{VK_NULL_HANDLE,_gBufferAlbedoView,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+			{VK_NULL_HANDLE,_gBufferSpecularView,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+			{VK_NULL_HANDLE,_gBufferNormalView,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+			{VK_NULL_HANDLE,_depthImageView,VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL},
+			{VK_NULL_HANDLE,_lightAccumView,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}
+		};
+
+		VkWriteDescriptorSet writes[] = 
+		{
+			//Set 0
+			vk_init::writeDescriptorBuffer(frame._lightDescriptorSet,0,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,&buffer_info0_0),
+			vk_init::writeDescriptorBuffer(frame._lightDescriptorSet,1,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,&buffer_info0_1),
+
+			//Set 1
+			vk_init::writeDescriptorBuffer(frame._objectDescriptorSet,0,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,&buffer_info1_0),
+			vk_init::writeDescriptorBuffer(frame._objectDescriptorSet,1,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,&buffer_info1_1),
+			vk_init::writeDescriptorBuffer(frame._objectDescriptorSet,2,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,&buffer_info1_2),
+			vk_init::writeDescriptorBuffer(frame._objectDescriptorSet,3,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,&buffer_info1_3),
+			vk_init::writeDescriptorImage(frame._objectDescriptorSet,4,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,&img_info1_4),
+			vk_init::writeDescriptorImage(frame._objectDescriptorSet,5,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,&img_info1_5),
+			vk_init::writeDescriptorBuffer(frame._objectDescriptorSet,6,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,&buffer_info1_6),
+			vk_init::writeDescriptorBuffer(frame._objectDescriptorSet,7,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,&buffer_info1_7),
+			vk_init::writeDescriptorBuffer(frame._objectDescriptorSet,8,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,&buffer_info1_8),
+
+			//Cull set
+			vk_init::writeDescriptorBuffer(frame._cullDescriptorSet,0,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,&cull_info_0),
+			vk_init::writeDescriptorBuffer(frame._cullDescriptorSet,1,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,&cull_info_1),
+			vk_init::writeDescriptorBuffer(frame._cullDescriptorSet,2,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,&cull_info_2),
+
+			//Deferred set
+			vk_init::writeDescriptorBuffer(frame._deferredDescriptorSet,0,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,&buffer_info0_0),
+			vk_init::writeDescriptorBuffer(frame._deferredDescriptorSet,1,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,&buffer_info0_1),
+			vk_init::writeDescriptorImage(frame._deferredDescriptorSet,2,VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,&gbuffer_infos[0]),
+			vk_init::writeDescriptorImage(frame._deferredDescriptorSet,3,VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,&gbuffer_infos[1]),
+			vk_init::writeDescriptorImage(frame._deferredDescriptorSet,4,VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,&gbuffer_infos[2]),
+			vk_init::writeDescriptorImage(frame._deferredDescriptorSet,5,VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,&gbuffer_infos[3]),
+			vk_init::writeDescriptorImage(frame._deferredDescriptorSet,6,VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,&gbuffer_infos[4])
+		};
+
+		vkUpdateDescriptorSets(_device, static_cast<uint32_t>(std::size(writes)), writes, 0, nullptr);
+	}
 }
 
 
@@ -1199,6 +1781,11 @@ void VkApp::destroyWindow()
 	glfwTerminate();
 }
 
+void VkApp::destroyJobs()
+{
+	_threadPool.destroy();
+}
+
 void VkApp::destroyVulkan()
 {
 	vmaDestroyAllocator(_allocator);
@@ -1213,6 +1800,19 @@ void VkApp::destroySwapchain()
 	vkDestroyImageView(_device, _depthImageView, nullptr);
 	vmaDestroyImage(_allocator, _depthImage._image, _depthImage._allocation);
 
+	vkDestroyImageView(_device, _gBufferAlbedoView, nullptr);
+	vmaDestroyImage(_allocator, _gBufferAlbedo._image, _gBufferAlbedo._allocation);
+	vkDestroyImageView(_device, _gBufferSpecularView, nullptr);
+	vmaDestroyImage(_allocator, _gBufferSpecular._image, _gBufferSpecular._allocation);
+	vkDestroyImageView(_device, _gBufferNormalView, nullptr);
+	vmaDestroyImage(_allocator, _gBufferNormal._image, _gBufferNormal._allocation);
+	vkDestroyImageView(_device, _lightAccumView, nullptr);
+	vmaDestroyImage(_allocator, _lightAccum._image, _lightAccum._allocation);
+
+	if (_config._headless) {
+		destroyOffscreenTargets();
+		return;
+	}
 
 	for (uint32_t i = 0; i < _swapchainImageViews.size(); i++) {
 		vkDestroyImageView(_device, _swapchainImageViews[i], nullptr);
@@ -1221,6 +1821,18 @@ void VkApp::destroySwapchain()
 	vkDestroySurfaceKHR(_instance, _surface, nullptr);
 }
 
+void VkApp::destroyOffscreenTargets()
+{
+	for (uint32_t i = 0; i < _offscreenImages.size(); i++) {
+		vkDestroyImageView(_device, _swapchainImageViews[i], nullptr);
+		vmaDestroyImage(_allocator, _offscreenImages[i]._image, _offscreenImages[i]._allocation);
+
+		if (_config._readback) {
+			vmaDestroyBuffer(_allocator, _frames[i]._readbackBuffer._buffer, _frames[i]._readbackBuffer._allocation);
+		}
+	}
+}
+
 void VkApp::destroyCommands()
 {
 	for (uint32_t i = 0; i < NUM_FRAMES; i++) {
@@ -1228,17 +1840,25 @@ void VkApp::destroyCommands()
 	}
 
 	vkDestroyCommandPool(_device, _uploadContext._commandPool, nullptr);
+
+	_uploadQueue.destroy();
 }
 
 void VkApp::destroyRenderPasses()
 {
 	vkDestroyRenderPass(_device, _renderPass, nullptr);
+	vkDestroyRenderPass(_device, _deferredRenderPass, nullptr);
+
+	if (!_config._headless) {
+		vkDestroyRenderPass(_device, _overlayRenderPass, nullptr);
+	}
 }
 
 void VkApp::destroyFrameBuffers()
 {
 	for (uint32_t i = 0; i < _frameBuffers.size(); i++) {
 		vkDestroyFramebuffer(_device, _frameBuffers[i], nullptr);
+		vkDestroyFramebuffer(_device, _deferredFrameBuffers[i], nullptr);
 	}
 }
 
@@ -1255,17 +1875,33 @@ void VkApp::destroySync()
 	vkDestroyFence(_device, _uploadContext._uploadDoneFence, nullptr);
 }
 
+void VkApp::destroyQueries()
+{
+	for (uint32_t i = 0; i < NUM_FRAMES; i++) {
+		_frames[i]._profiler.destroy(_device);
+	}
+}
+
 void VkApp::destroySamplers()
 {
-	vkDestroySampler(_device, _blockySampler, nullptr);
+	vkDestroySampler(_device, _textureSampler, nullptr);
 }
 
 void VkApp::destroyPipelines()
 {
+	_pipelines.destroy();
+	_shadingPipelines.clear();
 	vkDestroyPipelineLayout(_device, _lightPipelineLayout, nullptr);
 	vkDestroyPipelineLayout(_device, _objectPipelineLayout, nullptr);
-	vkDestroyPipeline(_device, _lightPipeline, nullptr);
-	vkDestroyPipeline(_device, _objectPipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _cullPipelineLayout, nullptr);
+	vkDestroyPipeline(_device, _cullPipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _lightVolumePipelineLayout, nullptr);
+}
+
+void VkApp::destroyPipelineCache()
+{
+	_pipelineCache.save();
+	_pipelineCache.destroy();
 }
 
 void VkApp::destroyImgui()
@@ -1290,16 +1926,76 @@ void VkApp::drawUI()
 			if (ImGui::MenuItem("Parameter Menu")) {
 				_viewerOpen = !_viewerOpen;
 			}
+
+			if (ImGui::MenuItem("Profiler")) {
+				_profilerOpen = !_profilerOpen;
+			}
 			
 			ImGui::EndMenu();
 		}
 
-		std::string num = "# LIGHTS: " + std::to_string(NUM_LIGHTS);
+		//The other renderer's pipelines compile in the background, draw() switches over once they're ready
+		if (ImGui::BeginMenu("Renderer"))
+		{
+			if (ImGui::MenuItem("Forward", nullptr, _config._renderMode == RenderMode::FORWARD)) {
+				_config._renderMode = RenderMode::FORWARD;
+			}
+
+			if (ImGui::MenuItem("Deferred", nullptr, _config._renderMode == RenderMode::DEFERRED)) {
+				_config._renderMode = RenderMode::DEFERRED;
+			}
+
+			ImGui::Separator();
+
+			if (ImGui::MenuItem("Depth pre-pass", nullptr, _config._depthPrepass, _config._renderMode == RenderMode::FORWARD)) {
+				_config._depthPrepass = !_config._depthPrepass;
+			}
+
+			ImGui::EndMenu();
+		}
+
+		//Each combination is its own set of pipelines, compiled in the background the first time it's picked
+		if (ImGui::BeginMenu("Shading"))
+		{
+			if (ImGui::MenuItem("Clustered lighting", nullptr, _config._clusteredLighting, _config._renderMode == RenderMode::FORWARD)) {
+				_config._clusteredLighting = !_config._clusteredLighting;
+			}
+
+			if (ImGui::MenuItem("Specular map", nullptr, _config._specularMap)) {
+				_config._specularMap = !_config._specularMap;
+			}
+
+			ImGui::Separator();
+
+			if (ImGui::MenuItem("Polynomial attenuation", nullptr, _config._attenuation == AttenuationModel::POLYNOMIAL)) {
+				_config._attenuation = AttenuationModel::POLYNOMIAL;
+			}
+
+			if (ImGui::MenuItem("Inverse square attenuation", nullptr, _config._attenuation == AttenuationModel::INVERSE_SQUARE)) {
+				_config._attenuation = AttenuationModel::INVERSE_SQUARE;
+			}
+
+			ImGui::EndMenu();
+		}
+
+		std::string num = "# LIGHTS: " + std::to_string(_config._lightCount);
+		ImGui::Text(num.c_str());
+
+		num = "# OBJECTS: " + std::to_string(_config._objectCount);
 		ImGui::Text(num.c_str());
 
-		num = "# OBJECTS: " + std::to_string(NUM_OBJECTS);
+		num = _config._cullMode == CullMode::GPU ? std::string{ "# VISIBLE: (gpu)" } : "# VISIBLE: " + std::to_string(_visibleObjectCount);
 		ImGui::Text(num.c_str());
 
+		num = "# RESOURCES: " + std::to_string(_resources.getResourceCount()) + " (" + std::to_string(_resources.getResidentBytes() / (1024 * 1024)) + " MB)";
+		ImGui::Text(num.c_str());
+
+		uint32_t pending_pipelines = _pipelines.getPendingCount();
+		if (pending_pipelines > 0) {
+			num = "# COMPILING: " + std::to_string(pending_pipelines);
+			ImGui::Text(num.c_str());
+		}
+
 
 		ImGui::EndMainMenuBar();
 
@@ -1309,10 +2005,13 @@ void VkApp::drawUI()
 
 		ImGui::Begin("Parameter Menu");
 
-		std::string light_str = "Lights [" + std::to_string(NUM_LIGHTS) + "]";
+		//Only the first few lights are editable
+		uint32_t ui_lights = std::min(_config._lightCount, MAX_UI_LIGHTS);
+
+		std::string light_str = "Lights [" + std::to_string(ui_lights) + "/" + std::to_string(_config._lightCount) + "]";
 		if (ImGui::CollapsingHeader(light_str.c_str(), ImGuiTreeNodeFlags_DefaultOpen)) {
 
-			for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
+			for (uint32_t i = 0; i < ui_lights; i++) {
 				
 				std::string light_i = "Light [" + std::to_string(i) + "]";
 				if (ImGui::CollapsingHeader(light_i.c_str(), ImGuiTreeNodeFlags_DefaultOpen)) {
@@ -1368,26 +2067,54 @@ void VkApp::drawUI()
 
 	}
 
+	if (_profilerOpen) {
+
+		ImGui::Begin("Profiler");
+
+		ImGuiIO& io = ImGui::GetIO();
+		ImGui::Text("CPU frame: %.3f ms (%.1f fps)", 1000.0f / io.Framerate, io.Framerate);
+
+		if (!_timestampsSupported) {
+			ImGui::Text("GPU timestamps not supported");
+		}
+
+		//Indent passes under the frame scope
+		for (size_t i = 0; i < _profilerTimings.size(); i++) {
+			const auto& timing = _profilerTimings[i];
+			if (i == 0) {
+				ImGui::Text("GPU %s: %.3f ms", timing._name.c_str(), timing._ms);
+			}
+			else {
+				ImGui::BulletText("%s: %.3f ms", timing._name.c_str(), timing._ms);
+			}
+		}
+
+		ImGui::End();
+	}
+
 	//ImGui::End();
 }
 
 void VkApp::destroyBuffers()
 {
-	vmaDestroyBuffer(_allocator, _vertexBuffer._buffer, _vertexBuffer._allocation);
-	vmaDestroyBuffer(_allocator, _indexBuffer._buffer, _indexBuffer._allocation);
-	vmaDestroyBuffer(_allocator, _cameraBuffer._buffer, _cameraBuffer._allocation);
 	vmaDestroyBuffer(_allocator, _materialBuffer._buffer, _materialBuffer._allocation);
-	vmaDestroyBuffer(_allocator, _lightBuffer._buffer, _lightBuffer._allocation);
+	vmaUnmapMemory(_allocator, _objectBuffer._allocation);
 	vmaDestroyBuffer(_allocator, _objectBuffer._buffer, _objectBuffer._allocation);
+
+	for (uint32_t i = 0; i < NUM_FRAMES; i++) {
+		_frames[i]._uploadAllocator.destroy(_allocator);
+		vmaDestroyBuffer(_allocator, _frames[i]._indirectBuffer._buffer, _frames[i]._indirectBuffer._allocation);
+		vmaDestroyBuffer(_allocator, _frames[i]._visibleBuffer._buffer, _frames[i]._visibleBuffer._allocation);
+	}
 }
 
-void VkApp::destroyImages()
+void VkApp::destroyResources()
 {
-	vkDestroyImageView(_device, _diffuseImageView, nullptr);
-	vkDestroyImageView(_device, _specularImageView, nullptr);
-
-	vmaDestroyImage(_allocator, _diffuseImage._image, _diffuseImage._allocation);
-	vmaDestroyImage(_allocator, _specularImage._image, _specularImage._allocation);
+	_resources.release(_diffuseTexture);
+	_resources.release(_specularTexture);
+	_resources.release(_cubeMesh);
+	_resources.release(_loadedMesh);
+	_resources.destroy();
 }
 
 void VkApp::destroyDescriptors()
@@ -1395,6 +2122,8 @@ void VkApp::destroyDescriptors()
 	vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(_device, _lightDescriptorSetLayout, nullptr);
 	vkDestroyDescriptorSetLayout(_device, _objectDescriptorLayout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _cullDescriptorLayout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _deferredDescriptorLayout, nullptr);
 }
 
 RenderFrame& VkApp::getFrame()
@@ -1402,6 +2131,328 @@ RenderFrame& VkApp::getFrame()
 	return _frames[_frameNum % NUM_FRAMES];
 }
 
+double VkApp::getTime()
+{
+	//Deterministic clock for reproducible runs
+	if (_config._fixedTimestep > 0.0) {
+		return _frameNum * _config._fixedTimestep;
+	}
+
+	if (_config._headless) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - _startTime).count();
+	}
+	return glfwGetTime();
+}
+
+void VkApp::dumpFrame(RenderFrame& frame)
+{
+	frame._readbackPending = false;
+
+	if (_config._dumpDir.empty()) {
+		return;
+	}
+
+	uint32_t width = _windowSize.width;
+	uint32_t height = _windowSize.height;
+
+	vmaInvalidateAllocation(_allocator, frame._readbackBuffer._allocation, 0, VK_WHOLE_SIZE);
+
+	void* data;
+	vmaMapMemory(_allocator, frame._readbackBuffer._allocation, &data);
+
+	//Offscreen target is BGRA, image writers want RGB
+	const uint8_t* bgra = (const uint8_t*)data;
+	std::vector<uint8_t> rgb(width * height * 3);
+	for (uint32_t i = 0; i < width * height; i++) {
+		rgb[i * 3 + 0] = bgra[i * 4 + 2];
+		rgb[i * 3 + 1] = bgra[i * 4 + 1];
+		rgb[i * 3 + 2] = bgra[i * 4 + 0];
+	}
+
+	vmaUnmapMemory(_allocator, frame._readbackBuffer._allocation);
+
+	std::filesystem::create_directories(_config._dumpDir);
+
+	char name[32];
+	bool png = _config._dumpFormat == DumpFormat::PNG;
+	std::snprintf(name, sizeof(name), "frame_%05u.%s", frame._readbackFrameNum, png ? "png" : "ppm");
+	std::string path = (std::filesystem::path{ _config._dumpDir } / name).string();
+
+	bool written = png ?
+		vk_io::writePNG(path.c_str(), width, height, rgb.data()) :
+		vk_io::writePPM(path.c_str(), width, height, rgb.data());
+
+	if (!written) {
+		std::cerr << "Couldn't write frame: " << path << std::endl;
+	}
+}
+
+uint32_t VkApp::updateObjects(uint32_t frameIdx, float time, const math::Frustum& frustum)
+{
+	char* region = static_cast<char*>(_objectBufferData) + frameIdx * _objectRegionSize;
+	RenderEntity* entities = reinterpret_cast<RenderEntity*>(region);
+	uint32_t* visible = reinterpret_cast<uint32_t*>(region + _visibleListOffset);
+
+	math::Vec3 up{ 0.0f,1.0f,0.0f };
+	float radius = getObjectMesh()._boundingRadius;
+
+	//The gpu builds its own visible list, static objects then need no cpu work at all
+	bool cpu_visible_list = _config._cullMode != CullMode::GPU;
+	if (!cpu_visible_list && !_config._animateObjects) {
+		return _transforms.getCount();
+	}
+
+	//Rotations, matrices and culling for a batch all happen while the batch is in cache
+	_threadPool.parallelFor(_transforms.getCount(), vk_transforms::TRANSFORM_BATCH_SIZE, [&](uint32_t begin, uint32_t end) {
+		if (_config._animateObjects) {
+			for (uint32_t i = begin; i < end; i++) {
+				_transforms.setRotation(i, math::Quat::fromAxisAngle(time * _objectSpeeds[i], up));
+			}
+			_transforms.writeEntities(begin, end, entities);
+		}
+
+		if (!cpu_visible_list) {
+			return;
+		}
+
+		uint32_t* batch_visible = _visibleScratch.data() + begin;
+		uint32_t count = end - begin;
+
+		if (_config._cullMode == CullMode::CPU) {
+			count = _transforms.cull(begin, end, frustum, radius, batch_visible);
+		}
+		else {
+			for (uint32_t i = begin; i < end; i++) {
+				batch_visible[i - begin] = i;
+			}
+		}
+
+		_batchVisibleCounts[begin / vk_transforms::TRANSFORM_BATCH_SIZE] = count;
+	});
+
+	//Compact in batch order so the draw order doesn't depend on thread timing
+	uint32_t visible_count = _transforms.getCount();
+	if (cpu_visible_list) {
+		visible_count = 0;
+		for (size_t i = 0; i < _batchVisibleCounts.size(); i++) {
+			uint32_t count = _batchVisibleCounts[i];
+			memcpy(visible + visible_count, _visibleScratch.data() + i * vk_transforms::TRANSFORM_BATCH_SIZE, count * sizeof(uint32_t));
+			visible_count += count;
+		}
+	}
+
+	vmaFlushAllocation(_allocator, _objectBuffer._allocation, frameIdx * _objectRegionSize, _objectRegionSize);
+
+	return visible_count;
+}
+
+void VkApp::recordCulling(VkCommandBuffer cmd, RenderFrame& frame, const math::Frustum& frustum)
+{
+	//Full index count, instances are appended by the shader
+	VkDrawIndexedIndirectCommand draw_command{};
+	draw_command.indexCount = getObjectMesh()._indexCount;
+	vkCmdUpdateBuffer(cmd, frame._indirectBuffer._buffer, 0, sizeof(VkDrawIndexedIndirectCommand), &draw_command);
+
+	//Reset visible to the shader's atomics, last frame's draw has finished reading (fence)
+	VkMemoryBarrier reset_barrier{};
+	reset_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	reset_barrier.pNext = nullptr;
+	reset_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	reset_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &reset_barrier, 0, nullptr, 0, nullptr);
+
+	GPUCullParams params{};
+	for (int i = 0; i < math::Frustum::PLANE_COUNT; i++) {
+		params.planes[i] = frustum[i];
+	}
+	params.objectCount = _transforms.getCount();
+	params.radius = getObjectMesh()._boundingRadius;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipelineLayout, 0, 1, &frame._cullDescriptorSet, 0, nullptr);
+	vkCmdPushConstants(cmd, _cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullParams), &params);
+
+	vkCmdDispatch(cmd, (params.objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	//Visible list feeds the vertex shader, the command feeds the draw
+	VkMemoryBarrier cull_barrier{};
+	cull_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cull_barrier.pNext = nullptr;
+	cull_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cull_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &cull_barrier, 0, nullptr, 0, nullptr);
+}
+
+GPULightingParams VkApp::updateLights(RenderFrame& frame, float time, const math::Mat4& view, const math::Mat4& proj, uint32_t offsets[3])
+{
+	uint32_t light_count = _config._lightCount;
+
+	//Same size as the descriptor range so the dynamic offset never reaches past this frame's data
+	vk_alloc::Allocation light_alloc = frame._uploadAllocator.allocate(sizeof(LightEntity) * std::max(1u, light_count));
+
+	LightEntity* light = (LightEntity*)light_alloc._data;
+	for (uint32_t i = 0; i < light_count; i++) {
+		const LightOrbit& orbit = _lightOrbits[i];
+
+		float src = (sin(time) + 1.0) * 0.5;
+		float r = (1.0 - src) * orbit._minRadius + src * orbit._maxRadius;
+		float angle = time * orbit._speed + orbit._phase;
+		_lights[i].position = math::Vec4{ r * cos(angle),orbit._height,r * sin(angle),0.0 };
+
+		//Attenuation/colors can change from the ui
+		_lights[i]._radius = vk_lights::cutoffRadius(_lights[i], _activeShading->_variant._attenuation);
+
+		light[i] = _lights[i];
+	}
+
+	//Clusters are always allocated so the descriptor offsets stay valid, only filled when used
+	vk_alloc::Allocation cluster_alloc = frame._uploadAllocator.allocate(sizeof(vk_lights::Cluster) * vk_lights::CLUSTER_COUNT);
+	vk_alloc::Allocation index_alloc = frame._uploadAllocator.allocate(sizeof(uint32_t) * vk_lights::MAX_CLUSTER_LIGHTS);
+
+	//Deferred shades with light volumes instead
+	if (_activeShading->_variant._clusteredLighting && _activeRenderMode == RenderMode::FORWARD) {
+		//Written in place, the index list is bounded by the allocation
+		_lightGrid.build(
+			_threadPool, _lights.data(), light_count, view, proj, CAMERA_NEAR, CAMERA_FAR,
+			static_cast<vk_lights::Cluster*>(cluster_alloc._data), static_cast<uint32_t*>(index_alloc._data), vk_lights::MAX_CLUSTER_LIGHTS
+		);
+
+		if (_lightGrid.getOverflow() > 0 && !_clusterOverflowWarned) {
+			std::cout << "Light clusters full, dropped " << _lightGrid.getOverflow() << " light references" << std::endl;
+			_clusterOverflowWarned = true;
+		}
+	}
+
+	offsets[0] = light_alloc._offset;
+	offsets[1] = cluster_alloc._offset;
+	offsets[2] = index_alloc._offset;
+
+	GPULightingParams params{};
+	params.numLights = static_cast<int32_t>(light_count);
+	params.clusterX = vk_lights::CLUSTER_X;
+	params.clusterY = vk_lights::CLUSTER_Y;
+	params.clusterZ = vk_lights::CLUSTER_Z;
+	params.tileSize[0] = static_cast<float>(_windowSize.width) / vk_lights::CLUSTER_X;
+	params.tileSize[1] = static_cast<float>(_windowSize.height) / vk_lights::CLUSTER_Y;
+	params.zNear = CAMERA_NEAR;
+	params.zScale = vk_lights::CLUSTER_Z / std::log(CAMERA_FAR / CAMERA_NEAR);
+
+	return params;
+}
+
+void VkApp::drawLights(VkCommandBuffer cmd, RenderFrame& frame, VkPipeline pipeline, const uint32_t* dynamicOffsets)
+{
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	const GPUMesh& cube_mesh = _resources.get(_cubeMesh);
+
+	//Bind vertex buffer
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(cmd, 0, 1, &cube_mesh._vertexBuffer._buffer, &offset);
+
+	//Bind index buffer
+	vkCmdBindIndexBuffer(cmd, cube_mesh._indexBuffer._buffer, offset, cube_mesh._indexType);
+
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _lightPipelineLayout, 0, 1, &frame._lightDescriptorSet, 2, dynamicOffsets);
+	
+	//Instanced draw
+	vkCmdDrawIndexed(cmd, cube_mesh._indexCount, _config._lightCount, 0, 0, 0);
+}
+
+void VkApp::drawObjects(VkCommandBuffer cmd, RenderFrame& frame, VkPipeline pipeline, const uint32_t* dynamicOffsets, const GPULightingParams& lighting, bool positionsOnly)
+{
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	const GPUMesh& object_mesh = getObjectMesh();
+
+	//Bind vertex buffer
+	VkDeviceSize offset = 0;
+	const VkBuffer& vertex_buffer = positionsOnly ? object_mesh._positionBuffer._buffer : object_mesh._vertexBuffer._buffer;
+	vkCmdBindVertexBuffers(cmd, 0, 1, &vertex_buffer, &offset);
+
+	//Bind index buffer
+	vkCmdBindIndexBuffer(cmd, object_mesh._indexBuffer._buffer, offset, object_mesh._indexType);
+
+	//View/proj
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _objectPipelineLayout, 0, 1, &frame._objectDescriptorSet, 4, dynamicOffsets);
+
+	//Set # lights + cluster grid
+	vkCmdPushConstants(cmd, _objectPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(GPULightingParams), &lighting);
+
+	//Instanced draw, instance i draws object visible[i]
+	if (_config._cullMode == CullMode::GPU) {
+		//Instance count was written by cull.comp
+		vkCmdDrawIndexedIndirect(cmd, frame._indirectBuffer._buffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+	}
+	else {
+		vkCmdDrawIndexed(cmd, object_mesh._indexCount, _visibleObjectCount, 0, 0, 0);
+	}
+}
+
+const GPUMesh& VkApp::getObjectMesh() const
+{
+	const GPUMesh& loaded_mesh = _resources.get(_loadedMesh);
+	return loaded_mesh._indexCount > 0 ? loaded_mesh : _resources.get(_cubeMesh);
+}
+
+void VkApp::resolveTimestamps(RenderFrame& frame)
+{
+	//Frame fence has signaled, so this doesn't wait
+	if (!frame._profiler.resolve(_device, _gpuProperties.limits.timestampPeriod)) {
+		return;
+	}
+
+	const auto& timings = frame._profiler.getTimings();
+
+	//Exponential moving average for the profiler panel
+	if (_profilerTimings.size() != timings.size()) {
+		_profilerTimings = timings;
+	}
+	for (size_t i = 0; i < timings.size(); i++) {
+		_profilerTimings[i]._name = timings[i]._name;
+		_profilerTimings[i]._ms = _profilerTimings[i]._ms * 0.9 + timings[i]._ms * 0.1;
+	}
+
+	if (_config._collectGpuTimes) {
+		//First scope covers the whole frame
+		GpuFrameTime time{};
+		time._frameNum = frame._profiledFrameNum;
+		time._ms = timings.front()._ms;
+		time._scopes.assign(timings.begin() + 1, timings.end());
+		_gpuFrameTimes.push_back(time);
+	}
+}
+
+const VkPhysicalDeviceProperties& VkApp::getGpuProperties() const
+{
+	return _gpuProperties;
+}
+
+std::vector<GpuFrameTime> VkApp::takeGpuFrameTimes()
+{
+	std::vector<GpuFrameTime> times{};
+	times.swap(_gpuFrameTimes);
+	return times;
+}
+
+void VkApp::finishFrames()
+{
+	for (uint32_t i = 0; i < NUM_FRAMES; i++) {
+		VK_CHECK(vkWaitForFences(_device, 1, &_frames[i]._renderDoneFence, true, 1000000000));
+	}
+
+	//Resolve in frame order
+	for (uint32_t i = 0; i < NUM_FRAMES; i++) {
+		RenderFrame& frame = _frames[(_frameNum + i) % NUM_FRAMES];
+		if (frame._readbackPending) {
+			dumpFrame(frame);
+		}
+		resolveTimestamps(frame);
+	}
+}
+
 void VkApp::immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function)
 {
 	VkCommandBuffer cmd = _uploadContext._commandBuffer;
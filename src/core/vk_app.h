@@ -1,6 +1,15 @@
 #pragma once
 
 #include "vk_types.h"
+#include "vk_profiler.h"
+#include "vk_alloc.h"
+#include "vk_upload.h"
+#include "vk_jobs.h"
+#include "vk_transforms.h"
+#include "vk_lights.h"
+#include "vk_cache.h"
+#include "vk_pipelines.h"
+#include "vk_resources.h"
 
 #include "primitives/mesh.h"
 #include "primitives/camera.h"
@@ -9,11 +18,22 @@
 
 #include <vector>
 #include <functional>
+#include <string>
+#include <chrono>
+#include <unordered_map>
 
 constexpr uint32_t NUM_FRAMES = 2;
 constexpr uint32_t NUM_LIGHTS = 9;
+//Lights listed in the parameter menu
+constexpr uint32_t MAX_UI_LIGHTS = 16;
 constexpr uint32_t NUM_OBJECTS = 3000;
+constexpr uint32_t MAX_PROFILER_SCOPES = 16;
+constexpr size_t FRAME_UPLOAD_SIZE = 4 * 1024 * 1024;
+//local_size_x of cull.comp
+constexpr uint32_t CULL_GROUP_SIZE = 64;
 constexpr float PI = 3.14;
+constexpr float CAMERA_NEAR = 0.1f;
+constexpr float CAMERA_FAR = 200.0f;
 
 /* Frame */
 struct RenderFrame {
@@ -25,12 +45,182 @@ struct RenderFrame {
 	VkFence _renderDoneFence;
 	VkSemaphore _imgReadyFlag;
 	VkSemaphore _renderDoneFlag;
+
+	/* Transient uniform/storage data */
+	vk_alloc::LinearAllocator _uploadAllocator;
+
+	/* Descriptors (bound to this frame's upload buffer) */
+	VkDescriptorSet _lightDescriptorSet;
+	VkDescriptorSet _objectDescriptorSet;
+
+	/* Timing */
+	vk_profiler::FrameProfiler _profiler;
+	uint32_t _profiledFrameNum{ 0 };
+
+	/* Gpu culling output (indirect draw command + visible object list) */
+	vk_types::AllocatedBuffer _indirectBuffer;
+	vk_types::AllocatedBuffer _visibleBuffer;
+	VkDescriptorSet _cullDescriptorSet;
+
+	/* Deferred lighting (camera/lights from the upload buffer + G-buffer input attachments) */
+	VkDescriptorSet _deferredDescriptorSet;
+
+	/* Headless readback */
+	vk_types::AllocatedBuffer _readbackBuffer;
+	bool _readbackPending{ false };
+	uint32_t _readbackFrameNum{ 0 };
+};
+
+/* Config */
+enum class DumpFormat {
+	PPM,
+	PNG
+};
+
+enum class CullMode {
+	//Draw every object
+	NONE,
+	//Frustum cull in the transform batches, the cpu writes the visible list
+	CPU,
+	//Compute pass culls and writes the visible list + indirect draw
+	GPU
+};
+
+enum class TextureFilter {
+	//Linear within the full size level only, minified textures alias
+	BILINEAR,
+	//Linear within and between mip levels
+	TRILINEAR,
+	//Trilinear + anisotropic taps along the footprint, trilinear when the device can't
+	ANISOTROPIC
+};
+
+enum class RenderMode {
+	//Objects shade every light (or their cluster's lights) while drawing
+	FORWARD,
+	//Objects write a G-buffer, lights are drawn as screen space volumes over it
+	DEFERRED
+};
+
+/* Shader features baked into pipelines as specialization constants, each combination gets its own pipelines */
+struct ShadingVariant {
+	//mesh.frag: cluster light lists instead of every light for every fragment
+	bool _clusteredLighting;
+	//mesh.frag: brute force loop bound known at compile time (0 = push constant)
+	uint32_t _lightCount;
+	//mesh.frag/gbuffer.frag: sample texSpecular or use the material's specular color
+	bool _specularMap;
+	//mesh.frag/lightvolume.frag
+	AttenuationModel _attenuation;
+
+	uint64_t getKey() const;
+};
+
+/* Pipelines built from one shading variant */
+struct ShadingPipelines {
+	ShadingVariant _variant;
+	vk_pipelines::PipelineId _object;
+	//Shading pass after the depth pre-pass (EQUAL, no depth writes)
+	vk_pipelines::PipelineId _objectEqual;
+	vk_pipelines::PipelineId _gBuffer;
+	vk_pipelines::PipelineId _lightVolume;
+};
+
+struct AppConfig {
+	//Render into offscreen targets instead of a window + swapchain
+	bool _headless{ false };
+	//Frames to render before run() returns in headless mode
+	uint32_t _frameCount{ 1 };
+	//Copy each headless frame back to host memory
+	bool _readback{ true };
+	//If non-empty, read back frames are written here
+	std::string _dumpDir{};
+	DumpFormat _dumpFormat{ DumpFormat::PPM };
+	VkExtent2D _extent{ 1200,800 };
+	//Seconds advanced per frame by the animation clock (0 = wall clock)
+	double _fixedTimestep{ 0.0 };
+	//Seed for object placement (0 = seeded from time)
+	uint32_t _seed{ 0 };
+	//Keep resolved gpu frame times around for takeGpuFrameTimes()
+	bool _collectGpuTimes{ false };
+	//Asset loading threads (0 = one per hardware thread)
+	uint32_t _workerThreads{ 0 };
+	//Mesh drawn for objects, .obj or cooked .lbxmesh (empty = cube)
+	std::string _meshPath{};
+	//Read per instance normal matrices instead of inverting the model matrix per vertex
+	bool _precomputedNormals{ true };
+	//Instances drawn with the object mesh
+	uint32_t _objectCount{ NUM_OBJECTS };
+	//Spin objects every frame (rebuilds all their matrices on the thread pool)
+	bool _animateObjects{ true };
+	//Where objects are frustum culled, only visible instances are drawn
+	CullMode _cullMode{ CullMode::GPU };
+	//Dynamic point lights orbiting the scene
+	uint32_t _lightCount{ NUM_LIGHTS };
+	//Shade with the lights binned into each fragment's cluster instead of looping over all of them
+	bool _clusteredLighting{ true };
+	//Can be switched at runtime from the menu bar
+	RenderMode _renderMode{ RenderMode::FORWARD };
+	//Forward only: lay down depth from a position only stream first, then shade with an EQUAL depth test
+	bool _depthPrepass{ false };
+	//Sample the specular map, otherwise the material's specular color is used everywhere
+	bool _specularMap{ true };
+	AttenuationModel _attenuation{ AttenuationModel::POLYNOMIAL };
+	//Load cooked .ktx2 textures next to the source images when they exist
+	bool _compressedTextures{ true };
+	//MB of unreferenced textures/meshes kept cached before the least recently used are destroyed
+	uint32_t _resourceBudget{ 256 };
+	//Sampler preset for material textures
+	TextureFilter _textureFilter{ TextureFilter::ANISOTROPIC };
+	//Clamped to the device limit
+	float _maxAnisotropy{ 16.0f };
+	//Compiled pipelines are kept here between runs (empty = compile from SPIR-V every launch)
+	std::string _pipelineCachePath{ "pipeline_cache.bin" };
+};
+
+/* Timing */
+struct GpuFrameTime {
+	uint32_t _frameNum;
+	//Whole command buffer
+	double _ms;
+	//Per pass
+	std::vector<vk_profiler::ScopeTiming> _scopes;
 };
 
 /* Camera */
 struct GPUCameraData {
 	math::Mat4 view_proj;
 	math::Vec4 eye;
+	//View direction, for cluster depth
+	math::Vec4 forward;
+	//World position from depth in the deferred lighting pass
+	math::Mat4 inv_view_proj;
+};
+
+/* Lighting (push constants of mesh.frag) */
+struct GPULightingParams {
+	int32_t numLights;
+	uint32_t clusterX;
+	uint32_t clusterY;
+	uint32_t clusterZ;
+	//Framebuffer pixels per cluster tile
+	float tileSize[2];
+	float zNear;
+	//Depth slice = log(depth / zNear) * zScale
+	float zScale;
+};
+
+/* Culling (push constants of cull.comp) */
+struct GPUCullParams {
+	math::Vec4 planes[6];
+	uint32_t objectCount;
+	float radius;
+};
+
+/* Deferred light volumes (push constants of lightvolume.vert) */
+struct GPULightVolumeParams {
+	math::Mat4 view;
+	math::Mat4 proj;
 };
 
 /* Material */
@@ -41,24 +231,15 @@ struct MaterialEntity {
 	float shiny;
 };
 
-/* Light */
-struct LightEntity{
-	math::Vec4 position;
-	math::Vec4 ambient;
-	math::Vec4 diffuse;
-	math::Vec4 specular;
-	float _constantAttenuation;
-	float _linearAttenuation;
-	float _quadraticAttenuation;
-	float _padding;
-};
-
-/* Objects */
-struct RenderEntity {
-	math::Mat4 model;
+/* Light motion (circle around the y axis, radius swings between min and max) */
+struct LightOrbit {
+	float _minRadius;
+	float _maxRadius;
+	float _height;
+	float _phase;
+	float _speed;
 };
 
-
 struct UploadContext {
 	VkFence _uploadDoneFence;
 	VkCommandPool _commandPool;
@@ -69,7 +250,7 @@ class VkApp {
 
 public:
 
-	void init();
+	void init(const AppConfig& config = AppConfig{});
 	void run();
 	void draw();
 	void cleanup();
@@ -88,8 +269,30 @@ public:
 	/* VMA Allocator */
 	VmaAllocator _allocator;
 
+	//Blocks until the gpu is done, only for one off work (imgui fonts)
 	void immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function);
 
+	//Batched staging uploads, rendering waits on them gpu side
+	vk_upload::UploadQueue _uploadQueue;
+
+	/* Jobs */
+	vk_jobs::ThreadPool _threadPool;
+	//Decode/parse on the pool, completions (gpu resource creation) run on the main thread
+	vk_jobs::AssetLoader _assetLoader;
+
+	/* Resources */
+	//Loaded textures + meshes, shared by path/content and evicted over _resourceBudget once unreferenced
+	vk_resources::ResourceManager _resources;
+
+	/* Stats */
+	const VkPhysicalDeviceProperties& getGpuProperties() const;
+
+	//Gpu frame times resolved since the last call (needs _collectGpuTimes)
+	std::vector<GpuFrameTime> takeGpuFrameTimes();
+
+	//Wait for all frames in flight and resolve their readbacks/timings
+	void finishFrames();
+
 
 private:
 
@@ -97,10 +300,17 @@ private:
 
 	void initWindow();
 
+	void initJobs();
+
+	//Queue asset decodes so they overlap the rest of init
+	void loadAssets();
+
 	void initVulkan();
 
 	void initSwapchain();
 
+	void initOffscreenTargets();
+
 	void initCommands();
 
 	void initRenderPasses();
@@ -109,14 +319,16 @@ private:
 
 	void initSync();
 
+	void initQueries();
+
 	void initSamplers();
 
 	void initBuffers();
 
-	void initImages();
-
 	void initDescriptors();
 
+	void initPipelineCache();
+
 	void initPipelines();
 
 	void initImgui();
@@ -125,10 +337,14 @@ private:
 
 	void destroyWindow();
 
+	void destroyJobs();
+
 	void destroyVulkan();
 
 	void destroySwapchain();
 
+	void destroyOffscreenTargets();
+
 	void destroyCommands();
 
 	void destroyRenderPasses();
@@ -137,16 +353,20 @@ private:
 
 	void destroySync();
 
+	void destroyQueries();
+
 	void destroySamplers();
 
 	void destroyBuffers();
 
-	void destroyImages();
+	void destroyResources();
 
 	void destroyDescriptors();
 
 	void destroyPipelines();
 
+	void destroyPipelineCache();
+
 	void destroyImgui();
 
 	/* UI drawing */
@@ -156,13 +376,49 @@ private:
 
 	RenderFrame& getFrame();
 
+	double getTime();
+
+	void dumpFrame(RenderFrame& frame);
+
+	void resolveTimestamps(RenderFrame& frame);
+
+	//Animate/cull objects, writing matrices and the visible index list into this frame's region of _objectBuffer.
+	//Returns the number of visible instances
+	uint32_t updateObjects(uint32_t frameIdx, float time, const math::Frustum& frustum);
+
+	//Reset the indirect draw and dispatch cull.comp into this frame's visible list
+	void recordCulling(VkCommandBuffer cmd, RenderFrame& frame, const math::Frustum& frustum);
+
+	//Variant selected by _config
+	ShadingVariant getShadingVariant() const;
+	//Registers the variant's pipelines on first use, compiling is up to the caller
+	const ShadingPipelines& getShadingPipelines(const ShadingVariant& variant);
+	//Everything mode draws with (except the optional depth pre-pass)
+	std::vector<vk_pipelines::PipelineId> getRendererPipelines(RenderMode mode, const ShadingPipelines& shading) const;
+
+	//Move lights along their orbits and bin them into this frame's clusters.
+	//Writes the light, cluster and cluster index offsets into the frame's upload buffer, returns the fragment push constants
+	GPULightingParams updateLights(RenderFrame& frame, float time, const math::Mat4& view, const math::Mat4& proj, uint32_t offsets[3]);
+
+	//Instanced light cubes
+	void drawLights(VkCommandBuffer cmd, RenderFrame& frame, VkPipeline pipeline, const uint32_t* dynamicOffsets);
+
+	//Visible objects, indirect when culled on the gpu
+	void drawObjects(VkCommandBuffer cmd, RenderFrame& frame, VkPipeline pipeline, const uint32_t* dynamicOffsets, const GPULightingParams& lighting, bool positionsOnly = false);
+
+	//Loaded mesh, or the cube when there is none
+	const GPUMesh& getObjectMesh() const;
+
 
 	/* App State */
 	bool _init{false};
 	uint32_t _frameNum{ 0 };
+	AppConfig _config{};
+	std::chrono::steady_clock::time_point _startTime{};
 
 	/* UI state */
 	bool _viewerOpen{ false };
+	bool _profilerOpen{ false };
 
 	/* Window */
 	GLFWwindow* _window;
@@ -179,40 +435,91 @@ private:
 	std::vector<VkImage> _swapchainImages;
 	std::vector<VkImageView> _swapchainImageViews;
 
+	/* Offscreen targets (headless mode), views live in _swapchainImageViews */
+	std::vector<vk_types::AllocatedImage> _offscreenImages;
+
 	/* Depth buffer */
 	VkFormat _depthFormat;
 	vk_types::AllocatedImage _depthImage;
 	VkImageView _depthImageView;
 
+	/* G-buffer (deferred mode), only lives within the deferred render pass */
+	vk_types::AllocatedImage _gBufferAlbedo;
+	VkImageView _gBufferAlbedoView;
+	vk_types::AllocatedImage _gBufferSpecular;
+	VkImageView _gBufferSpecularView;
+	vk_types::AllocatedImage _gBufferNormal;
+	VkImageView _gBufferNormalView;
+	vk_types::AllocatedImage _lightAccum;
+	VkImageView _lightAccumView;
+
 	/* Device */
 	VkPhysicalDevice _gpu;
 	VkPhysicalDeviceProperties _gpuProperties;
+	bool _anisotropySupported{ false };
+	bool _bcSupported{ false };
 	VkDevice _device;
 
 	/* Queues */
 	uint32_t _graphicsFamilyQueueIndex;
 	VkQueue _graphicsQueue;
 
+	//Same as graphics when the device has no dedicated transfer queue
+	uint32_t _transferFamilyQueueIndex;
+	VkQueue _transferQueue;
+
 	/* Render passes */
 	VkRenderPass _renderPass;
+	//Subpass 0 fills the G-buffer, subpass 1 reads it as input attachments and accumulates light volumes,
+	//subpass 2 resolves the accumulated light into the color target
+	VkRenderPass _deferredRenderPass;
+	//Compatible with _renderPass, loads the color target so imgui can draw over the deferred output
+	VkRenderPass _overlayRenderPass;
 
 	/* Framebuffers */
 	std::vector<VkFramebuffer> _frameBuffers;
+	std::vector<VkFramebuffer> _deferredFrameBuffers;
 
 	/* Pipelines */
+	//Shared by every pipeline creation, persisted to _config._pipelineCachePath
+	vk_cache::PipelineCache _pipelineCache;
+
+	//Graphics pipelines are built by the registry, the members below are ids into it
+	vk_pipelines::PipelineRegistry _pipelines;
+
 	//Light pipeline
 	VkPipelineLayout _lightPipelineLayout;
-	VkPipeline _lightPipeline;
+	vk_pipelines::PipelineId _lightPipeline;
 
-	//Object pipeline
+	//Object pipelines (forward, G-buffer) + light volumes are per shading variant, registered the first time a variant is used
 	VkPipelineLayout _objectPipelineLayout;
-	VkPipeline _objectPipeline;
+	std::unordered_map<uint64_t, ShadingPipelines> _shadingPipelines;
+	vk_pipelines::PipelineId _depthPrepassPipeline;
+
+	//Deferred: objects into the G-buffer, light volumes, then resolve + light cubes
+	VkPipelineLayout _lightVolumePipelineLayout;
+	vk_pipelines::PipelineId _resolvePipeline;
+	vk_pipelines::PipelineId _deferredLightPipeline;
+
+	//Renderer + variant actually recorded this frame, they lag _config while newly selected ones compile
+	RenderMode _activeRenderMode{ RenderMode::FORWARD };
+	const ShadingPipelines* _activeShading{ nullptr };
+
+	//Object culling (compute)
+	VkPipelineLayout _cullPipelineLayout;
+	VkPipeline _cullPipeline;
 
 
 
 	/* Frames */
 	RenderFrame _frames[NUM_FRAMES];
 
+	/* Timing */
+	bool _timestampsSupported{ false };
+	std::vector<GpuFrameTime> _gpuFrameTimes;
+	//Latest resolved scopes, smoothed for display
+	std::vector<vk_profiler::ScopeTiming> _profilerTimings;
+
 	/* Upload */
 	UploadContext _uploadContext;
 
@@ -221,54 +528,63 @@ private:
 	/* Sync */
 
 	/* Samplers */
-	VkSampler _blockySampler;
+	//Material textures, built from _config._textureFilter
+	VkSampler _textureSampler;
 
 	/* Buffers */
-	//std::vector<vk_primitives::mesh::Vertex_F3_F3> _vertices;
-	std::vector<vk_primitives::mesh::Vertex_F3_F3_F2> _vertices;
 	std::vector<LightEntity> _lights;
+	std::vector<LightOrbit> _lightOrbits;
 
-	//std::vector<uint32_t> _indices;
-
-	//Vertex buffers
-	vk_types::AllocatedBuffer _vertexBuffer;
+	//Cpu light binning, writes straight into the frame's upload buffer
+	vk_lights::LightGrid _lightGrid;
+	bool _clusterOverflowWarned{ false };
 
-	//Index buffers
-	vk_types::AllocatedBuffer _indexBuffer;
+	//Meshes
+	vk_resources::MeshHandle _cubeMesh;
+	//From _config._meshPath, objects fall back to the cube until it's loaded (or when empty)
+	vk_resources::MeshHandle _loadedMesh;
 
-	//Uniforms buffers
-	vk_types::AllocatedBuffer _cameraBuffer;
+	//Uniforms buffers (per frame camera data lives in RenderFrame::_uploadAllocator)
 	vk_types::AllocatedBuffer _materialBuffer;
 
-	//Storage buffers
-	vk_types::AllocatedBuffer _lightBuffer;
+	//Storage buffers (per frame light data lives in RenderFrame::_uploadAllocator)
+	//One region of _objectRegionSize bytes per frame in flight, persistently mapped.
+	//A region holds every RenderEntity, then the visible instance indices at _visibleListOffset
 	vk_types::AllocatedBuffer _objectBuffer;
+	size_t _objectRegionSize{ 0 };
+	size_t _visibleListOffset{ 0 };
+	void* _objectBufferData{ nullptr };
+
+	//Object transforms, matrices are rebuilt from these
+	vk_transforms::TransformSystem _transforms;
+	std::vector<float> _objectSpeeds;
+
+	//Culling output per batch, compacted in order into the frame's visible list
+	std::vector<uint32_t> _visibleScratch;
+	std::vector<uint32_t> _batchVisibleCounts;
+	uint32_t _visibleObjectCount{ 0 };
 
 	/* Images */
-	vk_types::AllocatedImage _diffuseImage;
-	VkImageView _diffuseImageView;
-	vk_types::AllocatedImage _specularImage;
-	VkImageView _specularImageView;
+	//RGBA8 when decoded from the source image, BC when a cooked .ktx2 was loaded
+	vk_resources::TextureHandle _diffuseTexture;
+	vk_resources::TextureHandle _specularTexture;
 
 
 	/* Desciptors */
 	VkDescriptorPool _descriptorPool;
 	VkDescriptorPool _imguiDescriptorPool;
 
-	//Dynamic descriptor set changed on frame scope
+	//Dynamic descriptor sets are allocated per frame
 	VkDescriptorSetLayout _lightDescriptorSetLayout;
-	VkDescriptorSet _lightDescriptorSet;
 
 	VkDescriptorSetLayout _objectDescriptorLayout;
-	VkDescriptorSet _objectDescriptorSet;
 
+	VkDescriptorSetLayout _cullDescriptorLayout;
 
-};
+	VkDescriptorSetLayout _deferredDescriptorLayout;
 
-/*namespace vk_io {
-	bool loadImage(VkApp& app, const char* filePath, vk_types::AllocatedImage& image);
-}*/
 
+};
 
 /* INPUT HANDLING */
 
@@ -0,0 +1,191 @@
+#include "vk_args.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+
+bool vk_args::parseUint(const std::string& flag, const char* value, uint32_t& out, uint32_t min)
+{
+	//strtoul would skip whitespace and wrap "-1" around
+	if (std::isdigit(static_cast<unsigned char>(value[0]))) {
+		errno = 0;
+		char* end = nullptr;
+		unsigned long long parsed = std::strtoull(value, &end, 10);
+		if (errno == 0 && *end == '\0' && parsed >= min && parsed <= UINT32_MAX) {
+			out = static_cast<uint32_t>(parsed);
+			return true;
+		}
+	}
+
+	std::cerr << "Invalid value for " << flag << ": " << value << std::endl;
+	return false;
+}
+
+bool vk_args::parseDouble(const std::string& flag, const char* value, double& out)
+{
+	if (std::isdigit(static_cast<unsigned char>(value[0])) || value[0] == '.') {
+		errno = 0;
+		char* end = nullptr;
+		double parsed = std::strtod(value, &end);
+		if (errno == 0 && *end == '\0' && std::isfinite(parsed)) {
+			out = parsed;
+			return true;
+		}
+	}
+
+	std::cerr << "Invalid value for " << flag << ": " << value << std::endl;
+	return false;
+}
+
+bool vk_args::parseAppArgs(int argc, char** argv, AppConfig& config, const ExtraArg& extra)
+{
+	for (int i = 1; i < argc; i++) {
+		std::string arg{ argv[i] };
+
+		if (extra) {
+			ArgResult result = extra(arg, argc, argv, i);
+			if (result == ArgResult::INVALID) {
+				return false;
+			}
+			if (result == ArgResult::PARSED) {
+				continue;
+			}
+		}
+
+		if (arg == "--headless") {
+			config._headless = true;
+		}
+		else if (arg == "--frames" && i + 1 < argc) {
+			if (!parseUint(arg, argv[++i], config._frameCount)) {
+				return false;
+			}
+		}
+		else if (arg == "--dump" && i + 1 < argc) {
+			config._dumpDir = argv[++i];
+		}
+		else if (arg == "--png") {
+			config._dumpFormat = DumpFormat::PNG;
+		}
+		else if (arg == "--seed" && i + 1 < argc) {
+			if (!parseUint(arg, argv[++i], config._seed)) {
+				return false;
+			}
+		}
+		else if (arg == "--timestep" && i + 1 < argc) {
+			if (!parseDouble(arg, argv[++i], config._fixedTimestep)) {
+				return false;
+			}
+		}
+		else if (arg == "--size" && i + 2 < argc) {
+			//Zero sized swapchains/attachments can't be created
+			if (!parseUint(arg, argv[++i], config._extent.width, 1) || !parseUint(arg, argv[++i], config._extent.height, 1)) {
+				return false;
+			}
+		}
+		else if (arg == "--mesh" && i + 1 < argc) {
+			config._meshPath = argv[++i];
+		}
+		else if (arg == "--objects" && i + 1 < argc) {
+			if (!parseUint(arg, argv[++i], config._objectCount)) {
+				return false;
+			}
+		}
+		else if (arg == "--static") {
+			config._animateObjects = false;
+		}
+		else if (arg == "--lights" && i + 1 < argc) {
+			if (!parseUint(arg, argv[++i], config._lightCount)) {
+				return false;
+			}
+		}
+		else if (arg == "--no-clusters") {
+			config._clusteredLighting = false;
+		}
+		else if (arg == "--deferred") {
+			config._renderMode = RenderMode::DEFERRED;
+		}
+		else if (arg == "--prepass") {
+			config._depthPrepass = true;
+		}
+		else if (arg == "--no-specular-map") {
+			config._specularMap = false;
+		}
+		else if (arg == "--attenuation" && i + 1 < argc) {
+			std::string model{ argv[++i] };
+			if (model == "polynomial") {
+				config._attenuation = AttenuationModel::POLYNOMIAL;
+			}
+			else if (model == "inverse-square") {
+				config._attenuation = AttenuationModel::INVERSE_SQUARE;
+			}
+			else {
+				std::cerr << "Unknown attenuation model: " << model << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--no-compressed-textures") {
+			config._compressedTextures = false;
+		}
+		else if (arg == "--resource-budget" && i + 1 < argc) {
+			if (!parseUint(arg, argv[++i], config._resourceBudget)) {
+				return false;
+			}
+		}
+		else if (arg == "--filter" && i + 1 < argc) {
+			std::string filter{ argv[++i] };
+			if (filter == "bilinear") {
+				config._textureFilter = TextureFilter::BILINEAR;
+			}
+			else if (filter == "trilinear") {
+				config._textureFilter = TextureFilter::TRILINEAR;
+			}
+			else if (filter == "anisotropic") {
+				config._textureFilter = TextureFilter::ANISOTROPIC;
+			}
+			else {
+				std::cerr << "Unknown texture filter: " << filter << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--anisotropy" && i + 1 < argc) {
+			double anisotropy = 0.0;
+			if (!parseDouble(arg, argv[++i], anisotropy)) {
+				return false;
+			}
+			config._maxAnisotropy = static_cast<float>(anisotropy);
+		}
+		else if (arg == "--pipeline-cache" && i + 1 < argc) {
+			config._pipelineCachePath = argv[++i];
+		}
+		else if (arg == "--no-pipeline-cache") {
+			config._pipelineCachePath.clear();
+		}
+		else if (arg == "--shader-normals") {
+			config._precomputedNormals = false;
+		}
+		else if (arg == "--cull" && i + 1 < argc) {
+			std::string mode{ argv[++i] };
+			if (mode == "none") {
+				config._cullMode = CullMode::NONE;
+			}
+			else if (mode == "cpu") {
+				config._cullMode = CullMode::CPU;
+			}
+			else if (mode == "gpu") {
+				config._cullMode = CullMode::GPU;
+			}
+			else {
+				std::cerr << "Unknown cull mode: " << mode << std::endl;
+				return false;
+			}
+		}
+		else {
+			std::cerr << "Unknown argument: " << arg << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
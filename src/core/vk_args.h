@@ -0,0 +1,30 @@
+#pragma once
+
+#include "vk_app.h"
+
+#include <cstdint>
+#include <string>
+#include <functional>
+
+namespace vk_args {
+
+	enum class ArgResult : uint8_t {
+		//Not one of its flags
+		UNKNOWN,
+		PARSED,
+		//Its flag with a bad value, already reported
+		INVALID
+	};
+
+	//Handles a program specific flag at argv[i], advancing i past any values
+	using ExtraArg = std::function<ArgResult(const std::string& arg, int argc, char** argv, int& i)>;
+
+	//Whole decimal value in [min, UINT32_MAX], no sign. Prints the flag and returns false otherwise
+	bool parseUint(const std::string& flag, const char* value, uint32_t& out, uint32_t min = 0);
+	//Finite value >= 0. Prints the flag and returns false otherwise
+	bool parseDouble(const std::string& flag, const char* value, double& out);
+
+	//Fills config from the flags shared by the app and the benchmark (see README), extra gets every other flag first.
+	//Prints the offending flag and returns false on unknown flags or values
+	bool parseAppArgs(int argc, char** argv, AppConfig& config, const ExtraArg& extra = {});
+}
@@ -0,0 +1,725 @@
+#include "vk_cache.h"
+#include "vk_log.h"
+#include "vk_io.h"
+#include "vk_compress.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* MappedFile */
+
+vk_cache::MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool vk_cache::MappedFile::open(const char* filePath)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	_file = file;
+	_mapping = mapping;
+	_data = static_cast<const uint8_t*>(data);
+	_size = static_cast<size_t>(size.QuadPart);
+#else
+	int fd = ::open(filePath, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	//Mapping keeps its own reference to the file
+	::close(fd);
+
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	//Blobs get read front to back once into staging memory
+	madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL | MADV_WILLNEED);
+
+	_data = static_cast<const uint8_t*>(data);
+	_size = static_cast<size_t>(info.st_size);
+#endif
+
+	return true;
+}
+
+void vk_cache::MappedFile::close()
+{
+	if (!_data) {
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(_data);
+	CloseHandle(_mapping);
+	CloseHandle(_file);
+	_mapping = nullptr;
+	_file = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+
+	_data = nullptr;
+	_size = 0;
+}
+
+const uint8_t* vk_cache::MappedFile::getData() const
+{
+	return _data;
+}
+
+size_t vk_cache::MappedFile::getSize() const
+{
+	return _size;
+}
+
+/* Mesh files */
+
+namespace {
+
+	size_t alignOffset(size_t offset)
+	{
+		return (offset + vk_cache::MESH_BLOB_ALIGNMENT - 1) & ~(vk_cache::MESH_BLOB_ALIGNMENT - 1);
+	}
+
+	void writePadding(std::ofstream& file, size_t from, size_t to)
+	{
+		static const char zeros[vk_cache::MESH_BLOB_ALIGNMENT] = {};
+		file.write(zeros, static_cast<std::streamsize>(to - from));
+	}
+
+	//length bytes at offset lie inside a file of size bytes, written so that neither side can wrap around
+	bool inFile(uint64_t offset, uint64_t length, uint64_t size)
+	{
+		return offset <= size && length <= size - offset;
+	}
+}
+
+bool vk_cache::writeMesh(const char* filePath, const vk_primitives::mesh::Mesh& mesh)
+{
+	using vk_primitives::mesh::Vertex_F3_F3_F2;
+
+	vk_primitives::mesh::VertexInputDescription layout = Vertex_F3_F3_F2::getVertexInputDescription();
+
+	std::vector<MeshAttribute> attributes{};
+	for (const auto& attribute : layout._attributeDescriptions) {
+		attributes.push_back(MeshAttribute{ attribute.location,static_cast<uint32_t>(attribute.format),attribute.offset });
+	}
+
+	MeshHeader header{};
+	header._magic = MESH_MAGIC;
+	header._version = MESH_VERSION;
+	header._vertexStride = layout._bindingDescriptions[0].stride;
+	header._attributeCount = static_cast<uint32_t>(attributes.size());
+	header._vertexCount = static_cast<uint32_t>(mesh._vertices.size());
+	header._indexCount = static_cast<uint32_t>(mesh._indices.size());
+	//Narrow indices when possible, halves index bandwidth for small meshes
+	std::vector<uint16_t> indices_16{};
+	if (mesh.fitsIndices16()) {
+		indices_16 = mesh.getIndices16();
+		header._indexSize = sizeof(uint16_t);
+	}
+	else {
+		header._indexSize = sizeof(uint32_t);
+	}
+	const void* index_data = header._indexSize == sizeof(uint16_t) ? (const void*)indices_16.data() : (const void*)mesh._indices.data();
+
+	size_t attributes_size = attributes.size() * sizeof(MeshAttribute);
+	size_t vertex_size = mesh._vertices.size() * sizeof(Vertex_F3_F3_F2);
+	size_t index_size = mesh._indices.size() * header._indexSize;
+
+	header._attributeOffset = sizeof(MeshHeader);
+	header._vertexOffset = alignOffset(header._attributeOffset + attributes_size);
+	header._indexOffset = alignOffset(header._vertexOffset + vertex_size);
+
+	for (uint32_t i = 0; i < 3; i++) {
+		header._boundsMin[i] = mesh._vertices.empty() ? 0.0f : mesh._vertices[0].position[i];
+		header._boundsMax[i] = header._boundsMin[i];
+	}
+	for (const auto& vertex : mesh._vertices) {
+		for (uint32_t i = 0; i < 3; i++) {
+			header._boundsMin[i] = std::min(header._boundsMin[i], vertex.position[i]);
+			header._boundsMax[i] = std::max(header._boundsMax[i], vertex.position[i]);
+		}
+	}
+
+	std::ofstream file(filePath, std::ios::binary);
+
+	if (!file.is_open()) {
+		std::cout << "Failed to write: " << filePath << std::endl;
+		return false;
+	}
+
+	file.write((const char*)&header, sizeof(MeshHeader));
+	file.write((const char*)attributes.data(), static_cast<std::streamsize>(attributes_size));
+	writePadding(file, header._attributeOffset + attributes_size, header._vertexOffset);
+	file.write((const char*)mesh._vertices.data(), static_cast<std::streamsize>(vertex_size));
+	writePadding(file, header._vertexOffset + vertex_size, header._indexOffset);
+	file.write((const char*)index_data, static_cast<std::streamsize>(index_size));
+
+	return file.good();
+}
+
+bool vk_cache::MeshFile::open(const char* filePath, const vk_primitives::mesh::VertexInputDescription& expectedLayout)
+{
+	close();
+
+	if (!_file.open(filePath)) {
+		std::cout << "Failed to load: " << filePath << std::endl;
+		return false;
+	}
+
+	auto fail = [&](const char* reason) {
+		std::cout << "Failed to load: " << filePath << " (" << reason << ")" << std::endl;
+		_file.close();
+		return false;
+	};
+
+	if (_file.getSize() < sizeof(MeshHeader)) {
+		return fail("truncated header");
+	}
+
+	const MeshHeader* header = reinterpret_cast<const MeshHeader*>(_file.getData());
+
+	if (header->_magic != MESH_MAGIC) {
+		return fail("not a cooked mesh");
+	}
+	if (header->_version != MESH_VERSION) {
+		return fail("outdated version, re-cook it");
+	}
+	if (header->_indexSize != 2 && header->_indexSize != 4) {
+		return fail("bad index size");
+	}
+
+	//32 bit counts times 32 bit sizes can't overflow 64 bits, offsets come straight from the file and can be anything
+	uint64_t attributes_size = static_cast<uint64_t>(header->_attributeCount) * sizeof(MeshAttribute);
+	uint64_t vertex_size = static_cast<uint64_t>(header->_vertexCount) * header->_vertexStride;
+	uint64_t index_size = static_cast<uint64_t>(header->_indexCount) * header->_indexSize;
+
+	if (!inFile(header->_attributeOffset, attributes_size, _file.getSize()) || !inFile(header->_vertexOffset, vertex_size, _file.getSize()) ||
+		!inFile(header->_indexOffset, index_size, _file.getSize())) {
+		return fail("truncated data");
+	}
+
+	//Layout has to match the pipelines' vertex input
+	if (expectedLayout._bindingDescriptions.empty() || header->_vertexStride != expectedLayout._bindingDescriptions[0].stride ||
+		header->_attributeCount != expectedLayout._attributeDescriptions.size()) {
+		return fail("vertex layout mismatch");
+	}
+
+	const MeshAttribute* attributes = reinterpret_cast<const MeshAttribute*>(_file.getData() + header->_attributeOffset);
+	for (uint32_t i = 0; i < header->_attributeCount; i++) {
+		const auto& expected = expectedLayout._attributeDescriptions[i];
+		if (attributes[i]._location != expected.location || attributes[i]._format != static_cast<uint32_t>(expected.format) || attributes[i]._offset != expected.offset) {
+			return fail("vertex layout mismatch");
+		}
+	}
+
+	_header = header;
+	return true;
+}
+
+void vk_cache::MeshFile::close()
+{
+	_file.close();
+	_header = nullptr;
+}
+
+const vk_cache::MeshHeader& vk_cache::MeshFile::getHeader() const
+{
+	return *_header;
+}
+
+const void* vk_cache::MeshFile::getVertexData() const
+{
+	return _file.getData() + _header->_vertexOffset;
+}
+
+size_t vk_cache::MeshFile::getVertexDataSize() const
+{
+	return static_cast<size_t>(_header->_vertexCount) * _header->_vertexStride;
+}
+
+const void* vk_cache::MeshFile::getIndexData() const
+{
+	return _file.getData() + _header->_indexOffset;
+}
+
+size_t vk_cache::MeshFile::getIndexDataSize() const
+{
+	return static_cast<size_t>(_header->_indexCount) * _header->_indexSize;
+}
+
+/* Texture files */
+
+namespace {
+
+	static_assert(sizeof(vk_cache::Ktx2Header) == 80, "KTX2 header is 80 bytes");
+
+	//Khronos data format descriptor values used here
+	constexpr uint32_t DF_MODEL_RGBSDA = 1;
+	constexpr uint32_t DF_MODEL_BC1A = 128;
+	constexpr uint32_t DF_MODEL_BC3 = 130;
+	constexpr uint32_t DF_MODEL_BC7 = 134;
+	constexpr uint32_t DF_PRIMARIES_BT709 = 1;
+	constexpr uint32_t DF_TRANSFER_LINEAR = 1;
+	constexpr uint32_t DF_TRANSFER_SRGB = 2;
+	constexpr uint32_t DF_CHANNEL_ALPHA = 15;
+	constexpr uint32_t DF_SAMPLE_LINEAR = 1 << 4;
+
+	bool isSrgb(VkFormat format)
+	{
+		return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+	}
+
+	//Basic descriptor block, one sample per channel (per BC block half for BC3)
+	std::vector<uint32_t> buildDataFormatDescriptor(VkFormat format)
+	{
+		struct Sample {
+			uint32_t _bitOffset;
+			uint32_t _bitLength;
+			uint32_t _channel;
+			uint32_t _upper;
+		};
+
+		uint32_t model = DF_MODEL_RGBSDA;
+		std::vector<Sample> samples{};
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			model = DF_MODEL_BC1A;
+			samples = { { 0, 64, 0, UINT32_MAX } };
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			model = DF_MODEL_BC3;
+			samples = { { 0, 64, DF_CHANNEL_ALPHA, UINT32_MAX }, { 64, 64, 0, UINT32_MAX } };
+			break;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			model = DF_MODEL_BC7;
+			samples = { { 0, 128, 0, UINT32_MAX } };
+			break;
+		default:
+			samples = { { 0, 8, 0, 255 }, { 8, 8, 1, 255 }, { 16, 8, 2, 255 }, { 24, 8, DF_CHANNEL_ALPHA, 255 } };
+			break;
+		}
+
+		bool compressed = vk_compress::isBlockCompressed(format);
+		uint32_t block_size = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+		std::vector<uint32_t> words{};
+		words.push_back(4 + block_size);
+		//Khronos vendor, basic descriptor type
+		words.push_back(0);
+		words.push_back(2 | (block_size << 16));
+		words.push_back(model | (DF_PRIMARIES_BT709 << 8) | ((isSrgb(format) ? DF_TRANSFER_SRGB : DF_TRANSFER_LINEAR) << 16));
+		//Texel block dimensions - 1
+		words.push_back(compressed ? (3 | (3 << 8)) : 0);
+		words.push_back(vk_compress::getBlockSize(format));
+		words.push_back(0);
+
+		for (const Sample& sample : samples) {
+			//Alpha is never sRGB encoded
+			uint32_t qualifiers = sample._channel == DF_CHANNEL_ALPHA && isSrgb(format) && !compressed ? DF_SAMPLE_LINEAR : 0;
+			words.push_back(sample._bitOffset | ((sample._bitLength - 1) << 16) | ((sample._channel | qualifiers) << 24));
+			words.push_back(0);
+			words.push_back(0);
+			words.push_back(sample._upper);
+		}
+
+		return words;
+	}
+
+	//Levels start on a multiple of the block size and of 4
+	size_t alignLevel(size_t offset, VkFormat format)
+	{
+		size_t alignment = vk_compress::getBlockSize(format) % 4 == 0 ? vk_compress::getBlockSize(format) : 4;
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+}
+
+bool vk_cache::writeTexture(const char* filePath, const vk_io::ImageData& image)
+{
+	VkFormat format = image._format;
+	uint32_t level_count = static_cast<uint32_t>(image._levelOffsets.size());
+
+	if (vk_compress::getBlockSize(format) == 0) {
+		std::cout << "Failed to write: " << filePath << " (unsupported format)" << std::endl;
+		return false;
+	}
+
+	Ktx2Header header{};
+	std::memcpy(header._identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header._vkFormat = static_cast<uint32_t>(format);
+	header._typeSize = 1;
+	header._pixelWidth = image._width;
+	header._pixelHeight = image._height;
+	header._faceCount = 1;
+	header._levelCount = level_count;
+
+	std::vector<uint32_t> dfd = buildDataFormatDescriptor(format);
+	header._dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + level_count * sizeof(Ktx2Level));
+	header._dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+	//Smallest level goes first so a streaming reader gets a usable image early
+	std::vector<Ktx2Level> levels(level_count);
+	size_t offset = header._dfdByteOffset + header._dfdByteLength;
+	for (uint32_t i = level_count; i-- > 0;) {
+		size_t end = i + 1 < level_count ? image._levelOffsets[i + 1] : image._pixels.size();
+		offset = alignLevel(offset, format);
+		levels[i]._byteOffset = offset;
+		levels[i]._byteLength = end - image._levelOffsets[i];
+		levels[i]._uncompressedByteLength = levels[i]._byteLength;
+		offset += levels[i]._byteLength;
+	}
+
+	std::ofstream file(filePath, std::ios::binary);
+
+	if (!file.is_open()) {
+		std::cout << "Failed to write: " << filePath << std::endl;
+		return false;
+	}
+
+	file.write((const char*)&header, sizeof(Ktx2Header));
+	file.write((const char*)levels.data(), static_cast<std::streamsize>(levels.size() * sizeof(Ktx2Level)));
+	file.write((const char*)dfd.data(), static_cast<std::streamsize>(header._dfdByteLength));
+
+	size_t written = header._dfdByteOffset + header._dfdByteLength;
+	for (uint32_t i = level_count; i-- > 0;) {
+		writePadding(file, written, levels[i]._byteOffset);
+		file.write((const char*)image._pixels.data() + image._levelOffsets[i], static_cast<std::streamsize>(levels[i]._byteLength));
+		written = levels[i]._byteOffset + levels[i]._byteLength;
+	}
+
+	return file.good();
+}
+
+bool vk_cache::TextureFile::open(const char* filePath)
+{
+	close();
+
+	if (!_file.open(filePath)) {
+		std::cout << "Failed to load: " << filePath << std::endl;
+		return false;
+	}
+
+	auto fail = [&](const char* reason) {
+		std::cout << "Failed to load: " << filePath << " (" << reason << ")" << std::endl;
+		_file.close();
+		return false;
+	};
+
+	if (_file.getSize() < sizeof(Ktx2Header)) {
+		return fail("truncated header");
+	}
+
+	const Ktx2Header* header = reinterpret_cast<const Ktx2Header*>(_file.getData());
+
+	if (std::memcmp(header->_identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		return fail("not a KTX2 file");
+	}
+	if (header->_supercompressionScheme != 0) {
+		return fail("supercompressed");
+	}
+	if (header->_pixelWidth == 0 || header->_pixelHeight == 0 || header->_pixelDepth > 1 || header->_layerCount > 1 || header->_faceCount != 1) {
+		return fail("not a single 2D image");
+	}
+
+	VkFormat format = static_cast<VkFormat>(header->_vkFormat);
+	if (vk_compress::getBlockSize(format) == 0) {
+		return fail("unsupported format");
+	}
+
+	//0 levels asks the loader to generate mips, cooked files always carry them
+	if (header->_levelCount == 0 || header->_levelCount > vk_io::getMipLevelCount(header->_pixelWidth, header->_pixelHeight)) {
+		return fail("bad level count");
+	}
+
+	uint64_t levels_end = sizeof(Ktx2Header) + static_cast<uint64_t>(header->_levelCount) * sizeof(Ktx2Level);
+	if (levels_end > _file.getSize()) {
+		return fail("truncated level index");
+	}
+
+	//Data format descriptor follows the level index, level data comes after it
+	if (header->_dfdByteOffset < levels_end || !inFile(header->_dfdByteOffset, header->_dfdByteLength, _file.getSize())) {
+		return fail("bad data format descriptor");
+	}
+	uint64_t data_start = static_cast<uint64_t>(header->_dfdByteOffset) + header->_dfdByteLength;
+
+	const Ktx2Level* levels = reinterpret_cast<const Ktx2Level*>(_file.getData() + sizeof(Ktx2Header));
+	for (uint32_t i = 0; i < header->_levelCount; i++) {
+		size_t expected = vk_compress::getLevelSize(format, std::max(header->_pixelWidth >> i, 1u), std::max(header->_pixelHeight >> i, 1u));
+		if (levels[i]._byteLength != expected) {
+			return fail("bad level size");
+		}
+		if (levels[i]._byteOffset < data_start) {
+			return fail("level overlaps the header");
+		}
+		if (!inFile(levels[i]._byteOffset, levels[i]._byteLength, _file.getSize())) {
+			return fail("truncated data");
+		}
+	}
+
+	_header = header;
+	_levels = levels;
+	return true;
+}
+
+void vk_cache::TextureFile::close()
+{
+	_file.close();
+	_header = nullptr;
+	_levels = nullptr;
+}
+
+const vk_cache::Ktx2Header& vk_cache::TextureFile::getHeader() const
+{
+	return *_header;
+}
+
+VkFormat vk_cache::TextureFile::getFormat() const
+{
+	return static_cast<VkFormat>(_header->_vkFormat);
+}
+
+uint32_t vk_cache::TextureFile::getLevelCount() const
+{
+	return _header->_levelCount;
+}
+
+const uint8_t* vk_cache::TextureFile::getLevelData(uint32_t level) const
+{
+	return _file.getData() + _levels[level]._byteOffset;
+}
+
+size_t vk_cache::TextureFile::getLevelSize(uint32_t level) const
+{
+	return static_cast<size_t>(_levels[level]._byteLength);
+}
+
+/* Pipeline cache */
+
+namespace {
+
+	uint64_t hashBytes(const uint8_t* data, size_t size)
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= data[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	//Vulkan's own header at the start of the blob (VkPipelineCacheHeaderVersionOne)
+	bool validBlobHeader(const uint8_t* data, size_t size, const vk_cache::PipelineCacheHeader& expected)
+	{
+		constexpr size_t BLOB_HEADER_SIZE = 16 + VK_UUID_SIZE;
+		if (size < BLOB_HEADER_SIZE) {
+			return false;
+		}
+
+		uint32_t fields[4];
+		std::memcpy(fields, data, sizeof(fields));
+
+		return fields[0] >= BLOB_HEADER_SIZE && fields[0] <= size &&
+			fields[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			fields[2] == expected._vendorID &&
+			fields[3] == expected._deviceID &&
+			std::memcmp(data + 16, expected._pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+}
+
+void vk_cache::PipelineCache::init(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& filePath)
+{
+	_device = device;
+	_filePath = filePath;
+	_loadedHash = 0;
+
+	_header = PipelineCacheHeader{};
+	_header._magic = PIPELINE_CACHE_MAGIC;
+	_header._version = PIPELINE_CACHE_VERSION;
+	_header._vendorID = properties.vendorID;
+	_header._deviceID = properties.deviceID;
+	_header._driverVersion = properties.driverVersion;
+	std::memcpy(_header._pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+	MappedFile file{};
+	const uint8_t* initial_data = nullptr;
+	size_t initial_size = 0;
+
+	if (!_filePath.empty() && file.open(_filePath.c_str())) {
+		const char* reason = nullptr;
+		const PipelineCacheHeader* header = reinterpret_cast<const PipelineCacheHeader*>(file.getData());
+		const uint8_t* data = file.getData() + sizeof(PipelineCacheHeader);
+
+		if (file.getSize() < sizeof(PipelineCacheHeader) || header->_magic != PIPELINE_CACHE_MAGIC) {
+			reason = "not a pipeline cache";
+		}
+		else if (header->_version != PIPELINE_CACHE_VERSION) {
+			reason = "outdated version";
+		}
+		else if (!matches(*header)) {
+			reason = "written by another device or driver";
+		}
+		else if (header->_dataSize != file.getSize() - sizeof(PipelineCacheHeader) || header->_dataHash != hashBytes(data, header->_dataSize)) {
+			reason = "truncated or corrupt data";
+		}
+		else if (!validBlobHeader(data, header->_dataSize, _header)) {
+			reason = "bad driver header";
+		}
+
+		if (reason) {
+			std::cout << "Ignoring pipeline cache: " << _filePath << " (" << reason << ")" << std::endl;
+		}
+		else {
+			initial_data = data;
+			initial_size = static_cast<size_t>(header->_dataSize);
+			_loadedHash = header->_dataHash;
+			std::cout << "Loaded pipeline cache: " << _filePath << " (" << initial_size << " bytes)" << std::endl;
+		}
+	}
+
+	VkPipelineCacheCreateInfo cache_info{};
+	cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cache_info.pNext = nullptr;
+	cache_info.initialDataSize = initial_size;
+	cache_info.pInitialData = initial_data;
+
+	if (vkCreatePipelineCache(_device, &cache_info, nullptr, &_cache) != VK_SUCCESS && initial_data) {
+		//Driver refused the blob after all, start over empty
+		std::cout << "Ignoring pipeline cache: " << _filePath << " (rejected by driver)" << std::endl;
+		cache_info.initialDataSize = 0;
+		cache_info.pInitialData = nullptr;
+		_loadedHash = 0;
+		VK_CHECK(vkCreatePipelineCache(_device, &cache_info, nullptr, &_cache));
+	}
+}
+
+bool vk_cache::PipelineCache::save()
+{
+	if (_cache == VK_NULL_HANDLE || _filePath.empty()) {
+		return false;
+	}
+
+	size_t size = 0;
+	if (vkGetPipelineCacheData(_device, _cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+		return false;
+	}
+
+	std::vector<uint8_t> data(size);
+	if (vkGetPipelineCacheData(_device, _cache, &size, data.data()) != VK_SUCCESS) {
+		return false;
+	}
+
+	PipelineCacheHeader header = _header;
+	header._dataSize = size;
+	header._dataHash = hashBytes(data.data(), size);
+
+	if (header._dataHash == _loadedHash) {
+		return true;
+	}
+
+	//Write next to the target and rename over it, so a concurrent reader never sees half a file
+	std::string temp_path = _filePath + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary);
+
+		if (!file.is_open()) {
+			std::cout << "Failed to write: " << temp_path << std::endl;
+			return false;
+		}
+
+		file.write((const char*)&header, sizeof(PipelineCacheHeader));
+		file.write((const char*)data.data(), static_cast<std::streamsize>(size));
+
+		if (!file.good()) {
+			std::cout << "Failed to write: " << temp_path << std::endl;
+			return false;
+		}
+	}
+
+	if (std::rename(temp_path.c_str(), _filePath.c_str()) != 0) {
+		//Windows won't rename over an existing file
+		std::remove(_filePath.c_str());
+		if (std::rename(temp_path.c_str(), _filePath.c_str()) != 0) {
+			std::cout << "Failed to write: " << _filePath << std::endl;
+			std::remove(temp_path.c_str());
+			return false;
+		}
+	}
+
+	_loadedHash = header._dataHash;
+	std::cout << "Saved pipeline cache: " << _filePath << " (" << size << " bytes)" << std::endl;
+	return true;
+}
+
+void vk_cache::PipelineCache::destroy()
+{
+	if (_cache != VK_NULL_HANDLE) {
+		vkDestroyPipelineCache(_device, _cache, nullptr);
+		_cache = VK_NULL_HANDLE;
+	}
+}
+
+VkPipelineCache vk_cache::PipelineCache::getCache() const
+{
+	return _cache;
+}
+
+bool vk_cache::PipelineCache::matches(const PipelineCacheHeader& header) const
+{
+	return header._vendorID == _header._vendorID &&
+		header._deviceID == _header._deviceID &&
+		header._driverVersion == _header._driverVersion &&
+		std::memcmp(header._pipelineCacheUUID, _header._pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
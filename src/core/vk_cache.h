@@ -0,0 +1,192 @@
+#pragma once
+
+#include "vk_types.h"
+#include "primitives/mesh.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace vk_io {
+	struct ImageData;
+}
+
+namespace vk_cache {
+
+	/* Read only file mapping, pages are faulted in straight from the page cache */
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const char* filePath);
+		void close();
+
+		const uint8_t* getData() const;
+		size_t getSize() const;
+
+	private:
+		const uint8_t* _data{ nullptr };
+		size_t _size{ 0 };
+#ifdef _WIN32
+		void* _file{ nullptr };
+		void* _mapping{ nullptr };
+#endif
+	};
+
+	/* Cooked mesh format (.lbxmesh), all offsets from the start of the file:
+	   header | attributes[_attributeCount] | vertex blob | index blob */
+	constexpr uint32_t MESH_MAGIC = 0x4D58424C; //"LBXM"
+	constexpr uint32_t MESH_VERSION = 1;
+	//Blobs start on this boundary so they can be copied with wide loads
+	constexpr size_t MESH_BLOB_ALIGNMENT = 16;
+
+	struct MeshHeader {
+		uint32_t _magic;
+		uint32_t _version;
+
+		//Vertex layout, mirrors mesh::VertexInputDescription with a single binding
+		uint32_t _vertexStride;
+		uint32_t _attributeCount;
+		uint64_t _attributeOffset;
+
+		uint32_t _vertexCount;
+		uint32_t _indexCount;
+		uint64_t _vertexOffset;
+		uint64_t _indexOffset;
+		//Bytes per index (2 or 4)
+		uint32_t _indexSize;
+		uint32_t _pad;
+
+		//Object space AABB
+		float _boundsMin[3];
+		float _boundsMax[3];
+	};
+
+	struct MeshAttribute {
+		uint32_t _location;
+		uint32_t _format;
+		uint32_t _offset;
+	};
+
+	bool writeMesh(const char* filePath, const vk_primitives::mesh::Mesh& mesh);
+
+	/* Mapped cooked mesh, vertex/index data points into the mapping */
+	class MeshFile {
+	public:
+		//Fails if the file is malformed or its layout doesn't match the expected one
+		bool open(const char* filePath, const vk_primitives::mesh::VertexInputDescription& expectedLayout);
+		void close();
+
+		const MeshHeader& getHeader() const;
+
+		const void* getVertexData() const;
+		size_t getVertexDataSize() const;
+
+		const void* getIndexData() const;
+		size_t getIndexDataSize() const;
+
+	private:
+		MappedFile _file;
+		const MeshHeader* _header{ nullptr };
+	};
+
+	/* Cooked textures (.ktx2), KTX 2.0 restricted to 2D, one layer/face and no supercompression:
+	   header | level index[_levelCount] | data format descriptor | levels, smallest first */
+	constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	struct Ktx2Header {
+		uint8_t _identifier[12];
+		uint32_t _vkFormat;
+		//1 for block compressed and 8 bit formats
+		uint32_t _typeSize;
+		uint32_t _pixelWidth;
+		uint32_t _pixelHeight;
+		uint32_t _pixelDepth;
+		uint32_t _layerCount;
+		uint32_t _faceCount;
+		uint32_t _levelCount;
+		uint32_t _supercompressionScheme;
+
+		uint32_t _dfdByteOffset;
+		uint32_t _dfdByteLength;
+		uint32_t _kvdByteOffset;
+		uint32_t _kvdByteLength;
+		uint64_t _sgdByteOffset;
+		uint64_t _sgdByteLength;
+	};
+
+	struct Ktx2Level {
+		uint64_t _byteOffset;
+		uint64_t _byteLength;
+		uint64_t _uncompressedByteLength;
+	};
+
+	//RGBA8 or BC1/BC3/BC7 levels of image, level 0 first as in ImageData
+	bool writeTexture(const char* filePath, const vk_io::ImageData& image);
+
+	/* Mapped cooked texture, level data points into the mapping */
+	class TextureFile {
+	public:
+		//Fails on anything outside the subset writeTexture produces
+		bool open(const char* filePath);
+		void close();
+
+		const Ktx2Header& getHeader() const;
+		VkFormat getFormat() const;
+		uint32_t getLevelCount() const;
+
+		const uint8_t* getLevelData(uint32_t level) const;
+		size_t getLevelSize(uint32_t level) const;
+
+	private:
+		MappedFile _file;
+		const Ktx2Header* _header{ nullptr };
+		const Ktx2Level* _levels{ nullptr };
+	};
+
+	/* Pipeline cache file: header | driver cache blob (vkGetPipelineCacheData)
+	   Blobs are only handed back to the device + driver that wrote them, drivers don't all reject foreign data safely */
+	constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x5058424C; //"LBXP"
+	constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+
+	struct PipelineCacheHeader {
+		uint32_t _magic;
+		uint32_t _version;
+
+		uint32_t _vendorID;
+		uint32_t _deviceID;
+		uint32_t _driverVersion;
+		uint8_t _pipelineCacheUUID[VK_UUID_SIZE];
+		uint32_t _pad;
+
+		uint64_t _dataSize;
+		//FNV-1a of the blob, catches torn or truncated writes
+		uint64_t _dataHash;
+	};
+
+	class PipelineCache {
+	public:
+		//Seeds the cache from filePath if it was written on this device + driver, otherwise starts empty (empty path = memory only)
+		void init(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& filePath);
+		//Writes the cache back if pipelines were added since it was loaded
+		bool save();
+		void destroy();
+
+		VkPipelineCache getCache() const;
+
+	private:
+		bool matches(const PipelineCacheHeader& header) const;
+
+		VkDevice _device{ VK_NULL_HANDLE };
+		VkPipelineCache _cache{ VK_NULL_HANDLE };
+		std::string _filePath{};
+		//Identifies this device + driver, written in front of the blob
+		PipelineCacheHeader _header{};
+		//Hash of the blob read at init, nothing is written if it didn't change
+		uint64_t _loadedHash{ 0 };
+	};
+}
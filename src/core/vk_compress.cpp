@@ -0,0 +1,521 @@
+#include "vk_compress.h"
+#include "vk_io.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+/* Formats */
+
+bool vk_compress::isBlockCompressed(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return true;
+	default:
+		return false;
+	}
+}
+
+uint32_t vk_compress::getBlockSize(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		return 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return 16;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+size_t vk_compress::getLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+	if (!isBlockCompressed(format)) {
+		return static_cast<size_t>(width) * height * getBlockSize(format);
+	}
+	return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+}
+
+namespace {
+
+	/* Endpoint fitting shared by every encoder, colors are the first channels of each texel */
+
+	//Mean and principal axis of the block (power iteration on the covariance)
+	void fitLine(const uint8_t* texels, uint32_t channels, float* mean, float* axis)
+	{
+		for (uint32_t c = 0; c < channels; c++) {
+			float sum = 0.0f;
+			for (uint32_t t = 0; t < 16; t++) {
+				sum += texels[4 * t + c];
+			}
+			mean[c] = sum / 16.0f;
+		}
+
+		float cov[4][4]{};
+		for (uint32_t t = 0; t < 16; t++) {
+			float d[4]{};
+			for (uint32_t c = 0; c < channels; c++) {
+				d[c] = texels[4 * t + c] - mean[c];
+			}
+			for (uint32_t i = 0; i < channels; i++) {
+				for (uint32_t j = 0; j < channels; j++) {
+					cov[i][j] += d[i] * d[j];
+				}
+			}
+		}
+
+		//Start from the row of the widest channel, it can't be orthogonal to the axis unless the block is flat
+		uint32_t widest = 0;
+		for (uint32_t c = 1; c < channels; c++) {
+			if (cov[c][c] > cov[widest][widest]) {
+				widest = c;
+			}
+		}
+		for (uint32_t c = 0; c < 4; c++) {
+			axis[c] = c < channels ? cov[widest][c] : 0.0f;
+		}
+
+		for (uint32_t iteration = 0; iteration < 8; iteration++) {
+			float next[4]{};
+			float largest = 0.0f;
+			for (uint32_t i = 0; i < channels; i++) {
+				for (uint32_t j = 0; j < channels; j++) {
+					next[i] += cov[i][j] * axis[j];
+				}
+				largest = std::max(largest, std::fabs(next[i]));
+			}
+			if (largest == 0.0f) {
+				break;
+			}
+			for (uint32_t c = 0; c < channels; c++) {
+				axis[c] = next[c] / largest;
+			}
+		}
+
+		float length = 0.0f;
+		for (uint32_t c = 0; c < channels; c++) {
+			length += axis[c] * axis[c];
+		}
+		length = std::sqrt(length);
+		for (uint32_t c = 0; c < channels; c++) {
+			axis[c] = length > 0.0f ? axis[c] / length : 0.0f;
+		}
+	}
+
+	//Extremes of the texels projected on the line, lo -> hi follows the axis
+	void lineEndpoints(const uint8_t* texels, uint32_t channels, const float* mean, const float* axis, float* lo, float* hi)
+	{
+		float min_t = 0.0f;
+		float max_t = 0.0f;
+		for (uint32_t t = 0; t < 16; t++) {
+			float d = 0.0f;
+			for (uint32_t c = 0; c < channels; c++) {
+				d += (texels[4 * t + c] - mean[c]) * axis[c];
+			}
+			min_t = std::min(min_t, d);
+			max_t = std::max(max_t, d);
+		}
+
+		for (uint32_t c = 0; c < channels; c++) {
+			lo[c] = std::clamp(mean[c] + axis[c] * min_t, 0.0f, 255.0f);
+			hi[c] = std::clamp(mean[c] + axis[c] * max_t, 0.0f, 255.0f);
+		}
+	}
+
+	//Least squares endpoints for fixed indices, weights[i] is how far palette entry i sits from a towards b.
+	//False when every texel uses the same weight
+	bool refineEndpoints(const uint8_t* texels, uint32_t channels, const uint8_t* indices, const float* weights, float* a, float* b)
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4]{}, bx[4]{};
+
+		for (uint32_t t = 0; t < 16; t++) {
+			float w = weights[indices[t]];
+			float v = 1.0f - w;
+			aa += v * v;
+			ab += v * w;
+			bb += w * w;
+			for (uint32_t c = 0; c < channels; c++) {
+				ax[c] += v * texels[4 * t + c];
+				bx[c] += w * texels[4 * t + c];
+			}
+		}
+
+		float det = aa * bb - ab * ab;
+		if (std::fabs(det) < 1e-6f) {
+			return false;
+		}
+
+		for (uint32_t c = 0; c < channels; c++) {
+			a[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+			b[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	uint32_t distance2(const int* p, const uint8_t* texel, uint32_t channels)
+	{
+		uint32_t err = 0;
+		for (uint32_t c = 0; c < channels; c++) {
+			int d = p[c] - texel[c];
+			err += static_cast<uint32_t>(d * d);
+		}
+		return err;
+	}
+
+	/* BC1 color block: 2 RGB565 endpoints + 2 bit indices */
+
+	//Palette entry i lies weights[i] of the way from c0 to c1 (4 color mode)
+	const float BC1_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	uint16_t packRGB565(const float* color)
+	{
+		uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+		uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+		uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void unpackRGB565(uint16_t packed, int* color)
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	//Orders the endpoints for the 4 color palette (c0 > c1), picks the nearest entry per texel, returns the squared error
+	uint32_t fitBC1(const uint8_t* texels, uint16_t& c0, uint16_t& c1, uint8_t* indices)
+	{
+		if (c0 < c1) {
+			std::swap(c0, c1);
+		}
+
+		int palette[4][3];
+		unpackRGB565(c0, palette[0]);
+		unpackRGB565(c1, palette[1]);
+
+		//Equal endpoints switch BC1 to the 3 color palette, every texel stays on c0
+		uint32_t entries = c0 == c1 ? 1 : 4;
+		for (uint32_t c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		uint32_t total = 0;
+		for (uint32_t t = 0; t < 16; t++) {
+			uint32_t best = UINT32_MAX;
+			for (uint32_t i = 0; i < entries; i++) {
+				uint32_t err = distance2(palette[i], texels + 4 * t, 3);
+				if (err < best) {
+					best = err;
+					indices[t] = static_cast<uint8_t>(i);
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	void encodeColor(const uint8_t* texels, uint8_t* block)
+	{
+		float mean[4], axis[4], lo[4], hi[4];
+		fitLine(texels, 3, mean, axis);
+		lineEndpoints(texels, 3, mean, axis, lo, hi);
+
+		uint16_t c0 = packRGB565(hi);
+		uint16_t c1 = packRGB565(lo);
+		uint8_t indices[16];
+		uint32_t err = fitBC1(texels, c0, c1, indices);
+
+		//One least squares pass on the chosen indices, kept if it lowers the error
+		float a[4], b[4];
+		if (err > 0 && refineEndpoints(texels, 3, indices, BC1_WEIGHTS, a, b)) {
+			uint16_t r0 = packRGB565(a);
+			uint16_t r1 = packRGB565(b);
+			uint8_t refined[16];
+			if (fitBC1(texels, r0, r1, refined) < err) {
+				c0 = r0;
+				c1 = r1;
+				std::memcpy(indices, refined, sizeof(indices));
+			}
+		}
+
+		uint32_t bits = 0;
+		for (uint32_t t = 0; t < 16; t++) {
+			bits |= static_cast<uint32_t>(indices[t]) << (2 * t);
+		}
+
+		block[0] = static_cast<uint8_t>(c0);
+		block[1] = static_cast<uint8_t>(c0 >> 8);
+		block[2] = static_cast<uint8_t>(c1);
+		block[3] = static_cast<uint8_t>(c1 >> 8);
+		for (uint32_t i = 0; i < 4; i++) {
+			block[4 + i] = static_cast<uint8_t>(bits >> (8 * i));
+		}
+	}
+
+	/* BC3 alpha block: 2 alpha endpoints + 3 bit indices */
+
+	void encodeAlpha(const uint8_t* texels, uint8_t* block)
+	{
+		int lo = 255;
+		int hi = 0;
+		for (uint32_t t = 0; t < 16; t++) {
+			lo = std::min(lo, static_cast<int>(texels[4 * t + 3]));
+			hi = std::max(hi, static_cast<int>(texels[4 * t + 3]));
+		}
+
+		block[0] = static_cast<uint8_t>(hi);
+		block[1] = static_cast<uint8_t>(lo);
+
+		//hi > lo selects the 8 value palette, equal endpoints leave every index on 0
+		uint64_t bits = 0;
+		if (hi > lo) {
+			int palette[8];
+			palette[0] = hi;
+			palette[1] = lo;
+			for (int i = 1; i < 7; i++) {
+				palette[i + 1] = ((7 - i) * hi + i * lo) / 7;
+			}
+
+			for (uint32_t t = 0; t < 16; t++) {
+				int alpha = texels[4 * t + 3];
+				uint64_t best_index = 0;
+				int best = 256;
+				for (uint32_t i = 0; i < 8; i++) {
+					int err = std::abs(palette[i] - alpha);
+					if (err < best) {
+						best = err;
+						best_index = i;
+					}
+				}
+				bits |= best_index << (3 * t);
+			}
+		}
+
+		for (uint32_t i = 0; i < 6; i++) {
+			block[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+		}
+	}
+
+	/* BC7 mode 6: 7 bit RGBA endpoints with a p-bit each + 4 bit indices */
+
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct BC7Endpoint {
+		uint8_t _color[4];
+		uint8_t _pBit;
+	};
+
+	//Tries both p-bits, the p-bit is the shared low bit of all 4 channels
+	BC7Endpoint quantizeBC7(const float* color)
+	{
+		BC7Endpoint best{};
+		float best_err = -1.0f;
+
+		for (uint8_t p = 0; p < 2; p++) {
+			BC7Endpoint endpoint{};
+			endpoint._pBit = p;
+			float err = 0.0f;
+			for (uint32_t c = 0; c < 4; c++) {
+				int q = std::clamp(static_cast<int>(std::lround((color[c] - p) / 2.0f)), 0, 127);
+				endpoint._color[c] = static_cast<uint8_t>(q);
+				float d = static_cast<float>((q << 1) | p) - color[c];
+				err += d * d;
+			}
+			if (best_err < 0.0f || err < best_err) {
+				best_err = err;
+				best = endpoint;
+			}
+		}
+		return best;
+	}
+
+	uint32_t fitBC7(const uint8_t* texels, const BC7Endpoint& e0, const BC7Endpoint& e1, uint8_t* indices)
+	{
+		int palette[16][4];
+		for (uint32_t i = 0; i < 16; i++) {
+			for (uint32_t c = 0; c < 4; c++) {
+				int a = (e0._color[c] << 1) | e0._pBit;
+				int b = (e1._color[c] << 1) | e1._pBit;
+				palette[i][c] = ((64 - BC7_WEIGHTS[i]) * a + BC7_WEIGHTS[i] * b + 32) >> 6;
+			}
+		}
+
+		uint32_t total = 0;
+		for (uint32_t t = 0; t < 16; t++) {
+			uint32_t best = UINT32_MAX;
+			for (uint32_t i = 0; i < 16; i++) {
+				uint32_t err = distance2(palette[i], texels + 4 * t, 4);
+				if (err < best) {
+					best = err;
+					indices[t] = static_cast<uint8_t>(i);
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	//Blocks are little endian bit streams starting at bit 0 of byte 0
+	struct BitWriter {
+		uint8_t* _data;
+		uint32_t _pos{ 0 };
+
+		void write(uint32_t value, uint32_t bits)
+		{
+			for (uint32_t i = 0; i < bits; i++, _pos++) {
+				if ((value >> i) & 1) {
+					_data[_pos >> 3] |= static_cast<uint8_t>(1 << (_pos & 7));
+				}
+			}
+		}
+	};
+}
+
+void vk_compress::encodeBC1(const uint8_t* texels, uint8_t* block)
+{
+	encodeColor(texels, block);
+}
+
+void vk_compress::encodeBC3(const uint8_t* texels, uint8_t* block)
+{
+	encodeAlpha(texels, block);
+	//BC3 color blocks always decode with the 4 color palette, the c0 > c1 ordering from BC1 is harmless
+	encodeColor(texels, block + 8);
+}
+
+void vk_compress::encodeBC7(const uint8_t* texels, uint8_t* block)
+{
+	float mean[4], axis[4], lo[4], hi[4];
+	fitLine(texels, 4, mean, axis);
+	lineEndpoints(texels, 4, mean, axis, lo, hi);
+
+	BC7Endpoint e0 = quantizeBC7(lo);
+	BC7Endpoint e1 = quantizeBC7(hi);
+	uint8_t indices[16];
+	uint32_t err = fitBC7(texels, e0, e1, indices);
+
+	float weights[16];
+	for (uint32_t i = 0; i < 16; i++) {
+		weights[i] = BC7_WEIGHTS[i] / 64.0f;
+	}
+
+	float a[4], b[4];
+	if (err > 0 && refineEndpoints(texels, 4, indices, weights, a, b)) {
+		BC7Endpoint r0 = quantizeBC7(a);
+		BC7Endpoint r1 = quantizeBC7(b);
+		uint8_t refined[16];
+		if (fitBC7(texels, r0, r1, refined) < err) {
+			e0 = r0;
+			e1 = r1;
+			std::memcpy(indices, refined, sizeof(indices));
+		}
+	}
+
+	//Texel 0's index is stored without its top bit, flip the line so it's clear
+	if (indices[0] & 8) {
+		std::swap(e0, e1);
+		for (uint32_t t = 0; t < 16; t++) {
+			indices[t] = static_cast<uint8_t>(15 - indices[t]);
+		}
+	}
+
+	std::memset(block, 0, 16);
+	BitWriter writer{ block };
+
+	//Mode 6 = 6 zero bits then a one
+	writer.write(1 << 6, 7);
+	for (uint32_t c = 0; c < 4; c++) {
+		writer.write(e0._color[c], 7);
+		writer.write(e1._color[c], 7);
+	}
+	writer.write(e0._pBit, 1);
+	writer.write(e1._pBit, 1);
+	for (uint32_t t = 0; t < 16; t++) {
+		writer.write(indices[t], t == 0 ? 3 : 4);
+	}
+}
+
+void vk_compress::compressLevel(vk_jobs::ThreadPool& pool, VkFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out)
+{
+	void (*encode)(const uint8_t*, uint8_t*) = nullptr;
+	switch (format) {
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		encode = encodeBC1;
+		break;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+		encode = encodeBC3;
+		break;
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		encode = encodeBC7;
+		break;
+	default:
+		//Uncompressed levels are stored as they are
+		std::memcpy(out, rgba, getLevelSize(format, width, height));
+		return;
+	}
+
+	uint32_t blocks_x = (width + 3) / 4;
+	uint32_t blocks_y = (height + 3) / 4;
+	uint32_t block_size = getBlockSize(format);
+
+	//One block row per batch, rows are independent
+	pool.parallelFor(blocks_y, 1, [&](uint32_t begin, uint32_t end) {
+		uint8_t texels[64];
+
+		for (uint32_t by = begin; by < end; by++) {
+			for (uint32_t bx = 0; bx < blocks_x; bx++) {
+				for (uint32_t y = 0; y < 4; y++) {
+					uint32_t sy = std::min(by * 4 + y, height - 1);
+					for (uint32_t x = 0; x < 4; x++) {
+						uint32_t sx = std::min(bx * 4 + x, width - 1);
+						std::memcpy(texels + 4 * (4 * y + x), rgba + 4 * (static_cast<size_t>(sy) * width + sx), 4);
+					}
+				}
+				encode(texels, out + (static_cast<size_t>(by) * blocks_x + bx) * block_size);
+			}
+		}
+	});
+}
+
+void vk_compress::compressImage(vk_jobs::ThreadPool& pool, VkFormat format, const vk_io::ImageData& src, vk_io::ImageData& dst)
+{
+	uint32_t levels = static_cast<uint32_t>(src._levelOffsets.size());
+
+	dst._width = src._width;
+	dst._height = src._height;
+	dst._format = format;
+	dst._levelOffsets.resize(levels);
+
+	size_t size = 0;
+	for (uint32_t i = 0; i < levels; i++) {
+		dst._levelOffsets[i] = size;
+		size += getLevelSize(format, std::max(src._width >> i, 1u), std::max(src._height >> i, 1u));
+	}
+	dst._pixels.resize(size);
+
+	for (uint32_t i = 0; i < levels; i++) {
+		compressLevel(pool, format, src._pixels.data() + src._levelOffsets[i], std::max(src._width >> i, 1u), std::max(src._height >> i, 1u), dst._pixels.data() + dst._levelOffsets[i]);
+	}
+}
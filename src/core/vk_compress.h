@@ -0,0 +1,43 @@
+#pragma once
+
+#include "vk_types.h"
+#include "vk_jobs.h"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace vk_io {
+	struct ImageData;
+}
+
+namespace vk_compress {
+
+	/* Formats */
+
+	//BC1/BC3/BC7 (either color space)
+	bool isBlockCompressed(VkFormat format);
+
+	//Bytes per 4x4 block, or per texel for uncompressed formats
+	uint32_t getBlockSize(VkFormat format);
+
+	//Bytes of one mip level, partial blocks at the edges count as whole ones
+	size_t getLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+	/* Block encoders, texels are a 4x4 block of RGBA8 in row order */
+
+	//Opaque, alpha is ignored
+	void encodeBC1(const uint8_t* texels, uint8_t* block);
+
+	//BC1 color + 8 bit interpolated alpha
+	void encodeBC3(const uint8_t* texels, uint8_t* block);
+
+	//Mode 6 only (one subset, 7 bit RGBA endpoints + p-bits, 4 bit indices)
+	void encodeBC7(const uint8_t* texels, uint8_t* block);
+
+	//Encodes a width x height RGBA8 level into getLevelSize(format, ...) bytes at out, block rows are split across the pool.
+	//Edge blocks repeat the last row/column
+	void compressLevel(vk_jobs::ThreadPool& pool, VkFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out);
+
+	//Every level of an RGBA8 image, dst gets format, the same dimensions and level count
+	void compressImage(vk_jobs::ThreadPool& pool, VkFormat format, const vk_io::ImageData& src, vk_io::ImageData& dst);
+}
@@ -288,7 +288,7 @@ VkSamplerCreateInfo vk_init::samplerCreateInfo(VkFilter filters, VkSamplerAddres
 	return create_info;
 }
 
-VkImageCreateInfo vk_init::imageCreateInfo(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent)
+VkImageCreateInfo vk_init::imageCreateInfo(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent, uint32_t mipLevels)
 {
 	VkImageCreateInfo create_info{};
 	create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -299,7 +299,7 @@ VkImageCreateInfo vk_init::imageCreateInfo(VkFormat format, VkImageUsageFlags us
 	create_info.format = format;
 	create_info.extent = extent;
 
-	create_info.mipLevels = 1;
+	create_info.mipLevels = mipLevels;
 	create_info.arrayLayers = 1;
 	create_info.samples = VK_SAMPLE_COUNT_1_BIT;
 	create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -308,7 +308,7 @@ VkImageCreateInfo vk_init::imageCreateInfo(VkFormat format, VkImageUsageFlags us
 	return create_info;
 }
 
-VkImageViewCreateInfo vk_init::imageViewCreateInfo(VkFormat format, VkImage image, VkImageAspectFlags flags)
+VkImageViewCreateInfo vk_init::imageViewCreateInfo(VkFormat format, VkImage image, VkImageAspectFlags flags, uint32_t levelCount)
 {
 	VkImageViewCreateInfo create_info{};
 	create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -318,7 +318,7 @@ VkImageViewCreateInfo vk_init::imageViewCreateInfo(VkFormat format, VkImage imag
 	create_info.image = image;
 	create_info.format = format;
 	create_info.subresourceRange.baseMipLevel = 0;
-	create_info.subresourceRange.levelCount = 1;
+	create_info.subresourceRange.levelCount = levelCount;
 	create_info.subresourceRange.baseArrayLayer = 0;
 	create_info.subresourceRange.layerCount = 1;
 	create_info.subresourceRange.aspectMask = flags;
@@ -326,7 +326,7 @@ VkImageViewCreateInfo vk_init::imageViewCreateInfo(VkFormat format, VkImage imag
 	return create_info;
 }
 
-VkPipeline vk_init::PipelineBuilder::build(VkDevice device, VkRenderPass renderPass)
+VkPipeline vk_init::PipelineBuilder::build(VkDevice device, VkRenderPass renderPass, uint32_t subpass)
 {
 
 	VkPipelineViewportStateCreateInfo viewport_state{};
@@ -339,14 +339,16 @@ VkPipeline vk_init::PipelineBuilder::build(VkDevice device, VkRenderPass renderP
 	viewport_state.pScissors = &_scissor;
 
 	//dummy blending
+	std::vector<VkPipelineColorBlendAttachmentState> blend_attachments(_colorAttachmentCount, _colorBlendAttachment);
+
 	VkPipelineColorBlendStateCreateInfo color_blending{};
 	color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 	color_blending.pNext = nullptr;
 
 	color_blending.logicOpEnable = VK_FALSE;
 	color_blending.logicOp = VK_LOGIC_OP_COPY;
-	color_blending.attachmentCount = 1;
-	color_blending.pAttachments = &_colorBlendAttachment;
+	color_blending.attachmentCount = _colorAttachmentCount;
+	color_blending.pAttachments = blend_attachments.data();
 
 
 	VkGraphicsPipelineCreateInfo create_info{};
@@ -364,12 +366,12 @@ VkPipeline vk_init::PipelineBuilder::build(VkDevice device, VkRenderPass renderP
 	create_info.pDepthStencilState = &_depthStencil;
 	create_info.layout = _layout;
 	create_info.renderPass = renderPass;
-	create_info.subpass = 0;
+	create_info.subpass = subpass;
 	create_info.basePipelineHandle = VK_NULL_HANDLE;
 
 	VkPipeline pipeline{};
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, _cache, 1, &create_info, nullptr, &pipeline) != VK_SUCCESS) {
 		std::cout << "Failed to create pipeline!" <<  std::endl;
 		return VK_NULL_HANDLE; 
 	}
@@ -41,7 +41,7 @@ namespace vk_init {
 	
 	class PipelineBuilder {
 	public:
-		VkPipeline build(VkDevice device, VkRenderPass renderPass);
+		VkPipeline build(VkDevice device, VkRenderPass renderPass, uint32_t subpass = 0);
 
 		//Vertex stages
 		std::vector<VkPipelineShaderStageCreateInfo> _shaderStages{};
@@ -54,11 +54,16 @@ namespace vk_init {
 		//Fragment stages
 		VkPipelineRasterizationStateCreateInfo _rasterizer{};
 		VkPipelineColorBlendAttachmentState _colorBlendAttachment{};
+		//Same blend state is used for every color attachment of the subpass
+		uint32_t _colorAttachmentCount{ 1 };
 		VkPipelineDepthStencilStateCreateInfo _depthStencil;
 		VkPipelineMultisampleStateCreateInfo _multisampling{};
 
 		//Layout
 		VkPipelineLayout _layout{};
+
+		//Optional, lets the driver skip compiles it has already done
+		VkPipelineCache _cache{ VK_NULL_HANDLE };
 	};
 
 
@@ -82,8 +87,8 @@ namespace vk_init {
 
 	/* Images */
 
-	VkImageCreateInfo imageCreateInfo(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent);
+	VkImageCreateInfo imageCreateInfo(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent, uint32_t mipLevels = 1);
 
-	VkImageViewCreateInfo imageViewCreateInfo(VkFormat format, VkImage image, VkImageAspectFlags flags);
+	VkImageViewCreateInfo imageViewCreateInfo(VkFormat format, VkImage image, VkImageAspectFlags flags, uint32_t levelCount = 1);
 
 }
\ No newline at end of file
@@ -1,9 +1,15 @@
 #include "vk_io.h"
 #include "vk_util.h"
 #include "vk_init.h"
+#include "vk_cache.h"
+#include "math/simd.h"
 
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cmath>
 
 #include "stb_image.h"
 
@@ -45,9 +51,84 @@ bool vk_io::loadShaderModule(VkDevice device, const char* filePath, VkShaderModu
 	return true;
 }
 
-bool vk_io::loadImage(VkApp& app, const char* filePath, vk_types::AllocatedImage& image)
+namespace {
+
+	//dst texel = rounded mean of its 2x2 footprint in src, the footprint is clamped for 1 texel wide/high sources
+	void downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight)
+	{
+		for (uint32_t y = 0; y < dstHeight; y++) {
+			const uint8_t* row0 = src + static_cast<size_t>(std::min(2 * y, srcHeight - 1)) * srcWidth * 4;
+			const uint8_t* row1 = src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4;
+			uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+			uint32_t x = 0;
+
+#ifdef LIGHTBX_SIMD_SSE
+			//4 source texels per row -> 2 destination texels, sums are widened to 16 bits so nothing overflows
+			if (srcWidth >= 2) {
+				__m128i zero = _mm_setzero_si128();
+				__m128i round = _mm_set1_epi16(2);
+
+				for (; x + 2 <= dstWidth; x += 2) {
+					__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x));
+					__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x));
+
+					//Texels 0,1 in lo, 2,3 in hi
+					__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+					__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+					//(0 + 1, 2 + 3)
+					__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+					sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(out + 4 * x), _mm_packus_epi16(sum, zero));
+				}
+			}
+#endif
+
+			for (; x < dstWidth; x++) {
+				uint32_t x0 = std::min(2 * x, srcWidth - 1) * 4;
+				uint32_t x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+				for (uint32_t c = 0; c < 4; c++) {
+					uint32_t sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+					out[4 * x + c] = static_cast<uint8_t>((sum + 2) >> 2);
+				}
+			}
+		}
+	}
+}
+
+uint32_t vk_io::getMipLevelCount(uint32_t width, uint32_t height)
 {
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+		levels++;
+	}
+	return levels;
+}
+
+void vk_io::generateMips(ImageData& imageData)
+{
+	uint32_t levels = getMipLevelCount(imageData._width, imageData._height);
+
+	//Size the whole chain up front so the source level never moves while writing the next one
+	imageData._levelOffsets.resize(levels);
+	size_t size = 0;
+	for (uint32_t i = 0; i < levels; i++) {
+		imageData._levelOffsets[i] = size;
+		size += static_cast<size_t>(std::max(imageData._width >> i, 1u)) * std::max(imageData._height >> i, 1u) * 4;
+	}
+	imageData._pixels.resize(size);
+
+	for (uint32_t i = 1; i < levels; i++) {
+		downsample(
+			imageData._pixels.data() + imageData._levelOffsets[i - 1], std::max(imageData._width >> (i - 1), 1u), std::max(imageData._height >> (i - 1), 1u),
+			imageData._pixels.data() + imageData._levelOffsets[i], std::max(imageData._width >> i, 1u), std::max(imageData._height >> i, 1u));
+	}
+}
 
+bool vk_io::decodeImage(const char* filePath, ImageData& imageData, bool mips)
+{
 	int width, height, num_channels;
 
 	stbi_uc* data = stbi_load(filePath, &width, &height, &num_channels, STBI_rgb_alpha);
@@ -57,90 +138,610 @@ bool vk_io::loadImage(VkApp& app, const char* filePath, vk_types::AllocatedImage
 		return false;
 	}
 
-	//Put image data in staging buffer
+	imageData._width = static_cast<uint32_t>(width);
+	imageData._height = static_cast<uint32_t>(height);
+	imageData._format = VK_FORMAT_R8G8B8A8_SRGB;
+	imageData._levelOffsets.assign(1, 0);
+	imageData._pixels.assign(data, data + static_cast<size_t>(width) * height * 4);
 
-	void* pixels = (void*)data;
-	VkDeviceSize size = width * height * 4;
+	stbi_image_free(data);
 
-	VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+	if (mips) {
+		generateMips(imageData);
+	}
 
-	vk_types::AllocatedBuffer staging_buffer = vk_util::createBuffer(app._allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+	return true;
+}
 
-	void* mem;
-	vmaMapMemory(app._allocator, staging_buffer._allocation, &mem);
+namespace {
 
-	memcpy(mem, pixels, static_cast<size_t>(size));
+	//Gpu only, sampled + upload destination
+	void allocateImage(VmaAllocator allocator, VkFormat format, VkExtent3D extent, uint32_t mipLevels, vk_types::AllocatedImage& image)
+	{
+		VkImageCreateInfo create_info = vk_init::imageCreateInfo(format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, extent, mipLevels);
 
-	vmaUnmapMemory(app._allocator, staging_buffer._allocation);
+		VmaAllocationCreateInfo alloc_info{};
+		alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-	stbi_image_free(pixels);
+		VK_CHECK(vmaCreateImage(allocator, &create_info, &alloc_info, &image._image, &image._allocation, nullptr));
+	}
+}
 
+void vk_io::createImage(VmaAllocator allocator, vk_upload::UploadQueue& uploadQueue, const ImageData& imageData, vk_types::AllocatedImage& image)
+{
 	VkExtent3D extent;
-	extent.width = static_cast<uint32_t>(width);
-	extent.height = static_cast<uint32_t>(height);
+	extent.width = imageData._width;
+	extent.height = imageData._height;
 	extent.depth = 1;
 
-	//Allocate gpu only image 
+	allocateImage(allocator, imageData._format, extent, static_cast<uint32_t>(imageData._levelOffsets.size()), image);
 
-	VkImageCreateInfo create_info = vk_init::imageCreateInfo(format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, extent);
+	//Pixels get copied into staging memory here, the gpu copy + layout changes go out with the next batch
+	uploadQueue.uploadImage(imageData._pixels.data(), imageData._pixels.size(), image._image, extent, imageData._levelOffsets);
+}
 
-	VmaAllocationCreateInfo alloc_info{};
-	alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+void vk_io::createImage(VmaAllocator allocator, vk_upload::UploadQueue& uploadQueue, const vk_cache::TextureFile& file, vk_types::AllocatedImage& image)
+{
+	const vk_cache::Ktx2Header& header = file.getHeader();
 
-	VK_CHECK(vmaCreateImage(app._allocator, &create_info, &alloc_info, &image._image, &image._allocation, nullptr));
+	VkExtent3D extent;
+	extent.width = header._pixelWidth;
+	extent.height = header._pixelHeight;
+	extent.depth = 1;
 
-	app.immediateSubmit([=](VkCommandBuffer cmd) {
-		VkImageSubresourceRange range;
-		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		range.baseMipLevel = 0;
-		range.levelCount = 1;
-		range.baseArrayLayer = 0;
-		range.layerCount = 1;
+	allocateImage(allocator, file.getFormat(), extent, file.getLevelCount(), image);
 
-		VkImageMemoryBarrier imageBarrier_toTransfer = {};
-		imageBarrier_toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	std::vector<const void*> levels(file.getLevelCount());
+	std::vector<size_t> level_sizes(file.getLevelCount());
+	for (uint32_t i = 0; i < file.getLevelCount(); i++) {
+		levels[i] = file.getLevelData(i);
+		level_sizes[i] = file.getLevelSize(i);
+	}
 
-		imageBarrier_toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageBarrier_toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageBarrier_toTransfer.image = image._image;
-		imageBarrier_toTransfer.subresourceRange = range;
+	//Copied from the mapping into staging memory, the file can be closed once this returns
+	uploadQueue.uploadImage(levels, level_sizes, image._image, extent);
+}
 
-		imageBarrier_toTransfer.srcAccessMask = 0;
-		imageBarrier_toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+namespace {
 
-		//barrier the image into the transfer-receive layout
-		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toTransfer);
+	/* OBJ parsing, all helpers stop at end and never read past it */
 
-		//Copy buffer data to image
-		VkBufferImageCopy copyRegion = {};
-		copyRegion.bufferOffset = 0;
-		copyRegion.bufferRowLength = 0;
-		copyRegion.bufferImageHeight = 0;
+	const char* skipSpaces(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t')) {
+			p++;
+		}
+		return p;
+	}
 
-		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		copyRegion.imageSubresource.mipLevel = 0;
-		copyRegion.imageSubresource.baseArrayLayer = 0;
-		copyRegion.imageSubresource.layerCount = 1;
-		copyRegion.imageExtent = extent;
+	bool isDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
 
-		//copy the buffer into the image
-		vkCmdCopyBufferToImage(cmd, staging_buffer._buffer, image._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+	//Returns p unchanged if there's no number
+	const char* parseInt(const char* p, const char* end, int32_t& value)
+	{
+		const char* start = p;
+		bool negative = false;
+
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+
+		if (p == end || !isDigit(*p)) {
+			return start;
+		}
+
+		int64_t result = 0;
+		while (p < end && isDigit(*p)) {
+			result = result * 10 + (*p - '0');
+			p++;
+		}
+
+		value = static_cast<int32_t>(negative ? -result : result);
+		return p;
+	}
 
-		//Change layout one more time
+	//Plain decimal/exponent notation, much faster than strtof and locale independent
+	const char* parseFloat(const char* p, const char* end, float& value)
+	{
+		const char* start = p;
+		bool negative = false;
+
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+
+		double result = 0.0;
+		bool digits = false;
+
+		while (p < end && isDigit(*p)) {
+			result = result * 10.0 + (*p - '0');
+			p++;
+			digits = true;
+		}
+
+		if (p < end && *p == '.') {
+			p++;
+			double scale = 0.1;
+			while (p < end && isDigit(*p)) {
+				result += (*p - '0') * scale;
+				scale *= 0.1;
+				p++;
+				digits = true;
+			}
+		}
+
+		if (!digits) {
+			return start;
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			int32_t exponent = 0;
+			const char* exp_end = parseInt(p + 1, end, exponent);
+			if (exp_end != p + 1) {
+				result *= std::pow(10.0, exponent);
+				p = exp_end;
+			}
+		}
+
+		value = static_cast<float>(negative ? -result : result);
+		return p;
+	}
 
-		VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
+	//OBJ indices are 1 based, negative ones count back from the latest element. -1 = not given
+	bool resolveIndex(int32_t index, size_t count, int32_t& resolved)
+	{
+		int64_t i = index > 0 ? static_cast<int64_t>(index) - 1 : static_cast<int64_t>(count) + index;
 
-		imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		if (index == 0 || i < 0 || i >= static_cast<int64_t>(count)) {
+			return false;
+		}
 
-		imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		resolved = static_cast<int32_t>(i);
+		return true;
+	}
 
-		//barrier the image into the shader readable layout
-		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
-	});
+	struct ObjIndex {
+		int32_t _position;
+		int32_t _texCoord;
+		int32_t _normal;
+
+		bool operator==(const ObjIndex& rhs) const
+		{
+			return _position == rhs._position && _texCoord == rhs._texCoord && _normal == rhs._normal;
+		}
+	};
+
+	struct ObjIndexHash {
+		size_t operator()(const ObjIndex& index) const
+		{
+			uint64_t h = static_cast<uint32_t>(index._position);
+			h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(index._texCoord);
+			h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(index._normal);
+			return static_cast<size_t>(h ^ (h >> 32));
+		}
+	};
+
+	class ObjParser {
+	public:
+		explicit ObjParser(vk_primitives::mesh::Mesh& mesh) : _mesh(mesh) {}
+
+		bool parseLine(const char* p, const char* end)
+		{
+			_line++;
+			p = skipSpaces(p, end);
+
+			if (p == end || *p == '#') {
+				return true;
+			}
+
+			if (p[0] == 'v' && p + 1 < end) {
+				if (p[1] == ' ' || p[1] == '\t') {
+					math::Vec3 position{};
+					if (!parseFloats(p + 1, end, &position[0], 3)) {
+						return fail("bad vertex position");
+					}
+					_positions.push_back(position);
+					return true;
+				}
+				if (p[1] == 'n') {
+					math::Vec3 normal{};
+					if (!parseFloats(p + 2, end, &normal[0], 3)) {
+						return fail("bad vertex normal");
+					}
+					_normals.push_back(normal);
+					return true;
+				}
+				if (p[1] == 't') {
+					//Optional w is ignored
+					math::Vec2 tex_coord{};
+					if (!parseFloats(p + 2, end, &tex_coord[0], 2)) {
+						return fail("bad texture coordinate");
+					}
+					_texCoords.push_back(tex_coord);
+					return true;
+				}
+			}
+
+			if (p[0] == 'f' && p + 1 < end && (p[1] == ' ' || p[1] == '\t')) {
+				return parseFace(p + 1, end);
+			}
+
+			//Objects, groups, smoothing groups and materials don't affect geometry
+			return true;
+		}
+
+		bool finish()
+		{
+			if (!_needsNormals) {
+				return true;
+			}
+
+			//Area weighted face normals for vertices the file gave no normal
+			auto& vertices = _mesh._vertices;
+			auto& indices = _mesh._indices;
+			for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+				uint32_t i0 = indices[i];
+				uint32_t i1 = indices[i + 1];
+				uint32_t i2 = indices[i + 2];
+
+				if (!_generated[i0] && !_generated[i1] && !_generated[i2]) {
+					continue;
+				}
+
+				math::Vec3 e1 = vertices[i1].position - vertices[i0].position;
+				math::Vec3 e2 = vertices[i2].position - vertices[i0].position;
+				math::Vec3 face_normal = e1.cross(e2);
+
+				for (uint32_t index : { i0, i1, i2 }) {
+					if (_generated[index]) {
+						vertices[index].normal += face_normal;
+					}
+				}
+			}
+
+			for (size_t i = 0; i < vertices.size(); i++) {
+				if (!_generated[i]) {
+					continue;
+				}
+				float length = vertices[i].normal.norm();
+				vertices[i].normal = length > 0.0f ? vertices[i].normal / length : math::Vec3{ 0.0,1.0,0.0 };
+			}
+
+			return true;
+		}
+
+		uint32_t getLine() const
+		{
+			return _line;
+		}
+
+		const char* getError() const
+		{
+			return _error;
+		}
+
+	private:
+		bool fail(const char* error)
+		{
+			_error = error;
+			return false;
+		}
+
+		bool parseFloats(const char* p, const char* end, float* values, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; i++) {
+				p = skipSpaces(p, end);
+				const char* next = parseFloat(p, end, values[i]);
+				if (next == p) {
+					return false;
+				}
+				p = next;
+			}
+			return true;
+		}
+
+		bool parseFace(const char* p, const char* end)
+		{
+			//Exporters write all positions before the faces, most meshes end up with about one vertex per position
+			if (_mesh._vertices.empty()) {
+				_vertexLookup.reserve(_positions.size());
+				_mesh._vertices.reserve(_positions.size());
+				_generated.reserve(_positions.size());
+			}
+
+			_corners.clear();
+
+			while (true) {
+				p = skipSpaces(p, end);
+				if (p == end) {
+					break;
+				}
+
+				//v, v/vt, v//vn or v/vt/vn
+				int32_t v = 0;
+				int32_t vt = 0;
+				int32_t vn = 0;
+
+				const char* next = parseInt(p, end, v);
+				if (next == p) {
+					return fail("bad face index");
+				}
+				p = next;
+
+				if (p < end && *p == '/') {
+					p = parseInt(p + 1, end, vt);
+					if (p < end && *p == '/') {
+						p = parseInt(p + 1, end, vn);
+					}
+				}
+
+				ObjIndex index{ -1,-1,-1 };
+				if (!resolveIndex(v, _positions.size(), index._position)) {
+					return fail("vertex index out of range");
+				}
+				if (vt != 0 && !resolveIndex(vt, _texCoords.size(), index._texCoord)) {
+					return fail("texture coordinate index out of range");
+				}
+				if (vn != 0 && !resolveIndex(vn, _normals.size(), index._normal)) {
+					return fail("normal index out of range");
+				}
+
+				_corners.push_back(getVertex(index));
+			}
+
+			if (_corners.size() < 3) {
+				return fail("face with less than 3 vertices");
+			}
+
+			//Fan triangulation, fine for the convex polygons exporters write
+			for (size_t i = 2; i < _corners.size(); i++) {
+				_mesh._indices.push_back(_corners[0]);
+				_mesh._indices.push_back(_corners[i - 1]);
+				_mesh._indices.push_back(_corners[i]);
+			}
+
+			return true;
+		}
+
+		uint32_t getVertex(const ObjIndex& index)
+		{
+			auto it = _vertexLookup.find(index);
+			if (it != _vertexLookup.end()) {
+				return it->second;
+			}
+
+			vk_primitives::mesh::Vertex_F3_F3_F2 vertex{};
+			vertex.position = _positions[index._position];
+
+			if (index._normal >= 0) {
+				vertex.normal = _normals[index._normal];
+			}
+
+			if (index._texCoord >= 0) {
+				//OBJ has v pointing up, vulkan images start at the top
+				const math::Vec2& tex_coord = _texCoords[index._texCoord];
+				vertex.texCoords = math::Vec2{ tex_coord.x(),1.0f - tex_coord.y() };
+			}
+
+			uint32_t id = static_cast<uint32_t>(_mesh._vertices.size());
+			_mesh._vertices.push_back(vertex);
+			_generated.push_back(index._normal < 0);
+			_needsNormals |= index._normal < 0;
+
+			_vertexLookup.emplace(index, id);
+			return id;
+		}
+
+		vk_primitives::mesh::Mesh& _mesh;
+
+		std::vector<math::Vec3> _positions;
+		std::vector<math::Vec3> _normals;
+		std::vector<math::Vec2> _texCoords;
+
+		std::unordered_map<ObjIndex, uint32_t, ObjIndexHash> _vertexLookup;
+		std::vector<uint32_t> _corners;
+
+		//Per output vertex, true if its normal has to be generated
+		std::vector<bool> _generated;
+		bool _needsNormals{ false };
+
+		uint32_t _line{ 0 };
+		const char* _error{ nullptr };
+	};
+
+	constexpr size_t OBJ_CHUNK_SIZE = 1 << 20;
+}
 
-	vmaDestroyBuffer(app._allocator, staging_buffer._buffer, staging_buffer._allocation);
+bool vk_io::loadObj(const char* filePath, vk_primitives::mesh::Mesh& mesh)
+{
+	std::ifstream file(filePath, std::ios::binary);
 
-	return true;
+	if (!file.is_open()) {
+		std::cout << "Failed to load: " << filePath << std::endl;
+		return false;
+	}
+
+	mesh._vertices.clear();
+	mesh._indices.clear();
+
+	ObjParser parser{ mesh };
+
+	//Read fixed size chunks, a line cut off at the end of a chunk is carried into the next one
+	std::vector<char> buffer(OBJ_CHUNK_SIZE);
+	size_t carried = 0;
+
+	while (true) {
+		if (carried == buffer.size()) {
+			buffer.resize(buffer.size() * 2);
+		}
+
+		file.read(buffer.data() + carried, static_cast<std::streamsize>(buffer.size() - carried));
+		size_t size = carried + static_cast<size_t>(file.gcount());
+		bool eof = !file;
+
+		const char* p = buffer.data();
+		const char* end = p + size;
+
+		while (p < end) {
+			const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (!line_end) {
+				if (!eof) {
+					break;
+				}
+				line_end = end;
+			}
+
+			const char* content_end = line_end;
+			if (content_end > p && content_end[-1] == '\r') {
+				content_end--;
+			}
+
+			if (!parser.parseLine(p, content_end)) {
+				std::cout << "Failed to load: " << filePath << " (line " << parser.getLine() << ": " << parser.getError() << ")" << std::endl;
+				return false;
+			}
+
+			p = line_end < end ? line_end + 1 : end;
+		}
+
+		carried = static_cast<size_t>(end - p);
+		if (eof) {
+			break;
+		}
+		memmove(buffer.data(), p, carried);
+	}
+
+	return parser.finish();
+}
+
+bool vk_io::writePPM(const char* filePath, uint32_t width, uint32_t height, const uint8_t* rgb)
+{
+	std::ofstream file(filePath, std::ios::binary);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+	file.write((const char*)rgb, static_cast<std::streamsize>(width) * height * 3);
+
+	return file.good();
+}
+
+namespace {
+
+	uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+	{
+		static uint32_t table[256];
+		static bool tableInit = false;
+
+		if (!tableInit) {
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++) {
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				table[i] = c;
+			}
+			tableInit = true;
+		}
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	void writeU32BE(std::vector<uint8_t>& out, uint32_t v)
+	{
+		out.push_back((v >> 24) & 0xFF);
+		out.push_back((v >> 16) & 0xFF);
+		out.push_back((v >> 8) & 0xFF);
+		out.push_back(v & 0xFF);
+	}
+
+	void writeChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> chunk{};
+		writeU32BE(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+
+		//Crc covers type + data
+		uint32_t crc = crc32(0, chunk.data() + 4, chunk.size() - 4);
+		writeU32BE(chunk, crc);
+
+		file.write((const char*)chunk.data(), chunk.size());
+	}
+}
+
+bool vk_io::writePNG(const char* filePath, uint32_t width, uint32_t height, const uint8_t* rgb)
+{
+	std::ofstream file(filePath, std::ios::binary);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	const uint8_t signature[] = { 0x89,'P','N','G','\r','\n',0x1A,'\n' };
+	file.write((const char*)signature, sizeof(signature));
+
+	/* Header */
+	std::vector<uint8_t> ihdr{};
+	writeU32BE(ihdr, width);
+	writeU32BE(ihdr, height);
+	ihdr.push_back(8); //Bit depth
+	ihdr.push_back(2); //Truecolor
+	ihdr.push_back(0); //Deflate
+	ihdr.push_back(0); //Adaptive filtering
+	ihdr.push_back(0); //No interlace
+	writeChunk(file, "IHDR", ihdr);
+
+	/* Image data */
+	//Every scanline gets filter type 0 (None)
+	size_t row_size = static_cast<size_t>(width) * 3;
+	std::vector<uint8_t> raw{};
+	raw.reserve((row_size + 1) * height);
+	for (uint32_t y = 0; y < height; y++) {
+		raw.push_back(0);
+		raw.insert(raw.end(), rgb + y * row_size, rgb + (y + 1) * row_size);
+	}
+
+	//Zlib stream made of stored (uncompressed) deflate blocks, frame dumps favor speed over size
+	std::vector<uint8_t> idat{};
+	idat.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+	idat.push_back(0x78);
+	idat.push_back(0x01);
+
+	size_t pos = 0;
+	do {
+		size_t len = std::min<size_t>(raw.size() - pos, 65535);
+		bool last = pos + len == raw.size();
+		idat.push_back(last ? 1 : 0);
+		idat.push_back(len & 0xFF);
+		idat.push_back((len >> 8) & 0xFF);
+		idat.push_back(~len & 0xFF);
+		idat.push_back((~len >> 8) & 0xFF);
+		idat.insert(idat.end(), raw.begin() + pos, raw.begin() + pos + len);
+		pos += len;
+	} while (pos < raw.size());
+
+	uint32_t a = 1, b = 0;
+	for (uint8_t byte : raw) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	writeU32BE(idat, (b << 16) | a);
+
+	writeChunk(file, "IDAT", idat);
+
+	writeChunk(file, "IEND", {});
+
+	return file.good();
 }
@@ -3,10 +3,50 @@
 #include "vk_types.h"
 #include "vk_log.h"
 #include "vk_app.h"
+#include "vk_cache.h"
+#include "primitives/mesh.h"
+
+#include <vector>
 
 namespace vk_io {
 
 	bool loadShaderModule(VkDevice device, const char* filePath, VkShaderModule* shaderModule);
 
-	bool loadImage(VkApp& app,const char* filePath, vk_types::AllocatedImage& image);
+	/* Images */
+
+	//Decoded RGBA8 pixels or cooked compressed blocks, mip levels are packed back to back from the full size image down
+	struct ImageData {
+		uint32_t _width{ 0 };
+		uint32_t _height{ 0 };
+		VkFormat _format{ VK_FORMAT_R8G8B8A8_SRGB };
+		//Byte offset of each mip level in _pixels, one entry = no mips
+		std::vector<size_t> _levelOffsets{ 0 };
+		std::vector<uint8_t> _pixels;
+	};
+
+	//Full chain down to 1x1
+	uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+	//Appends 2x2 box filtered levels behind level 0 (SSE2 when available). Cpu only
+	void generateMips(ImageData& imageData);
+
+	//Cpu only, safe to call from worker threads
+	bool decodeImage(const char* filePath, ImageData& imageData, bool mips = true);
+
+	//Creates the gpu image and queues its upload
+	void createImage(VmaAllocator allocator, vk_upload::UploadQueue& uploadQueue, const ImageData& imageData, vk_types::AllocatedImage& image);
+
+	//Cooked .ktx2 (see vk_cache::writeTexture), levels are copied from the file mapping straight into staging memory, nothing is decoded
+	void createImage(VmaAllocator allocator, vk_upload::UploadQueue& uploadQueue, const vk_cache::TextureFile& file, vk_types::AllocatedImage& image);
+
+	/* Meshes */
+
+	//Wavefront OBJ (v/vt/vn + faces), polygons are fan triangulated, vertices deduplicated.
+	//Cpu only, safe to call from worker threads
+	bool loadObj(const char* filePath, vk_primitives::mesh::Mesh& mesh);
+
+	/* Frame dumps (tightly packed 8-bit RGB) */
+	bool writePPM(const char* filePath, uint32_t width, uint32_t height, const uint8_t* rgb);
+
+	bool writePNG(const char* filePath, uint32_t width, uint32_t height, const uint8_t* rgb);
 }
\ No newline at end of file
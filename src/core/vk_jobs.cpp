@@ -0,0 +1,195 @@
+#include "vk_jobs.h"
+
+#include <algorithm>
+#include <memory>
+
+void vk_jobs::ThreadPool::init(uint32_t numThreads)
+{
+	if (numThreads == 0) {
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	_stop = false;
+	_active = 0;
+
+	for (uint32_t i = 0; i < numThreads; i++) {
+		_threads.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+void vk_jobs::ThreadPool::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		_stop = true;
+	}
+	_jobReady.notify_all();
+
+	for (auto& thread : _threads) {
+		thread.join();
+	}
+	_threads.clear();
+}
+
+void vk_jobs::ThreadPool::submit(std::function<void()>&& job)
+{
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		_jobs.push_back(std::move(job));
+	}
+	_jobReady.notify_one();
+}
+
+void vk_jobs::ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock{ _mutex };
+	_jobsDone.wait(lock, [this]() { return _jobs.empty() && _active == 0; });
+}
+
+void vk_jobs::ThreadPool::parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& fn)
+{
+	if (count == 0) {
+		return;
+	}
+	batchSize = std::max(1u, batchSize);
+	uint32_t batches = (count + batchSize - 1) / batchSize;
+
+	//Batches are claimed from a shared counter so fast threads take more of them.
+	//Helpers can start after every batch is done and this call returned, so they only hold on to the shared state,
+	//fn is only touched through a claimed batch, which the caller waits for
+	struct Batches {
+		const std::function<void(uint32_t begin, uint32_t end)>* _fn;
+		uint32_t _count;
+		uint32_t _batchSize;
+		uint32_t _batches;
+		std::atomic<uint32_t> _next{ 0 };
+		std::atomic<uint32_t> _remaining;
+
+		std::mutex _mutex;
+		std::condition_variable _done;
+	};
+
+	auto state = std::make_shared<Batches>();
+	state->_fn = &fn;
+	state->_count = count;
+	state->_batchSize = batchSize;
+	state->_batches = batches;
+	state->_remaining = batches;
+
+	auto run = [](Batches& batch_state) {
+		for (uint32_t batch = batch_state._next++; batch < batch_state._batches; batch = batch_state._next++) {
+			uint32_t begin = batch * batch_state._batchSize;
+			(*batch_state._fn)(begin, std::min(batch_state._count, begin + batch_state._batchSize));
+
+			if (--batch_state._remaining == 0) {
+				std::lock_guard<std::mutex> lock{ batch_state._mutex };
+				batch_state._done.notify_one();
+			}
+		}
+	};
+
+	uint32_t helpers = std::min(batches - 1, getThreadCount());
+	for (uint32_t i = 0; i < helpers; i++) {
+		submit([state, run]() { run(*state); });
+	}
+
+	run(*state);
+
+	//Batches taken by helpers may still be running, helpers that haven't started yet are not waited for
+	std::unique_lock<std::mutex> lock{ state->_mutex };
+	state->_done.wait(lock, [&]() { return state->_remaining == 0; });
+}
+
+uint32_t vk_jobs::ThreadPool::getThreadCount() const
+{
+	return static_cast<uint32_t>(_threads.size());
+}
+
+void vk_jobs::ThreadPool::workerLoop()
+{
+	while (true) {
+		std::function<void()> job;
+
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			_jobReady.wait(lock, [this]() { return _stop || !_jobs.empty(); });
+
+			//Drain the queue before stopping
+			if (_jobs.empty()) {
+				return;
+			}
+
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+			_active++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_active--;
+			if (_jobs.empty() && _active == 0) {
+				_jobsDone.notify_all();
+			}
+		}
+	}
+}
+
+void vk_jobs::AssetLoader::init(ThreadPool* pool)
+{
+	_pool = pool;
+	_pending = 0;
+}
+
+void vk_jobs::AssetLoader::load(std::function<Completion()>&& work)
+{
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		_pending++;
+	}
+
+	_pool->submit([this, work = std::move(work)]() {
+		Completion completion = work();
+
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_completed.push_back(std::move(completion));
+		}
+		_loadDone.notify_all();
+	});
+}
+
+uint32_t vk_jobs::AssetLoader::poll()
+{
+	std::vector<Completion> completed;
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		completed.swap(_completed);
+		_pending -= static_cast<uint32_t>(completed.size());
+	}
+
+	for (auto& completion : completed) {
+		if (completion) {
+			completion();
+		}
+	}
+
+	std::lock_guard<std::mutex> lock{ _mutex };
+	return _pending;
+}
+
+void vk_jobs::AssetLoader::finish()
+{
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			_loadDone.wait(lock, [this]() { return _pending == 0 || !_completed.empty(); });
+		}
+
+		//Completions run as results arrive so uploads overlap the remaining decodes
+		if (poll() == 0) {
+			return;
+		}
+	}
+}
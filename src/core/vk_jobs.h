@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace vk_jobs {
+
+	/* Fixed set of worker threads pulling jobs off a shared queue */
+	class ThreadPool {
+	public:
+		//0 threads picks one per hardware thread
+		void init(uint32_t numThreads = 0);
+		void destroy();
+
+		void submit(std::function<void()>&& job);
+
+		//Block until the queue is empty and no job is running
+		void wait();
+
+		//Split [0,count) into batches run by the workers and the calling thread, returns once every batch ran.
+		//Only waits on its own batches, never on unrelated jobs queued ahead of its helpers, so it can be called from a pool job
+		void parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& fn);
+
+		uint32_t getThreadCount() const;
+
+	private:
+		void workerLoop();
+
+		std::vector<std::thread> _threads;
+
+		std::mutex _mutex;
+		std::condition_variable _jobReady;
+		std::condition_variable _jobsDone;
+		std::deque<std::function<void()>> _jobs;
+		uint32_t _active{ 0 };
+		bool _stop{ false };
+	};
+
+	/* Runs loads on the pool, each load returns a completion that runs on the thread calling poll/finish.
+	   Decoding/parsing happens on workers, anything touching vulkan goes in the completion */
+	class AssetLoader {
+	public:
+		using Completion = std::function<void()>;
+
+		void init(ThreadPool* pool);
+
+		void load(std::function<Completion()>&& work);
+
+		//Run completions of finished loads, returns # of loads still in flight
+		uint32_t poll();
+
+		//Block until every load has finished and its completion ran
+		void finish();
+
+	private:
+		ThreadPool* _pool{ nullptr };
+
+		std::mutex _mutex;
+		std::condition_variable _loadDone;
+		std::vector<Completion> _completed;
+		uint32_t _pending{ 0 };
+	};
+}
@@ -0,0 +1,166 @@
+#include "vk_lights.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+float vk_lights::cutoffRadius(const LightEntity& light, AttenuationModel model)
+{
+	float intensity = std::max({ light.ambient.x(),light.ambient.y(),light.ambient.z(),
+		light.diffuse.x(),light.diffuse.y(),light.diffuse.z(),
+		light.specular.x(),light.specular.y(),light.specular.z() });
+
+	if (intensity <= 0.0f) {
+		return 0.0f;
+	}
+
+	//Solve q*d^2 + l*d + (c - intensity / cutoff) = 0 for the positive root
+	bool polynomial = model == AttenuationModel::POLYNOMIAL;
+	float c = (polynomial ? light._constantAttenuation : 1.0f) - intensity / LIGHT_CUTOFF;
+	float l = polynomial ? light._linearAttenuation : 0.0f;
+	float q = light._quadraticAttenuation;
+
+	//Already below the cutoff at distance 0 (constant attenuation alone dims it enough)
+	if (c >= 0.0f) {
+		return 0.0f;
+	}
+
+	if (q > 0.0f) {
+		float discriminant = l * l - 4.0f * q * c;
+		if (discriminant < 0.0f) {
+			return 0.0f;
+		}
+		return std::max(0.0f, (-l + std::sqrt(discriminant)) / (2.0f * q));
+	}
+	if (l > 0.0f) {
+		return std::max(0.0f, -c / l);
+	}
+
+	//No falloff, reaches everything
+	return INFINITY;
+}
+
+uint32_t vk_lights::LightGrid::build(
+	vk_jobs::ThreadPool& pool,
+	const LightEntity* lights, uint32_t lightCount,
+	const math::Mat4& view, const math::Mat4& proj, float zNear, float zFar,
+	Cluster* clusters, uint32_t* indices, uint32_t maxIndices)
+{
+	//View looks down -z
+	_viewLights.resize(lightCount);
+	for (uint32_t i = 0; i < lightCount; i++) {
+		math::Vec4 p = view * math::Vec4{ lights[i].position.x(),lights[i].position.y(),lights[i].position.z(),1.0f };
+		_viewLights[i] = ViewLight{ p.x(),p.y(),-p.z(),lights[i]._radius };
+	}
+
+	pool.parallelFor(CLUSTER_Z, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t z = begin; z < end; z++) {
+			binSlice(z, proj, zNear, zFar);
+		}
+	});
+
+	//Concatenate slices in order
+	uint32_t written = 0;
+	_overflow = 0;
+	for (uint32_t z = 0; z < CLUSTER_Z; z++) {
+		const Slice& slice = _slices[z];
+		uint32_t count = static_cast<uint32_t>(slice._indices.size());
+		uint32_t kept = std::min(count, maxIndices - written);
+
+		memcpy(indices + written, slice._indices.data(), kept * sizeof(uint32_t));
+
+		for (uint32_t tile = 0; tile < CLUSTER_X * CLUSTER_Y; tile++) {
+			//Clusters past the cut keep whatever part of their range survived
+			uint32_t offset = std::min(slice._offsets[tile], kept);
+			uint32_t tile_count = std::min(slice._counts[tile], kept - offset);
+			clusters[z * CLUSTER_X * CLUSTER_Y + tile] = Cluster{ written + offset,tile_count };
+		}
+
+		written += kept;
+		_overflow += count - kept;
+	}
+
+	return written;
+}
+
+uint32_t vk_lights::LightGrid::getOverflow() const
+{
+	return _overflow;
+}
+
+void vk_lights::LightGrid::binSlice(uint32_t z, const math::Mat4& proj, float zNear, float zFar)
+{
+	Slice& slice = _slices[z];
+	slice._counts.assign(CLUSTER_X * CLUSTER_Y, 0);
+	slice._offsets.resize(CLUSTER_X * CLUSTER_Y);
+	slice._indices.clear();
+	slice._rects.clear();
+
+	float slice_near = zNear * std::pow(zFar / zNear, static_cast<float>(z) / CLUSTER_Z);
+	float slice_far = zNear * std::pow(zFar / zNear, static_cast<float>(z + 1) / CLUSTER_Z);
+
+	//Clip space x = P00 * x, y = P11 * y, w = depth
+	float p00 = proj[0][0];
+	float p11 = proj[1][1];
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(_viewLights.size()); i++) {
+		const ViewLight& light = _viewLights[i];
+
+		float d0 = std::max(light._depth - light._radius, slice_near);
+		float d1 = std::min(light._depth + light._radius, slice_far);
+		if (d0 > d1) {
+			continue;
+		}
+
+		//Screen bounds of the box around the sphere cut to this slice, extremes are at its corners
+		float min_x = INFINITY, max_x = -INFINITY, min_y = INFINITY, max_y = -INFINITY;
+		for (float d : { d0,d1 }) {
+			for (float sx : { -1.0f,1.0f }) {
+				float x = p00 * (light._x + sx * light._radius) / d;
+				float y = p11 * (light._y + sx * light._radius) / d;
+				min_x = std::min(min_x, x);
+				max_x = std::max(max_x, x);
+				min_y = std::min(min_y, y);
+				max_y = std::max(max_y, y);
+			}
+		}
+
+		if (max_x < -1.0f || min_x > 1.0f || max_y < -1.0f || min_y > 1.0f) {
+			continue;
+		}
+
+		//Ndc to tiles (framebuffer y is down, P11 already flips)
+		auto tile = [](float ndc, uint32_t tiles) {
+			float t = (ndc * 0.5f + 0.5f) * tiles;
+			return static_cast<uint32_t>(std::clamp(t, 0.0f, static_cast<float>(tiles - 1)));
+		};
+
+		uint32_t x0 = tile(min_x, CLUSTER_X), x1 = tile(max_x, CLUSTER_X);
+		uint32_t y0 = tile(min_y, CLUSTER_Y), y1 = tile(max_y, CLUSTER_Y);
+
+		slice._rects.insert(slice._rects.end(), { i,x0,x1,y0,y1 });
+		for (uint32_t y = y0; y <= y1; y++) {
+			for (uint32_t x = x0; x <= x1; x++) {
+				slice._counts[y * CLUSTER_X + x]++;
+			}
+		}
+	}
+
+	//Counts -> offsets, then fill in light order
+	uint32_t total = 0;
+	for (uint32_t tile = 0; tile < CLUSTER_X * CLUSTER_Y; tile++) {
+		slice._offsets[tile] = total;
+		total += slice._counts[tile];
+	}
+	slice._indices.resize(total);
+
+	std::vector<uint32_t> heads = slice._offsets;
+	for (size_t r = 0; r < slice._rects.size(); r += 5) {
+		const uint32_t* rect = &slice._rects[r];
+		for (uint32_t y = rect[3]; y <= rect[4]; y++) {
+			for (uint32_t x = rect[1]; x <= rect[2]; x++) {
+				slice._indices[heads[y * CLUSTER_X + x]++] = rect[0];
+			}
+		}
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "vk_jobs.h"
+
+#include "math/vec.h"
+#include "math/matrix.h"
+
+#include <cstdint>
+#include <vector>
+
+/* Light (one entry of the light storage buffer read by light.vert and mesh.frag) */
+struct LightEntity{
+	math::Vec4 position;
+	math::Vec4 ambient;
+	math::Vec4 diffuse;
+	math::Vec4 specular;
+	float _constantAttenuation;
+	float _linearAttenuation;
+	float _quadraticAttenuation;
+	//Distance where the light stops contributing, see vk_lights::cutoffRadius
+	float _radius;
+};
+
+/* How lights fall off with distance d, mesh.frag/lightvolume.frag get it as a specialization constant */
+enum class AttenuationModel : uint32_t {
+	//1 / (c + l*d + q*d^2)
+	POLYNOMIAL = 0,
+	//1 / (1 + q*d^2), only the light's quadratic term is used
+	INVERSE_SQUARE = 1
+};
+
+namespace vk_lights {
+
+	/* Froxel grid: screen tiles times depth slices, slices are exponential in view depth */
+	constexpr uint32_t CLUSTER_X = 16;
+	constexpr uint32_t CLUSTER_Y = 9;
+	constexpr uint32_t CLUSTER_Z = 24;
+	constexpr uint32_t CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+	//Light references shared by all clusters in a frame (2000 lights of radius ~12 need ~600k), references past this are dropped
+	constexpr uint32_t MAX_CLUSTER_LIGHTS = 1024 * 1024;
+
+	//Attenuated intensity treated as black
+	constexpr float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+	//Distance at which the brightest channel of the light, attenuated by model, falls below LIGHT_CUTOFF
+	float cutoffRadius(const LightEntity& light, AttenuationModel model = AttenuationModel::POLYNOMIAL);
+
+	/* Range of a cluster in the light index list */
+	struct Cluster {
+		uint32_t _offset;
+		uint32_t _count;
+	};
+
+	/* Bins lights into the clusters of a view on the cpu */
+	class LightGrid {
+	public:
+		//Writes CLUSTER_COUNT clusters (x fastest, then y, then depth slice) and their light indices.
+		//Slices are binned in parallel, the output doesn't depend on thread timing. Returns the number of indices written
+		uint32_t build(
+			vk_jobs::ThreadPool& pool,
+			const LightEntity* lights, uint32_t lightCount,
+			const math::Mat4& view, const math::Mat4& proj, float zNear, float zFar,
+			Cluster* clusters, uint32_t* indices, uint32_t maxIndices
+		);
+
+		//References dropped by the last build because of maxIndices
+		uint32_t getOverflow() const;
+
+	private:
+		/* Light bounds in view space (depth is distance along the view direction) */
+		struct ViewLight {
+			float _x;
+			float _y;
+			float _depth;
+			float _radius;
+		};
+
+		/* One depth slice worth of clusters */
+		struct Slice {
+			std::vector<uint32_t> _counts;
+			std::vector<uint32_t> _offsets;
+			std::vector<uint32_t> _indices;
+			//Light + tile rectangle of every light touching the slice
+			std::vector<uint32_t> _rects;
+		};
+
+		void binSlice(uint32_t z, const math::Mat4& proj, float zNear, float zFar);
+
+		std::vector<ViewLight> _viewLights;
+		Slice _slices[CLUSTER_Z];
+		uint32_t _overflow{ 0 };
+	};
+}
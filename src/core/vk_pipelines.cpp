@@ -0,0 +1,384 @@
+#include "vk_pipelines.h"
+#include "vk_init.h"
+#include "vk_io.h"
+#include "settings.h"
+
+#include "primitives/mesh.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+/* PipelineDesc */
+
+namespace {
+
+	//FNV-1a
+	void hashBytes(uint64_t& hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+	}
+
+	template<typename T>
+	void hashValue(uint64_t& hash, const T& value)
+	{
+		hashBytes(hash, &value, sizeof(T));
+	}
+
+	void hashString(uint64_t& hash, const std::string& value)
+	{
+		hashValue(hash, value.size());
+		hashBytes(hash, value.data(), value.size());
+	}
+
+	void hashConstants(uint64_t& hash, const std::vector<uint32_t>& values)
+	{
+		hashValue(hash, values.size());
+		hashBytes(hash, values.data(), values.size() * sizeof(uint32_t));
+	}
+
+	//Map entries for constant_id 0..count-1, tightly packed 32 bit values
+	VkSpecializationInfo specializationInfo(const std::vector<uint32_t>& values, std::vector<VkSpecializationMapEntry>& entries)
+	{
+		entries.resize(values.size());
+		for (uint32_t i = 0; i < values.size(); i++) {
+			entries[i].constantID = i;
+			entries[i].offset = i * sizeof(uint32_t);
+			entries[i].size = sizeof(uint32_t);
+		}
+
+		VkSpecializationInfo info{};
+		info.mapEntryCount = static_cast<uint32_t>(entries.size());
+		info.pMapEntries = entries.data();
+		info.dataSize = values.size() * sizeof(uint32_t);
+		info.pData = values.data();
+		return info;
+	}
+}
+
+uint64_t vk_pipelines::PipelineDesc::hash() const
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hashString(hash, _vertexShader);
+	hashString(hash, _fragmentShader);
+	hashConstants(hash, _vertexConstants);
+	hashConstants(hash, _fragmentConstants);
+	hashValue(hash, _vertexInput);
+	hashValue(hash, _blend);
+	hashValue(hash, _colorAttachmentCount);
+	hashValue(hash, _depthTest);
+	hashValue(hash, _depthWrite);
+	hashValue(hash, _depthCompare);
+	hashValue(hash, _layout);
+	hashValue(hash, _renderPass);
+	hashValue(hash, _subpass);
+	return hash;
+}
+
+bool vk_pipelines::PipelineDesc::operator==(const PipelineDesc& rhs) const
+{
+	return _vertexShader == rhs._vertexShader && _fragmentShader == rhs._fragmentShader &&
+		_vertexConstants == rhs._vertexConstants && _fragmentConstants == rhs._fragmentConstants &&
+		_vertexInput == rhs._vertexInput && _blend == rhs._blend && _colorAttachmentCount == rhs._colorAttachmentCount &&
+		_depthTest == rhs._depthTest && _depthWrite == rhs._depthWrite && _depthCompare == rhs._depthCompare &&
+		_layout == rhs._layout && _renderPass == rhs._renderPass && _subpass == rhs._subpass;
+}
+
+/* PipelineRegistry */
+
+void vk_pipelines::PipelineRegistry::init(VkDevice device, VkPipelineCache cache, vk_jobs::ThreadPool* pool, VkExtent2D extent)
+{
+	_device = device;
+	_cache = cache;
+	_pool = pool;
+	_extent = extent;
+}
+
+void vk_pipelines::PipelineRegistry::destroy()
+{
+	wait();
+
+	for (auto& entry : _entries) {
+		if (entry->_pipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(_device, entry->_pipeline, nullptr);
+		}
+	}
+	_entries.clear();
+	_lookup.clear();
+
+	for (auto& shader : _shaders) {
+		vkDestroyShaderModule(_device, shader.second, nullptr);
+	}
+	_shaders.clear();
+}
+
+vk_pipelines::PipelineId vk_pipelines::PipelineRegistry::add(const PipelineDesc& desc)
+{
+	uint64_t hash = desc.hash();
+
+	auto range = _lookup.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (_entries[it->second]->_desc == desc) {
+			return it->second;
+		}
+	}
+
+	PipelineId id = static_cast<PipelineId>(_entries.size());
+	_entries.emplace_back(std::make_unique<Entry>());
+	_entries.back()->_desc = desc;
+	_lookup.emplace(hash, id);
+
+	return id;
+}
+
+void vk_pipelines::PipelineRegistry::compile(const std::vector<PipelineId>& ids)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	//Anything already queued in the background is compiled by the drain job instead
+	std::vector<Entry*> missing{};
+	for (PipelineId id : ids) {
+		Entry* entry = _entries[id].get();
+		uint32_t expected = MISSING;
+		if (entry->_state.compare_exchange_strong(expected, QUEUED)) {
+			missing.push_back(entry);
+		}
+	}
+
+	_pool->parallelFor(static_cast<uint32_t>(missing.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			build(*missing[i]);
+		}
+	});
+
+	//Callers expect all of ids to be usable afterwards, including ones the background had
+	for (PipelineId id : ids) {
+		if (_entries[id]->_state.load() == QUEUED) {
+			wait();
+			break;
+		}
+	}
+
+	if (!missing.empty()) {
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Compiled " << missing.size() << " pipelines in " << ms << " ms" << std::endl;
+	}
+}
+
+void vk_pipelines::PipelineRegistry::compileAsync(const std::vector<PipelineId>& ids)
+{
+	bool start_drain = false;
+
+	{
+		std::lock_guard<std::mutex> lock{ _queueMutex };
+		for (PipelineId id : ids) {
+			Entry* entry = _entries[id].get();
+			uint32_t expected = MISSING;
+			if (entry->_state.compare_exchange_strong(expected, QUEUED)) {
+				_queue.push_back(entry);
+			}
+		}
+
+		if (!_queue.empty() && !_draining) {
+			_draining = true;
+			start_drain = true;
+		}
+	}
+
+	if (start_drain) {
+		_pool->submit([this]() { drainQueue(); });
+	}
+}
+
+void vk_pipelines::PipelineRegistry::wait()
+{
+	std::unique_lock<std::mutex> lock{ _queueMutex };
+	_queueDone.wait(lock, [this]() { return !_draining; });
+}
+
+VkPipeline vk_pipelines::PipelineRegistry::get(PipelineId id) const
+{
+	const Entry& entry = *_entries[id];
+	return entry._state.load(std::memory_order_acquire) == READY ? entry._pipeline : VK_NULL_HANDLE;
+}
+
+VkPipeline vk_pipelines::PipelineRegistry::get(PipelineId id, PipelineId fallback)
+{
+	VkPipeline pipeline = get(id);
+	if (pipeline != VK_NULL_HANDLE) {
+		return pipeline;
+	}
+
+	compileAsync({ id });
+	return fallback == INVALID_PIPELINE ? VK_NULL_HANDLE : get(fallback);
+}
+
+bool vk_pipelines::PipelineRegistry::ready(const std::vector<PipelineId>& ids)
+{
+	std::vector<PipelineId> missing{};
+	for (PipelineId id : ids) {
+		if (get(id) == VK_NULL_HANDLE) {
+			missing.push_back(id);
+		}
+	}
+
+	if (!missing.empty()) {
+		compileAsync(missing);
+	}
+
+	return missing.empty();
+}
+
+uint32_t vk_pipelines::PipelineRegistry::getCount() const
+{
+	return static_cast<uint32_t>(_entries.size());
+}
+
+uint32_t vk_pipelines::PipelineRegistry::getPendingCount() const
+{
+	uint32_t pending = 0;
+	for (const auto& entry : _entries) {
+		if (entry->_state.load() == QUEUED) {
+			pending++;
+		}
+	}
+	return pending;
+}
+
+void vk_pipelines::PipelineRegistry::build(Entry& entry)
+{
+	const PipelineDesc& desc = entry._desc;
+
+	vk_init::PipelineBuilder pipeline_builder{};
+	pipeline_builder._cache = _cache;
+
+	/* Shader stages */
+	std::vector<VkSpecializationMapEntry> vertex_entries{};
+	std::vector<VkSpecializationMapEntry> fragment_entries{};
+	VkSpecializationInfo vertex_specialization = specializationInfo(desc._vertexConstants, vertex_entries);
+	VkSpecializationInfo fragment_specialization = specializationInfo(desc._fragmentConstants, fragment_entries);
+
+	VkShaderModule vertex_shader = getShader(desc._vertexShader);
+	VkShaderModule fragment_shader = desc._fragmentShader.empty() ? VK_NULL_HANDLE : getShader(desc._fragmentShader);
+
+	if (vertex_shader == VK_NULL_HANDLE || (!desc._fragmentShader.empty() && fragment_shader == VK_NULL_HANDLE)) {
+		entry._state.store(FAILED, std::memory_order_release);
+		return;
+	}
+
+	VkPipelineShaderStageCreateInfo vertex_stage = vk_init::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, vertex_shader);
+	if (!desc._vertexConstants.empty()) {
+		vertex_stage.pSpecializationInfo = &vertex_specialization;
+	}
+	pipeline_builder._shaderStages.emplace_back(vertex_stage);
+
+	if (!desc._fragmentShader.empty()) {
+		VkPipelineShaderStageCreateInfo fragment_stage = vk_init::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragment_shader);
+		if (!desc._fragmentConstants.empty()) {
+			fragment_stage.pSpecializationInfo = &fragment_specialization;
+		}
+		pipeline_builder._shaderStages.emplace_back(fragment_stage);
+	}
+
+	/* Vertex input */
+	vk_primitives::mesh::VertexInputDescription description{};
+	if (desc._vertexInput == VertexInput::POSITION) {
+		description = vk_primitives::mesh::Vertex_F3::getVertexInputDescription();
+	}
+	else if (desc._vertexInput == VertexInput::POSITION_NORMAL_UV) {
+		description = vk_primitives::mesh::Vertex_F3_F3_F2::getVertexInputDescription();
+	}
+
+	pipeline_builder._vertexInputInfo = vk_init::pipelineVertexInputStateCreateInfo();
+	pipeline_builder._vertexInputInfo.vertexBindingDescriptionCount = description._bindingDescriptions.size();
+	pipeline_builder._vertexInputInfo.vertexAttributeDescriptionCount = description._attributeDescriptions.size();
+	pipeline_builder._vertexInputInfo.pVertexBindingDescriptions = description._bindingDescriptions.data();
+	pipeline_builder._vertexInputInfo.pVertexAttributeDescriptions = description._attributeDescriptions.data();
+
+	pipeline_builder._inputAssembly = vk_init::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+
+	pipeline_builder._viewport.x = 0.0f;
+	pipeline_builder._viewport.y = 0.0f;
+	pipeline_builder._viewport.width = (float)_extent.width;
+	pipeline_builder._viewport.height = (float)_extent.height;
+	pipeline_builder._viewport.minDepth = 0.0f;
+	pipeline_builder._viewport.maxDepth = 1.0f;
+
+	pipeline_builder._scissor.offset = { 0, 0 };
+	pipeline_builder._scissor.extent = _extent;
+
+	/* Fixed function */
+	pipeline_builder._rasterizer = vk_init::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL);
+	pipeline_builder._multisampling = vk_init::pipelineMultisampleStateCreateInfo();
+
+	pipeline_builder._colorBlendAttachment = vk_init::pipelineColorBlendAttachmentState();
+	if (desc._blend == BlendMode::ADDITIVE) {
+		pipeline_builder._colorBlendAttachment.blendEnable = VK_TRUE;
+		pipeline_builder._colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		pipeline_builder._colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		pipeline_builder._colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+		pipeline_builder._colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		pipeline_builder._colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		pipeline_builder._colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	}
+	else if (desc._blend == BlendMode::NO_COLOR) {
+		pipeline_builder._colorBlendAttachment.colorWriteMask = 0;
+	}
+	pipeline_builder._colorAttachmentCount = desc._colorAttachmentCount;
+
+	pipeline_builder._depthStencil = vk_init::pipelineDepthStencilStateCreateInfo(desc._depthTest, desc._depthWrite, desc._depthCompare);
+
+	pipeline_builder._layout = desc._layout;
+
+	entry._pipeline = pipeline_builder.build(_device, desc._renderPass, desc._subpass);
+
+	//Release pairs with the acquire in get(), the handle is visible before the state flips
+	entry._state.store(entry._pipeline != VK_NULL_HANDLE ? READY : FAILED, std::memory_order_release);
+}
+
+VkShaderModule vk_pipelines::PipelineRegistry::getShader(const std::string& name)
+{
+	//Variants share modules, each file is loaded once
+	std::lock_guard<std::mutex> lock{ _shaderMutex };
+
+	auto it = _shaders.find(name);
+	if (it != _shaders.end()) {
+		return it->second;
+	}
+
+	VkShaderModule module{ VK_NULL_HANDLE };
+	std::string path = SHADER_DIR + name;
+	if (!vk_io::loadShaderModule(_device, path.c_str(), &module)) {
+		std::cerr << "Couldn't load shader: " << path << std::endl;
+	}
+	else {
+		std::cout << "Loaded shader: " << path << std::endl;
+	}
+
+	_shaders[name] = module;
+	return module;
+}
+
+void vk_pipelines::PipelineRegistry::drainQueue()
+{
+	while (true) {
+		Entry* entry = nullptr;
+
+		{
+			std::lock_guard<std::mutex> lock{ _queueMutex };
+			if (_queue.empty()) {
+				_draining = false;
+				_queueDone.notify_all();
+				return;
+			}
+			entry = _queue.front();
+			_queue.pop_front();
+		}
+
+		build(*entry);
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "vk_types.h"
+#include "vk_jobs.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace vk_pipelines {
+
+	enum class VertexInput {
+		//Vertices come from gl_VertexIndex
+		NONE,
+		//Vertex_F3
+		POSITION,
+		//Vertex_F3_F3_F2
+		POSITION_NORMAL_UV
+	};
+
+	enum class BlendMode {
+		OPAQUE,
+		ADDITIVE,
+		//Depth only, color outputs are left untouched
+		NO_COLOR
+	};
+
+	/* Everything a graphics pipeline is built from, identical descriptions share one pipeline */
+	struct PipelineDesc {
+		//.spv file names under SHADER_DIR, no fragment shader = depth only
+		std::string _vertexShader{};
+		std::string _fragmentShader{};
+		//Specialization constants, value i goes to constant_id i (all 32 bit)
+		std::vector<uint32_t> _vertexConstants{};
+		std::vector<uint32_t> _fragmentConstants{};
+
+		VertexInput _vertexInput{ VertexInput::POSITION_NORMAL_UV };
+		BlendMode _blend{ BlendMode::OPAQUE };
+		//Same blend state is used for every color attachment of the subpass
+		uint32_t _colorAttachmentCount{ 1 };
+
+		bool _depthTest{ true };
+		bool _depthWrite{ true };
+		VkCompareOp _depthCompare{ VK_COMPARE_OP_LESS_OR_EQUAL };
+
+		VkPipelineLayout _layout{ VK_NULL_HANDLE };
+		VkRenderPass _renderPass{ VK_NULL_HANDLE };
+		uint32_t _subpass{ 0 };
+
+		uint64_t hash() const;
+		bool operator==(const PipelineDesc& rhs) const;
+	};
+
+	//Stable for the registry's lifetime
+	using PipelineId = uint32_t;
+	constexpr PipelineId INVALID_PIPELINE = UINT32_MAX;
+
+	/* Owns every graphics pipeline and the shader modules they're built from.
+	   add/compile/get are called from one thread, compiles run on the pool */
+	class PipelineRegistry {
+	public:
+		void init(VkDevice device, VkPipelineCache cache, vk_jobs::ThreadPool* pool, VkExtent2D extent);
+		//Waits for background compiles, then destroys all pipelines + shader modules
+		void destroy();
+
+		//Registers desc without compiling it, returns the existing id if an identical one was added before
+		PipelineId add(const PipelineDesc& desc);
+
+		//Compiles every missing pipeline of ids concurrently on the pool, returns when they're all done
+		void compile(const std::vector<PipelineId>& ids);
+		//Queues missing pipelines for the background, compiled one at a time so frames keep the rest of the pool
+		void compileAsync(const std::vector<PipelineId>& ids);
+		//Blocks until the background queue is empty
+		void wait();
+
+		//VK_NULL_HANDLE until id has compiled
+		VkPipeline get(PipelineId id) const;
+		//Queues id if it's missing and returns fallback's pipeline until id is ready
+		VkPipeline get(PipelineId id, PipelineId fallback);
+		//True once all of ids are compiled, missing ones are queued
+		bool ready(const std::vector<PipelineId>& ids);
+
+		//Unique pipelines registered / waiting to compile
+		uint32_t getCount() const;
+		uint32_t getPendingCount() const;
+
+	private:
+		enum State : uint32_t {
+			MISSING,
+			QUEUED,
+			READY,
+			//Failed compiles aren't retried, get() keeps returning the fallback
+			FAILED
+		};
+
+		struct Entry {
+			PipelineDesc _desc;
+			std::atomic<uint32_t> _state{ MISSING };
+			VkPipeline _pipeline{ VK_NULL_HANDLE };
+		};
+
+		void build(Entry& entry);
+		VkShaderModule getShader(const std::string& name);
+		//Compiles the background queue front to back, at most one of these runs at a time
+		void drainQueue();
+
+		VkDevice _device{ VK_NULL_HANDLE };
+		VkPipelineCache _cache{ VK_NULL_HANDLE };
+		vk_jobs::ThreadPool* _pool{ nullptr };
+		VkExtent2D _extent{};
+
+		//Entries never move, workers hold pointers into them
+		std::vector<std::unique_ptr<Entry>> _entries;
+		std::unordered_multimap<uint64_t, PipelineId> _lookup;
+
+		std::mutex _shaderMutex;
+		std::unordered_map<std::string, VkShaderModule> _shaders;
+
+		std::mutex _queueMutex;
+		std::condition_variable _queueDone;
+		std::deque<Entry*> _queue;
+		bool _draining{ false };
+	};
+}
@@ -0,0 +1,103 @@
+#include "vk_profiler.h"
+#include "vk_log.h"
+
+void vk_profiler::FrameProfiler::init(VkDevice device, uint32_t maxScopes)
+{
+	_maxScopes = maxScopes;
+
+	VkQueryPoolCreateInfo create_info{};
+	create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	create_info.pNext = nullptr;
+	create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	create_info.queryCount = maxScopes * 2;
+
+	VK_CHECK(vkCreateQueryPool(device, &create_info, nullptr, &_queryPool));
+
+	_names.reserve(maxScopes);
+}
+
+void vk_profiler::FrameProfiler::destroy(VkDevice device)
+{
+	if (isEnabled()) {
+		vkDestroyQueryPool(device, _queryPool, nullptr);
+		_queryPool = VK_NULL_HANDLE;
+	}
+}
+
+void vk_profiler::FrameProfiler::begin(VkCommandBuffer cmd)
+{
+	_names.clear();
+	_pending = false;
+
+	if (!isEnabled()) {
+		return;
+	}
+
+	vkCmdResetQueryPool(cmd, _queryPool, 0, _maxScopes * 2);
+}
+
+uint32_t vk_profiler::FrameProfiler::beginScope(VkCommandBuffer cmd, const char* name)
+{
+	if (!isEnabled() || _names.size() >= _maxScopes) {
+		return UINT32_MAX;
+	}
+
+	uint32_t scope = static_cast<uint32_t>(_names.size());
+	_names.emplace_back(name);
+
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _queryPool, scope * 2);
+
+	return scope;
+}
+
+void vk_profiler::FrameProfiler::endScope(VkCommandBuffer cmd, uint32_t scope)
+{
+	if (scope == UINT32_MAX) {
+		return;
+	}
+
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _queryPool, scope * 2 + 1);
+	_pending = true;
+}
+
+bool vk_profiler::FrameProfiler::resolve(VkDevice device, float timestampPeriod)
+{
+	if (!_pending) {
+		return false;
+	}
+
+	uint32_t queryCount = static_cast<uint32_t>(_names.size()) * 2;
+	std::vector<uint64_t> timestamps(queryCount);
+
+	//No wait flag, frame fence should have signaled already
+	VkResult result = vkGetQueryPoolResults(device, _queryPool, 0, queryCount, timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+	if (result != VK_SUCCESS) {
+		return false;
+	}
+
+	_timings.resize(_names.size());
+	for (size_t i = 0; i < _names.size(); i++) {
+		_timings[i]._name = _names[i];
+		_timings[i]._ms = static_cast<double>(timestamps[i * 2 + 1] - timestamps[i * 2]) * timestampPeriod * 1e-6;
+	}
+
+	_pending = false;
+
+	return true;
+}
+
+bool vk_profiler::FrameProfiler::isEnabled() const
+{
+	return _queryPool != VK_NULL_HANDLE;
+}
+
+bool vk_profiler::FrameProfiler::isPending() const
+{
+	return _pending;
+}
+
+const std::vector<vk_profiler::ScopeTiming>& vk_profiler::FrameProfiler::getTimings() const
+{
+	return _timings;
+}
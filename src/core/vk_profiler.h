@@ -0,0 +1,46 @@
+#pragma once
+
+#include "vk_types.h"
+
+#include <string>
+#include <vector>
+
+namespace vk_profiler {
+
+	struct ScopeTiming {
+		std::string _name;
+		double _ms;
+	};
+
+	/* Named gpu timestamp scopes recorded into a single frame's command buffer */
+	class FrameProfiler {
+	public:
+		void init(VkDevice device, uint32_t maxScopes);
+		void destroy(VkDevice device);
+
+		//Reset queries, must be recorded outside of a render pass
+		void begin(VkCommandBuffer cmd);
+
+		//Scopes may nest, returns id to pass to endScope
+		uint32_t beginScope(VkCommandBuffer cmd, const char* name);
+		void endScope(VkCommandBuffer cmd, uint32_t scope);
+
+		//Read back last recorded frame without waiting, false if results aren't available yet
+		bool resolve(VkDevice device, float timestampPeriod);
+
+		bool isEnabled() const;
+		bool isPending() const;
+		const std::vector<ScopeTiming>& getTimings() const;
+
+	private:
+		VkQueryPool _queryPool{ VK_NULL_HANDLE };
+		uint32_t _maxScopes{ 0 };
+
+		//Scopes recorded this frame, begin/end timestamps at queries 2i,2i+1
+		std::vector<std::string> _names;
+		bool _pending{ false };
+
+		//Results of last resolved frame
+		std::vector<ScopeTiming> _timings;
+	};
+}
@@ -0,0 +1,595 @@
+#include "vk_resources.h"
+#include "vk_log.h"
+#include "vk_init.h"
+#include "vk_util.h"
+#include "vk_io.h"
+#include "vk_cache.h"
+#include "vk_compress.h"
+
+#include "vk_mem_alloc.h"
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace {
+
+	void hashBytes(uint64_t& hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+	}
+
+	constexpr uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+	//Same file spelled differently (./a/../b.png, b.png) maps to one entry
+	uint64_t hashPath(uint8_t kind, const std::string& path)
+	{
+		std::string normal = std::filesystem::path(path).lexically_normal().generic_string();
+
+		uint64_t hash = HASH_SEED;
+		hashBytes(hash, &kind, sizeof(kind));
+		hashBytes(hash, normal.data(), normal.size());
+		return hash;
+	}
+
+	uint64_t hashImage(const vk_io::ImageData& imageData)
+	{
+		uint64_t hash = HASH_SEED;
+		hashBytes(hash, &imageData._format, sizeof(imageData._format));
+		hashBytes(hash, &imageData._width, sizeof(imageData._width));
+		hashBytes(hash, &imageData._height, sizeof(imageData._height));
+		hashBytes(hash, imageData._pixels.data(), imageData._pixels.size());
+		return hash;
+	}
+
+	//Straight from the file mapping
+	uint64_t hashTexture(const vk_cache::TextureFile& file)
+	{
+		const vk_cache::Ktx2Header& header = file.getHeader();
+		VkFormat format = file.getFormat();
+
+		uint64_t hash = HASH_SEED;
+		hashBytes(hash, &format, sizeof(format));
+		hashBytes(hash, &header._pixelWidth, sizeof(header._pixelWidth));
+		hashBytes(hash, &header._pixelHeight, sizeof(header._pixelHeight));
+		for (uint32_t i = 0; i < file.getLevelCount(); i++) {
+			hashBytes(hash, file.getLevelData(i), file.getLevelSize(i));
+		}
+		return hash;
+	}
+
+	uint64_t hashMesh(const void* vertices, size_t verticesSize, const void* indices, size_t indicesSize)
+	{
+		//Texture and mesh bytes never share a key
+		uint64_t hash = HASH_SEED ^ 1;
+		hashBytes(hash, &verticesSize, sizeof(verticesSize));
+		hashBytes(hash, vertices, verticesSize);
+		hashBytes(hash, indices, indicesSize);
+		return hash;
+	}
+
+	size_t getAllocationSize(VmaAllocator allocator, VmaAllocation allocation)
+	{
+		VmaAllocationInfo info{};
+		vmaGetAllocationInfo(allocator, allocation, &info);
+		return static_cast<size_t>(info.size);
+	}
+}
+
+void vk_resources::ResourceManager::init(const ResourceConfig& config, vk_jobs::AssetLoader* loader)
+{
+	_config = config;
+	_loader = loader;
+}
+
+void vk_resources::ResourceManager::initDevice(VkDevice device, VmaAllocator allocator, vk_upload::UploadQueue* uploadQueue, bool bcSupported)
+{
+	_device = device;
+	_allocator = allocator;
+	_uploadQueue = uploadQueue;
+	//Published for workers, they skip cooked BC files the device can't sample
+	_bcSupported.store(bcSupported, std::memory_order_relaxed);
+	_deviceReady.store(true, std::memory_order_release);
+}
+
+void vk_resources::ResourceManager::destroy()
+{
+	for (Retired& retired : _retired) {
+		destroyData(retired._kind, retired._texture, retired._mesh);
+	}
+	_retired.clear();
+
+	for (Slot& slot : _slots) {
+		if (slot._state == State::READY && slot._alias == NO_SLOT) {
+			destroyData(slot._kind, slot._texture, slot._mesh);
+		}
+	}
+
+	_slots.clear();
+	_freeSlots.clear();
+	_pathLookup.clear();
+	_contentLookup.clear();
+	_residentBytes = 0;
+}
+
+/* Loads */
+
+vk_resources::TextureHandle vk_resources::ResourceManager::loadTexture(const std::string& path)
+{
+	bool created = false;
+	uint32_t index = acquire(Kind::TEXTURE, path, created);
+	TextureHandle handle{ index, _slots[index]._generation };
+	if (!created) {
+		return handle;
+	}
+
+	//A cooked <name>.ktx2 next to the source is preferred, its blocks go to the gpu without decoding
+	std::string source_path = path;
+	std::string cooked_path = std::filesystem::path(path).replace_extension(".ktx2").string();
+	bool allow_cooked = _config._cookedTextures;
+
+	_loader->load([this, index, source_path, cooked_path, allow_cooked]() -> vk_jobs::AssetLoader::Completion {
+		//Cooked files stay mapped until the completion copied their levels into staging memory, like cooked meshes
+		auto texture_file = std::make_shared<vk_cache::TextureFile>();
+		if (allow_cooked && std::filesystem::exists(cooked_path) && texture_file->open(cooked_path.c_str())) {
+			bool block_compressed = vk_compress::isBlockCompressed(texture_file->getFormat());
+
+			//Device already known to lack BC sampling, decode the source right here instead
+			if (!block_compressed || !_deviceReady.load(std::memory_order_acquire) || _bcSupported.load(std::memory_order_relaxed)) {
+				uint64_t content_hash = hashTexture(*texture_file);
+
+				return [this, index, source_path, cooked_path, texture_file, content_hash, block_compressed]() {
+					//Loaded before the device existed and BC turned out unsupported, decode the source on a worker
+					if (block_compressed && !_bcSupported) {
+						std::cout << "No BC texture support, decoding: " << source_path << std::endl;
+						_loader->load([this, index, source_path]() { return decodeTexture(index, source_path); });
+						return;
+					}
+
+					if (dedupeContent(index, content_hash)) {
+						std::cout << "Loaded image: " << cooked_path << " (shared)" << std::endl;
+						return;
+					}
+
+					Slot& slot = _slots[index];
+					vk_io::createImage(_allocator, *_uploadQueue, *texture_file, slot._texture._image);
+					createTextureView(texture_file->getFormat(), slot._texture);
+					setLoaded(index, content_hash, getAllocationSize(_allocator, slot._texture._image._allocation));
+					std::cout << "Loaded image: " << cooked_path << std::endl;
+				};
+			}
+
+			std::cout << "No BC texture support, decoding: " << source_path << std::endl;
+		}
+
+		return decodeTexture(index, source_path);
+	});
+
+	return handle;
+}
+
+vk_resources::MeshHandle vk_resources::ResourceManager::loadMesh(const std::string& path)
+{
+	bool created = false;
+	uint32_t index = acquire(Kind::MESH, path, created);
+	MeshHandle handle{ index, _slots[index]._generation };
+	if (!created) {
+		return handle;
+	}
+
+	bool cooked = std::filesystem::path(path).extension() == ".lbxmesh";
+
+	_loader->load([this, index, path, cooked]() -> vk_jobs::AssetLoader::Completion {
+		//Cooked meshes are mapped and copied straight from the mapping into staging memory
+		if (cooked) {
+			auto mesh_file = std::make_shared<vk_cache::MeshFile>();
+			if (!mesh_file->open(path.c_str(), vk_primitives::mesh::Vertex_F3_F3_F2::getVertexInputDescription())) {
+				return [this, index]() { failed(index); };
+			}
+
+			uint64_t content_hash = hashMesh(mesh_file->getVertexData(), mesh_file->getVertexDataSize(), mesh_file->getIndexData(), mesh_file->getIndexDataSize());
+
+			return [this, index, path, mesh_file, content_hash]() {
+				if (dedupeContent(index, content_hash)) {
+					std::cout << "Loaded mesh: " << path << " (shared)" << std::endl;
+					return;
+				}
+
+				const vk_cache::MeshHeader& header = mesh_file->getHeader();
+				VkIndexType index_type = header._indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+				GPUMesh& mesh = _slots[index]._mesh;
+				createMesh(mesh_file->getVertexData(), mesh_file->getVertexDataSize(), mesh_file->getIndexData(), header._indexCount, index_type, mesh);
+
+				//Sphere around the origin containing the cooked bounding box
+				math::Vec3 corner{};
+				for (int i = 0; i < 3; i++) {
+					corner[i] = std::max(std::fabs(header._boundsMin[i]), std::fabs(header._boundsMax[i]));
+				}
+				mesh._boundingRadius = corner.norm();
+
+				setLoaded(index, content_hash, getAllocationSize(_allocator, mesh._vertexBuffer._allocation) +
+					getAllocationSize(_allocator, mesh._positionBuffer._allocation) + getAllocationSize(_allocator, mesh._indexBuffer._allocation));
+				std::cout << "Loaded mesh: " << path << std::endl;
+			};
+		}
+
+		auto mesh = std::make_shared<vk_primitives::mesh::Mesh>();
+		if (!vk_io::loadObj(path.c_str(), *mesh)) {
+			return [this, index]() { failed(index); };
+		}
+
+		uint64_t content_hash = hashMesh(mesh->_vertices.data(), mesh->_vertices.size() * sizeof(vk_primitives::mesh::Vertex_F3_F3_F2),
+			mesh->_indices.data(), mesh->_indices.size() * sizeof(uint32_t));
+
+		return [this, index, path, mesh, content_hash]() {
+			if (dedupeContent(index, content_hash)) {
+				std::cout << "Loaded mesh: " << path << " (shared)" << std::endl;
+				return;
+			}
+
+			GPUMesh& gpu_mesh = _slots[index]._mesh;
+			createMesh(*mesh, gpu_mesh);
+			setLoaded(index, content_hash, getAllocationSize(_allocator, gpu_mesh._vertexBuffer._allocation) +
+				getAllocationSize(_allocator, gpu_mesh._positionBuffer._allocation) + getAllocationSize(_allocator, gpu_mesh._indexBuffer._allocation));
+			std::cout << "Loaded mesh: " << path << std::endl;
+		};
+	});
+
+	return handle;
+}
+
+vk_resources::MeshHandle vk_resources::ResourceManager::addMesh(const std::string& name, const vk_primitives::mesh::Mesh& mesh)
+{
+	bool created = false;
+	uint32_t index = acquire(Kind::MESH, name, created);
+	MeshHandle handle{ index, _slots[index]._generation };
+	if (!created) {
+		return handle;
+	}
+
+	uint64_t content_hash = hashMesh(mesh._vertices.data(), mesh._vertices.size() * sizeof(vk_primitives::mesh::Vertex_F3_F3_F2),
+		mesh._indices.data(), mesh._indices.size() * sizeof(uint32_t));
+	if (dedupeContent(index, content_hash)) {
+		return handle;
+	}
+
+	GPUMesh& gpu_mesh = _slots[index]._mesh;
+	createMesh(mesh, gpu_mesh);
+	setLoaded(index, content_hash, getAllocationSize(_allocator, gpu_mesh._vertexBuffer._allocation) +
+		getAllocationSize(_allocator, gpu_mesh._positionBuffer._allocation) + getAllocationSize(_allocator, gpu_mesh._indexBuffer._allocation));
+
+	return handle;
+}
+
+/* References */
+
+void vk_resources::ResourceManager::retain(TextureHandle handle)
+{
+	if (resolve(Kind::TEXTURE, handle._index, handle._generation)) {
+		retainSlot(handle._index);
+	}
+}
+
+void vk_resources::ResourceManager::retain(MeshHandle handle)
+{
+	if (resolve(Kind::MESH, handle._index, handle._generation)) {
+		retainSlot(handle._index);
+	}
+}
+
+void vk_resources::ResourceManager::release(TextureHandle handle)
+{
+	if (resolve(Kind::TEXTURE, handle._index, handle._generation)) {
+		releaseSlot(handle._index);
+	}
+}
+
+void vk_resources::ResourceManager::release(MeshHandle handle)
+{
+	if (resolve(Kind::MESH, handle._index, handle._generation)) {
+		releaseSlot(handle._index);
+	}
+}
+
+const vk_resources::Texture& vk_resources::ResourceManager::get(TextureHandle handle) const
+{
+	static const Texture EMPTY{};
+
+	const Slot* slot = resolve(Kind::TEXTURE, handle._index, handle._generation);
+	if (!slot || slot->_state != State::READY) {
+		return EMPTY;
+	}
+	return slot->_alias != NO_SLOT ? _slots[slot->_alias]._texture : slot->_texture;
+}
+
+const GPUMesh& vk_resources::ResourceManager::get(MeshHandle handle) const
+{
+	static const GPUMesh EMPTY{};
+
+	const Slot* slot = resolve(Kind::MESH, handle._index, handle._generation);
+	if (!slot || slot->_state != State::READY) {
+		return EMPTY;
+	}
+	return slot->_alias != NO_SLOT ? _slots[slot->_alias]._mesh : slot->_mesh;
+}
+
+/* Eviction */
+
+void vk_resources::ResourceManager::update(uint64_t frameNum)
+{
+	_frameNum = frameNum;
+
+	//Frames that could still bind an evicted resource have all waited on their fence by now
+	while (!_retired.empty() && _retired.front()._frame + _config._framesInFlight <= frameNum) {
+		Retired& retired = _retired.front();
+		destroyData(retired._kind, retired._texture, retired._mesh);
+		_retired.pop_front();
+	}
+
+	if (_residentBytes <= _config._budget) {
+		return;
+	}
+
+	//Unreferenced resources, least recently released first
+	std::vector<uint32_t> candidates{};
+	for (uint32_t i = 0; i < static_cast<uint32_t>(_slots.size()); i++) {
+		const Slot& slot = _slots[i];
+		if (slot._state == State::READY && slot._refCount == 0 && slot._size > 0) {
+			candidates.push_back(i);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+		return _slots[a]._releasedFrame < _slots[b]._releasedFrame;
+	});
+
+	for (uint32_t index : candidates) {
+		if (_residentBytes <= _config._budget) {
+			break;
+		}
+		evict(index);
+	}
+}
+
+size_t vk_resources::ResourceManager::getResidentBytes() const
+{
+	return _residentBytes;
+}
+
+uint32_t vk_resources::ResourceManager::getResourceCount() const
+{
+	return static_cast<uint32_t>(_slots.size() - _freeSlots.size());
+}
+
+/* Slots */
+
+uint32_t vk_resources::ResourceManager::acquire(Kind kind, const std::string& path, bool& created)
+{
+	uint64_t path_hash = hashPath(static_cast<uint8_t>(kind), path);
+
+	auto it = _pathLookup.find(path_hash);
+	if (it != _pathLookup.end()) {
+		created = false;
+		retainSlot(it->second);
+		return it->second;
+	}
+
+	uint32_t index;
+	if (!_freeSlots.empty()) {
+		index = _freeSlots.back();
+		_freeSlots.pop_back();
+	}
+	else {
+		index = static_cast<uint32_t>(_slots.size());
+		_slots.emplace_back();
+	}
+
+	Slot& slot = _slots[index];
+	slot._kind = kind;
+	slot._state = State::LOADING;
+	slot._refCount = 1;
+	slot._path = path;
+	slot._pathHash = path_hash;
+	_pathLookup[path_hash] = index;
+
+	created = true;
+	return index;
+}
+
+bool vk_resources::ResourceManager::dedupeContent(uint32_t index, uint64_t contentHash)
+{
+	auto it = _contentLookup.find(contentHash);
+	if (it == _contentLookup.end()) {
+		return false;
+	}
+
+	//The alias keeps its owner alive for as long as it's referenced itself
+	retainSlot(it->second);
+
+	Slot& slot = _slots[index];
+	slot._state = State::READY;
+	slot._alias = it->second;
+	slot._size = 0;
+
+	//Every reference was dropped while it loaded
+	if (slot._refCount == 0) {
+		evict(index);
+	}
+	return true;
+}
+
+void vk_resources::ResourceManager::setLoaded(uint32_t index, uint64_t contentHash, size_t size)
+{
+	Slot& slot = _slots[index];
+	slot._state = State::READY;
+	slot._contentHash = contentHash;
+	slot._size = size;
+	slot._releasedFrame = _frameNum;
+
+	_contentLookup[contentHash] = index;
+	_residentBytes += size;
+}
+
+void vk_resources::ResourceManager::failed(uint32_t index)
+{
+	//The loader already reported why
+	Slot& slot = _slots[index];
+	slot._state = State::FAILED;
+	if (slot._refCount == 0) {
+		evict(index);
+	}
+}
+
+const vk_resources::ResourceManager::Slot* vk_resources::ResourceManager::resolve(Kind kind, uint32_t index, uint32_t generation) const
+{
+	if (index >= _slots.size()) {
+		return nullptr;
+	}
+
+	const Slot& slot = _slots[index];
+	if (slot._state == State::FREE || slot._kind != kind || slot._generation != generation) {
+		return nullptr;
+	}
+	return &slot;
+}
+
+void vk_resources::ResourceManager::retainSlot(uint32_t index)
+{
+	_slots[index]._refCount++;
+}
+
+void vk_resources::ResourceManager::releaseSlot(uint32_t index)
+{
+	Slot& slot = _slots[index];
+	if (slot._refCount == 0 || --slot._refCount > 0) {
+		return;
+	}
+
+	slot._releasedFrame = _frameNum;
+
+	//Nothing to cache: aliases own no memory (the owner stays cached instead), failed loads own nothing
+	if (slot._alias != NO_SLOT || slot._state == State::FAILED) {
+		evict(index);
+	}
+}
+
+void vk_resources::ResourceManager::evict(uint32_t index)
+{
+	Slot& slot = _slots[index];
+
+	if (slot._alias != NO_SLOT) {
+		releaseSlot(slot._alias);
+	}
+	else if (slot._state == State::READY) {
+		_retired.push_back(Retired{ slot._kind, slot._texture, slot._mesh, _frameNum });
+		_contentLookup.erase(slot._contentHash);
+		_residentBytes -= slot._size;
+	}
+
+	_pathLookup.erase(slot._pathHash);
+
+	//Outstanding handles to this slot stop resolving
+	uint32_t generation = slot._generation + 1;
+	slot = Slot{};
+	slot._generation = generation;
+	_freeSlots.push_back(index);
+}
+
+void vk_resources::ResourceManager::destroyData(Kind kind, Texture& texture, GPUMesh& mesh)
+{
+	if (kind == Kind::TEXTURE) {
+		vkDestroyImageView(_device, texture._view, nullptr);
+		vmaDestroyImage(_allocator, texture._image._image, texture._image._allocation);
+		texture = Texture{};
+		return;
+	}
+
+	vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation);
+	vmaDestroyBuffer(_allocator, mesh._positionBuffer._buffer, mesh._positionBuffer._allocation);
+	vmaDestroyBuffer(_allocator, mesh._indexBuffer._buffer, mesh._indexBuffer._allocation);
+	mesh = GPUMesh{};
+}
+
+/* Gpu resources */
+
+vk_jobs::AssetLoader::Completion vk_resources::ResourceManager::decodeTexture(uint32_t index, const std::string& sourcePath)
+{
+	auto image_data = std::make_shared<vk_io::ImageData>();
+	if (!vk_io::decodeImage(sourcePath.c_str(), *image_data)) {
+		return [this, index]() { failed(index); };
+	}
+
+	uint64_t content_hash = hashImage(*image_data);
+
+	return [this, index, sourcePath, image_data, content_hash]() {
+		finishTexture(index, sourcePath, *image_data, content_hash);
+	};
+}
+
+void vk_resources::ResourceManager::finishTexture(uint32_t index, const std::string& path, const vk_io::ImageData& imageData, uint64_t contentHash)
+{
+	if (dedupeContent(index, contentHash)) {
+		std::cout << "Loaded image: " << path << " (shared)" << std::endl;
+		return;
+	}
+
+	Slot& slot = _slots[index];
+	vk_io::createImage(_allocator, *_uploadQueue, imageData, slot._texture._image);
+	createTextureView(imageData._format, slot._texture);
+	setLoaded(index, contentHash, getAllocationSize(_allocator, slot._texture._image._allocation));
+	std::cout << "Loaded image: " << path << std::endl;
+}
+
+void vk_resources::ResourceManager::createTextureView(VkFormat format, Texture& texture)
+{
+	texture._format = format;
+
+	//Every mip level
+	VkImageViewCreateInfo create_info = vk_init::imageViewCreateInfo(texture._format, texture._image._image, VK_IMAGE_ASPECT_COLOR_BIT, VK_REMAINING_MIP_LEVELS);
+	VK_CHECK(vkCreateImageView(_device, &create_info, nullptr, &texture._view));
+}
+
+void vk_resources::ResourceManager::createMesh(const void* vertices, size_t verticesSize, const void* indices, uint32_t indexCount, VkIndexType indexType, GPUMesh& mesh)
+{
+	size_t index_size = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	size_t indices_size = index_size * indexCount;
+
+	//Vertices are always Vertex_F3_F3_F2 (cooked meshes are opened with that layout)
+	size_t vertex_count = verticesSize / sizeof(vk_primitives::mesh::Vertex_F3_F3_F2);
+	std::vector<vk_primitives::mesh::Vertex_F3> positions = vk_primitives::mesh::Vertex_F3_F3_F2::getPositions(
+		static_cast<const vk_primitives::mesh::Vertex_F3_F3_F2*>(vertices), vertex_count
+	);
+	size_t positions_size = positions.size() * sizeof(vk_primitives::mesh::Vertex_F3);
+
+	mesh._vertexBuffer = vk_util::createBuffer(_allocator, verticesSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	mesh._positionBuffer = vk_util::createBuffer(_allocator, positions_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	mesh._indexBuffer = vk_util::createBuffer(_allocator, indices_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	mesh._indexCount = indexCount;
+	mesh._indexType = indexType;
+
+	_uploadQueue->uploadBuffer(vertices, verticesSize, mesh._vertexBuffer._buffer);
+	_uploadQueue->uploadBuffer(positions.data(), positions_size, mesh._positionBuffer._buffer);
+	_uploadQueue->uploadBuffer(indices, indices_size, mesh._indexBuffer._buffer);
+}
+
+void vk_resources::ResourceManager::createMesh(const vk_primitives::mesh::Mesh& mesh, GPUMesh& gpuMesh)
+{
+	size_t vertices_size = mesh._vertices.size() * sizeof(vk_primitives::mesh::Vertex_F3_F3_F2);
+	uint32_t index_count = static_cast<uint32_t>(mesh._indices.size());
+
+	if (mesh.fitsIndices16()) {
+		std::vector<uint16_t> indices = mesh.getIndices16();
+		createMesh(mesh._vertices.data(), vertices_size, indices.data(), index_count, VK_INDEX_TYPE_UINT16, gpuMesh);
+	}
+	else {
+		createMesh(mesh._vertices.data(), vertices_size, mesh._indices.data(), index_count, VK_INDEX_TYPE_UINT32, gpuMesh);
+	}
+
+	gpuMesh._boundingRadius = mesh.getBoundingRadius();
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "vk_types.h"
+#include "vk_upload.h"
+#include "vk_jobs.h"
+#include "primitives/mesh.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+
+namespace vk_io {
+	struct ImageData;
+}
+
+namespace vk_cache {
+	class TextureFile;
+}
+
+/* Geometry */
+struct GPUMesh {
+	vk_types::AllocatedBuffer _vertexBuffer{};
+	//Positions split off the vertex buffer for depth only passes
+	vk_types::AllocatedBuffer _positionBuffer{};
+	vk_types::AllocatedBuffer _indexBuffer{};
+	uint32_t _indexCount{ 0 };
+	//uint16 when every vertex fits
+	VkIndexType _indexType{ VK_INDEX_TYPE_UINT32 };
+	//Bounding sphere around the mesh origin, used for culling instances
+	float _boundingRadius{ 0.0f };
+};
+
+namespace vk_resources {
+
+	/* Slot index + generation, a handle to a freed slot never resolves to whatever reuses the slot */
+	template<typename Tag>
+	struct Handle {
+		uint32_t _index{ UINT32_MAX };
+		uint32_t _generation{ 0 };
+
+		bool isValid() const { return _index != UINT32_MAX; }
+		bool operator==(const Handle& rhs) const { return _index == rhs._index && _generation == rhs._generation; }
+		bool operator!=(const Handle& rhs) const { return !(*this == rhs); }
+	};
+
+	using TextureHandle = Handle<struct TextureTag>;
+	using MeshHandle = Handle<struct MeshTag>;
+
+	struct Texture {
+		vk_types::AllocatedImage _image{};
+		//Every mip level
+		VkImageView _view{ VK_NULL_HANDLE };
+		VkFormat _format{ VK_FORMAT_UNDEFINED };
+	};
+
+	struct ResourceConfig {
+		//Gpu bytes kept resident before unreferenced resources are evicted, referenced ones are never evicted
+		size_t _budget{ 256ull * 1024 * 1024 };
+		//Load <name>.ktx2 instead of <name>.png when it exists
+		bool _cookedTextures{ true };
+		//Evicted resources are destroyed this many frames later, once no frame in flight can use them
+		uint32_t _framesInFlight{ 2 };
+	};
+
+	/* Owns loaded textures and meshes. Loads are deduped by path when requested and by content once loaded,
+	   so any number of references to one asset share one gpu copy. Unreferenced resources stay cached until the budget needs their memory.
+	   Everything runs on the main thread, decoding/parsing is handed to the asset loader */
+	class ResourceManager {
+	public:
+		//Loads can be queued from here on, they complete once the device exists
+		void init(const ResourceConfig& config, vk_jobs::AssetLoader* loader);
+		//Device side, has to come before the first completion runs
+		void initDevice(VkDevice device, VmaAllocator allocator, vk_upload::UploadQueue* uploadQueue, bool bcSupported);
+		//Destroys every resource, referenced or not, the gpu has to be idle
+		void destroy();
+
+		//Each call returns a new reference to the same handle for the same path
+		TextureHandle loadTexture(const std::string& path);
+		//.obj or cooked .lbxmesh
+		MeshHandle loadMesh(const std::string& path);
+		//Mesh generated in memory, name takes the place of the path for dedupe
+		MeshHandle addMesh(const std::string& name, const vk_primitives::mesh::Mesh& mesh);
+
+		void retain(TextureHandle handle);
+		void retain(MeshHandle handle);
+		//Dropping the last reference keeps the resource cached, it's only destroyed when evicted
+		void release(TextureHandle handle);
+		void release(MeshHandle handle);
+
+		//Empty (null view, 0 indices) until the load completed, or if it failed
+		const Texture& get(TextureHandle handle) const;
+		const GPUMesh& get(MeshHandle handle) const;
+
+		//Once per frame after the frame's fence: destroys evicted resources no frame can use anymore, then evicts over budget
+		void update(uint64_t frameNum);
+
+		//Gpu bytes of resident resources, shared ones counted once
+		size_t getResidentBytes() const;
+		uint32_t getResourceCount() const;
+
+	private:
+		enum class Kind : uint8_t {
+			TEXTURE,
+			MESH
+		};
+
+		enum class State : uint8_t {
+			FREE,
+			LOADING,
+			READY,
+			//Kept so repeated loads of a bad path don't retry, freed with its last reference
+			FAILED
+		};
+
+		static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+		struct Slot {
+			Kind _kind{ Kind::TEXTURE };
+			State _state{ State::FREE };
+			uint32_t _generation{ 0 };
+			uint32_t _refCount{ 0 };
+
+			std::string _path{};
+			uint64_t _pathHash{ 0 };
+			//Key in _contentLookup while this slot owns its data
+			uint64_t _contentHash{ 0 };
+			//Same content was already loaded from another path: this slot shares that slot's data and holds a reference on it
+			uint32_t _alias{ NO_SLOT };
+
+			//Gpu bytes owned (0 for aliases)
+			size_t _size{ 0 };
+			//When the last reference was dropped, least recent is evicted first
+			uint64_t _releasedFrame{ 0 };
+
+			Texture _texture{};
+			GPUMesh _mesh{};
+		};
+
+		//Evicted data waiting for the frames in flight
+		struct Retired {
+			Kind _kind;
+			Texture _texture;
+			GPUMesh _mesh;
+			uint64_t _frame;
+		};
+
+		//Existing slot for path with one more reference, or a new LOADING slot
+		uint32_t acquire(Kind kind, const std::string& path, bool& created);
+		//Shares an existing slot's data if one holds the same content, true if it did
+		bool dedupeContent(uint32_t index, uint64_t contentHash);
+		//Marks a slot READY with its own data
+		void setLoaded(uint32_t index, uint64_t contentHash, size_t size);
+		void failed(uint32_t index);
+
+		const Slot* resolve(Kind kind, uint32_t index, uint32_t generation) const;
+		void retainSlot(uint32_t index);
+		void releaseSlot(uint32_t index);
+		//Frees the slot, its data is retired unless another slot aliases it
+		void evict(uint32_t index);
+		void destroyData(Kind kind, Texture& texture, GPUMesh& mesh);
+
+		//Runs on a loader worker: decodes the source image, the completion finishes the texture
+		vk_jobs::AssetLoader::Completion decodeTexture(uint32_t index, const std::string& sourcePath);
+		//Dedupes or creates the image from decoded pixels, then marks the slot READY
+		void finishTexture(uint32_t index, const std::string& path, const vk_io::ImageData& imageData, uint64_t contentHash);
+		void createTextureView(VkFormat format, Texture& texture);
+		void createMesh(const void* vertices, size_t verticesSize, const void* indices, uint32_t indexCount, VkIndexType indexType, GPUMesh& mesh);
+		void createMesh(const vk_primitives::mesh::Mesh& mesh, GPUMesh& gpuMesh);
+
+		ResourceConfig _config{};
+		vk_jobs::AssetLoader* _loader{ nullptr };
+
+		VkDevice _device{ VK_NULL_HANDLE };
+		VmaAllocator _allocator{ VK_NULL_HANDLE };
+		vk_upload::UploadQueue* _uploadQueue{ nullptr };
+		//Written once by initDevice, read by loader workers
+		std::atomic<bool> _bcSupported{ false };
+		std::atomic<bool> _deviceReady{ false };
+
+		std::vector<Slot> _slots;
+		std::vector<uint32_t> _freeSlots;
+		std::unordered_map<uint64_t, uint32_t> _pathLookup;
+		std::unordered_map<uint64_t, uint32_t> _contentLookup;
+
+		std::deque<Retired> _retired;
+		size_t _residentBytes{ 0 };
+		uint64_t _frameNum{ 0 };
+	};
+}
@@ -0,0 +1,140 @@
+#include "vk_transforms.h"
+
+#include "math/simd.h"
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+void vk_transforms::TransformSystem::resize(uint32_t count)
+{
+	size_t padded = (static_cast<size_t>(count) + 3) & ~static_cast<size_t>(3);
+
+	_positionX.resize(padded, 0.0f);
+	_positionY.resize(padded, 0.0f);
+	_positionZ.resize(padded, 0.0f);
+
+	_rotationX.resize(padded, 0.0f);
+	_rotationY.resize(padded, 0.0f);
+	_rotationZ.resize(padded, 0.0f);
+	_rotationW.resize(padded, 1.0f);
+
+	_scaleX.resize(padded, 1.0f);
+	_scaleY.resize(padded, 1.0f);
+	_scaleZ.resize(padded, 1.0f);
+
+	_count = count;
+}
+
+uint32_t vk_transforms::TransformSystem::getCount() const
+{
+	return _count;
+}
+
+void vk_transforms::TransformSystem::set(uint32_t index, const math::Transform& transform)
+{
+	setPosition(index, transform.translation);
+	setRotation(index, transform.rotation);
+	setScale(index, transform.scale);
+}
+
+math::Transform vk_transforms::TransformSystem::get(uint32_t index) const
+{
+	assert(index < _count);
+
+	return math::Transform{
+		math::Vec3{ _positionX[index],_positionY[index],_positionZ[index] },
+		math::Quat{ _rotationX[index],_rotationY[index],_rotationZ[index],_rotationW[index] },
+		math::Vec3{ _scaleX[index],_scaleY[index],_scaleZ[index] }
+	};
+}
+
+void vk_transforms::TransformSystem::setPosition(uint32_t index, const math::Vec3& position)
+{
+	assert(index < _count);
+
+	_positionX[index] = position.x();
+	_positionY[index] = position.y();
+	_positionZ[index] = position.z();
+}
+
+void vk_transforms::TransformSystem::setRotation(uint32_t index, const math::Quat& rotation)
+{
+	assert(index < _count);
+
+	_rotationX[index] = rotation.x();
+	_rotationY[index] = rotation.y();
+	_rotationZ[index] = rotation.z();
+	_rotationW[index] = rotation.w();
+}
+
+void vk_transforms::TransformSystem::setScale(uint32_t index, const math::Vec3& scale)
+{
+	assert(index < _count);
+
+	_scaleX[index] = scale.x();
+	_scaleY[index] = scale.y();
+	_scaleZ[index] = scale.z();
+}
+
+void vk_transforms::TransformSystem::writeEntities(uint32_t begin, uint32_t end, RenderEntity* dst) const
+{
+	assert(end <= _count);
+
+	constexpr size_t stride = sizeof(RenderEntity) / sizeof(float);
+
+	//Groups of 4, SoA lanes -> AoS matrices
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		math::simd::composeTRS4(
+			&_positionX[i], &_positionY[i], &_positionZ[i],
+			&_rotationX[i], &_rotationY[i], &_rotationZ[i], &_rotationW[i],
+			&_scaleX[i], &_scaleY[i], &_scaleZ[i],
+			dst[i].model.getRawData(), dst[i].normal.getRawData(), stride
+		);
+	}
+
+	//Ragged end of the range (batches are multiples of 4, so only the last one)
+	for (; i < end; i++) {
+		math::Transform transform = get(i);
+		dst[i].model = transform.toMat4();
+		dst[i].normal = transform.normalMatrix();
+	}
+}
+
+void vk_transforms::TransformSystem::writeEntities(vk_jobs::ThreadPool& pool, RenderEntity* dst) const
+{
+	pool.parallelFor(_count, TRANSFORM_BATCH_SIZE, [this, dst](uint32_t begin, uint32_t end) {
+		writeEntities(begin, end, dst);
+	});
+}
+
+uint32_t vk_transforms::TransformSystem::cull(uint32_t begin, uint32_t end, const math::Frustum& frustum, float localRadius, uint32_t* visible) const
+{
+	assert(end <= _count);
+	//Groups of 4 read whole SoA lanes
+	assert(begin % 4 == 0);
+
+	uint32_t count = 0;
+	uint32_t i = begin;
+
+	//Padding lanes past _count may pass the test, they are masked off below
+	for (; i < end; i += 4) {
+		float radius[4];
+		for (uint32_t j = 0; j < 4; j++) {
+			float scale = std::max({ std::fabs(_scaleX[i + j]),std::fabs(_scaleY[i + j]),std::fabs(_scaleZ[i + j]) });
+			radius[j] = localRadius * scale;
+		}
+
+		int mask = math::simd::spheresInFrustum4(frustum.getRawData(), &_positionX[i], &_positionY[i], &_positionZ[i], radius);
+
+		uint32_t lanes = std::min(4u, end - i);
+		for (uint32_t j = 0; j < lanes; j++) {
+			if (mask & (1 << j)) {
+				visible[count++] = i + j;
+			}
+		}
+	}
+
+	return count;
+}
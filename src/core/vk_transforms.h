@@ -0,0 +1,67 @@
+#pragma once
+
+#include "vk_jobs.h"
+
+#include "math/vec.h"
+#include "math/matrix.h"
+#include "math/quat.h"
+#include "math/transform.h"
+#include "math/frustum.h"
+
+#include <cstdint>
+#include <vector>
+
+/* Objects (one entry of the object storage buffer read by mesh.vert) */
+struct RenderEntity {
+	math::Mat4 model;
+	//Inverse transpose of model, read by mesh.vert when AppConfig::_precomputedNormals is set
+	math::Mat4 normal;
+};
+
+namespace vk_transforms {
+
+	//Instances per job when building matrices across the pool
+	constexpr uint32_t TRANSFORM_BATCH_SIZE = 2048;
+
+	/* Position/rotation/scale of every instance in SoA arrays, model and normal matrices are built from them in bulk */
+	class TransformSystem {
+	public:
+		//New instances start at the identity transform
+		void resize(uint32_t count);
+		uint32_t getCount() const;
+
+		void set(uint32_t index, const math::Transform& transform);
+		math::Transform get(uint32_t index) const;
+
+		void setPosition(uint32_t index, const math::Vec3& position);
+		void setRotation(uint32_t index, const math::Quat& rotation);
+		void setScale(uint32_t index, const math::Vec3& scale);
+
+		//Build the matrices of instances [begin,end) into dst[begin,end), safe to call concurrently on disjoint ranges
+		void writeEntities(uint32_t begin, uint32_t end, RenderEntity* dst) const;
+
+		//Every instance, split across the pool
+		void writeEntities(vk_jobs::ThreadPool& pool, RenderEntity* dst) const;
+
+		//Frustum cull instances [begin,end) (begin a multiple of 4) as spheres around their positions (radius = localRadius * largest scale).
+		//Indices of visible instances are written compacted to visible[0..], returns how many
+		uint32_t cull(uint32_t begin, uint32_t end, const math::Frustum& frustum, float localRadius, uint32_t* visible) const;
+
+	private:
+		//Padded to a multiple of 4 so SIMD batches never read past the end
+		std::vector<float> _positionX;
+		std::vector<float> _positionY;
+		std::vector<float> _positionZ;
+
+		std::vector<float> _rotationX;
+		std::vector<float> _rotationY;
+		std::vector<float> _rotationZ;
+		std::vector<float> _rotationW;
+
+		std::vector<float> _scaleX;
+		std::vector<float> _scaleY;
+		std::vector<float> _scaleZ;
+
+		uint32_t _count{ 0 };
+	};
+}
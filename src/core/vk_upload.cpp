@@ -0,0 +1,351 @@
+#include "vk_upload.h"
+#include "vk_init.h"
+#include "vk_util.h"
+#include "vk_log.h"
+
+#include <cstring>
+#include <algorithm>
+
+void vk_upload::UploadQueue::init(VkDevice device, VmaAllocator allocator, uint32_t graphicsFamily, VkQueue graphicsQueue, uint32_t transferFamily, VkQueue transferQueue)
+{
+	_device = device;
+	_allocator = allocator;
+
+	_graphicsFamily = graphicsFamily;
+	_graphicsQueue = graphicsQueue;
+
+	_transferFamily = transferFamily;
+	_transferQueue = transferQueue;
+
+	//Command buffers are freed individually once their batch completes
+	VkCommandPoolCreateInfo pool_create_info = vk_init::commandPoolCreateInfo(_transferFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	VK_CHECK(vkCreateCommandPool(_device, &pool_create_info, nullptr, &_transferPool));
+
+	pool_create_info = vk_init::commandPoolCreateInfo(_graphicsFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	VK_CHECK(vkCreateCommandPool(_device, &pool_create_info, nullptr, &_graphicsPool));
+
+	VkSemaphoreTypeCreateInfo type_info{};
+	type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	type_info.pNext = nullptr;
+	type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	type_info.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphore_create_info = vk_init::semaphoreCreateInfo();
+	semaphore_create_info.pNext = &type_info;
+	VK_CHECK(vkCreateSemaphore(_device, &semaphore_create_info, nullptr, &_timeline));
+
+	_submittedValue = 0;
+	_recording = false;
+}
+
+void vk_upload::UploadQueue::destroy()
+{
+	//Anything recorded but never submitted still owns staging memory
+	submit();
+	wait(_submittedValue);
+	collect();
+
+	vkDestroyCommandPool(_device, _transferPool, nullptr);
+	vkDestroyCommandPool(_device, _graphicsPool, nullptr);
+	vkDestroySemaphore(_device, _timeline, nullptr);
+}
+
+void vk_upload::UploadQueue::uploadBuffer(const void* data, size_t size, VkBuffer dstBuffer, VkDeviceSize dstOffset)
+{
+	Batch& batch = getBatch();
+
+	vk_types::AllocatedBuffer staging_buffer = vk_util::createBuffer(_allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+
+	void* mem;
+	vmaMapMemory(_allocator, staging_buffer._allocation, &mem);
+	memcpy(mem, data, size);
+	vmaUnmapMemory(_allocator, staging_buffer._allocation);
+
+	batch._stagingBuffers.push_back(staging_buffer);
+
+	VkBufferCopy copy{};
+	copy.srcOffset = 0;
+	copy.dstOffset = dstOffset;
+	copy.size = size;
+	vkCmdCopyBuffer(batch._transferCmd, staging_buffer._buffer, dstBuffer, 1, &copy);
+
+	//Same queue family: the timeline wait on the render submission is enough to see the writes
+	if (!isDedicated()) {
+		return;
+	}
+
+	//Hand ownership over to the graphics family, the release half goes on the transfer queue
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.pNext = nullptr;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = _transferFamily;
+	barrier.dstQueueFamilyIndex = _graphicsFamily;
+	barrier.buffer = dstBuffer;
+	barrier.offset = dstOffset;
+	barrier.size = size;
+
+	vkCmdPipelineBarrier(batch._transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	//Acquire half is recorded at submit
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	batch._bufferAcquires.push_back(barrier);
+}
+
+void vk_upload::UploadQueue::uploadImage(const void* pixels, size_t size, VkImage image, VkExtent3D extent, const std::vector<size_t>& levelOffsets)
+{
+	Batch& batch = getBatch();
+
+	vk_types::AllocatedBuffer staging_buffer = vk_util::createBuffer(_allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+
+	void* mem;
+	vmaMapMemory(_allocator, staging_buffer._allocation, &mem);
+	memcpy(mem, pixels, size);
+	vmaUnmapMemory(_allocator, staging_buffer._allocation);
+
+	batch._stagingBuffers.push_back(staging_buffer);
+
+	recordImageCopy(batch, staging_buffer._buffer, image, extent, levelOffsets);
+}
+
+void vk_upload::UploadQueue::uploadImage(const std::vector<const void*>& levels, const std::vector<size_t>& levelSizes, VkImage image, VkExtent3D extent)
+{
+	Batch& batch = getBatch();
+
+	//16 byte aligned levels satisfy every block size and the 4 byte bufferOffset rule
+	std::vector<size_t> level_offsets(levels.size());
+	size_t size = 0;
+	for (size_t i = 0; i < levels.size(); i++) {
+		level_offsets[i] = size;
+		size = vk_util::padBufferSize(16, size + levelSizes[i]);
+	}
+
+	vk_types::AllocatedBuffer staging_buffer = vk_util::createBuffer(_allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+
+	void* mem;
+	vmaMapMemory(_allocator, staging_buffer._allocation, &mem);
+	for (size_t i = 0; i < levels.size(); i++) {
+		memcpy(static_cast<uint8_t*>(mem) + level_offsets[i], levels[i], levelSizes[i]);
+	}
+	vmaUnmapMemory(_allocator, staging_buffer._allocation);
+
+	batch._stagingBuffers.push_back(staging_buffer);
+
+	recordImageCopy(batch, staging_buffer._buffer, image, extent, level_offsets);
+}
+
+void vk_upload::UploadQueue::recordImageCopy(Batch& batch, VkBuffer stagingBuffer, VkImage image, VkExtent3D extent, const std::vector<size_t>& levelOffsets)
+{
+	VkImageSubresourceRange range;
+	range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	range.baseMipLevel = 0;
+	range.levelCount = static_cast<uint32_t>(levelOffsets.size());
+	range.baseArrayLayer = 0;
+	range.layerCount = 1;
+
+	VkImageMemoryBarrier imageBarrier_toTransfer{};
+	imageBarrier_toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarrier_toTransfer.pNext = nullptr;
+
+	imageBarrier_toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageBarrier_toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageBarrier_toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier_toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier_toTransfer.image = image;
+	imageBarrier_toTransfer.subresourceRange = range;
+
+	imageBarrier_toTransfer.srcAccessMask = 0;
+	imageBarrier_toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	//barrier the image into the transfer-receive layout
+	vkCmdPipelineBarrier(batch._transferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toTransfer);
+
+	//Copy buffer data to image, one region per mip level
+	std::vector<VkBufferImageCopy> copy_regions(levelOffsets.size());
+	for (uint32_t i = 0; i < copy_regions.size(); i++) {
+		VkBufferImageCopy& copyRegion = copy_regions[i];
+		copyRegion.bufferOffset = levelOffsets[i];
+		copyRegion.bufferRowLength = 0;
+		copyRegion.bufferImageHeight = 0;
+
+		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.imageSubresource.mipLevel = i;
+		copyRegion.imageSubresource.baseArrayLayer = 0;
+		copyRegion.imageSubresource.layerCount = 1;
+		copyRegion.imageExtent = { std::max(extent.width >> i, 1u), std::max(extent.height >> i, 1u), 1 };
+	}
+
+	vkCmdCopyBufferToImage(batch._transferCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copy_regions.size()), copy_regions.data());
+
+	//Change layout one more time
+	VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
+
+	imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	if (!isDedicated()) {
+		vkCmdPipelineBarrier(batch._transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
+		return;
+	}
+
+	//Release with the layout change on the transfer queue, the matching acquire happens on the graphics queue
+	imageBarrier_toReadable.srcQueueFamilyIndex = _transferFamily;
+	imageBarrier_toReadable.dstQueueFamilyIndex = _graphicsFamily;
+	imageBarrier_toReadable.dstAccessMask = 0;
+
+	vkCmdPipelineBarrier(batch._transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
+
+	imageBarrier_toReadable.srcAccessMask = 0;
+	imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	batch._imageAcquires.push_back(imageBarrier_toReadable);
+}
+
+uint64_t vk_upload::UploadQueue::submit()
+{
+	if (!_recording) {
+		return _submittedValue;
+	}
+
+	_recording = false;
+
+	Batch& batch = _current;
+	VK_CHECK(vkEndCommandBuffer(batch._transferCmd));
+
+	//Dedicated path signals twice: transfer done, then ownership acquired on the graphics queue
+	uint64_t transfer_value = _submittedValue + 1;
+	batch._value = isDedicated() ? transfer_value + 1 : transfer_value;
+
+	VkTimelineSemaphoreSubmitInfo timeline_info{};
+	timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_info.pNext = nullptr;
+	timeline_info.signalSemaphoreValueCount = 1;
+	timeline_info.pSignalSemaphoreValues = &transfer_value;
+
+	VkSubmitInfo submit = vk_init::submitInfo(&batch._transferCmd);
+	submit.pNext = &timeline_info;
+	submit.signalSemaphoreCount = 1;
+	submit.pSignalSemaphores = &_timeline;
+
+	VK_CHECK(vkQueueSubmit(_transferQueue, 1, &submit, VK_NULL_HANDLE));
+
+	if (isDedicated()) {
+		batch._graphicsCmd = allocateCommandBuffer(_graphicsPool);
+
+		vkCmdPipelineBarrier(batch._graphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+			0, nullptr,
+			static_cast<uint32_t>(batch._bufferAcquires.size()), batch._bufferAcquires.data(),
+			static_cast<uint32_t>(batch._imageAcquires.size()), batch._imageAcquires.data());
+
+		VK_CHECK(vkEndCommandBuffer(batch._graphicsCmd));
+
+		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkTimelineSemaphoreSubmitInfo acquire_timeline_info{};
+		acquire_timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		acquire_timeline_info.pNext = nullptr;
+		acquire_timeline_info.waitSemaphoreValueCount = 1;
+		acquire_timeline_info.pWaitSemaphoreValues = &transfer_value;
+		acquire_timeline_info.signalSemaphoreValueCount = 1;
+		acquire_timeline_info.pSignalSemaphoreValues = &batch._value;
+
+		VkSubmitInfo acquire_submit = vk_init::submitInfo(&batch._graphicsCmd);
+		acquire_submit.pNext = &acquire_timeline_info;
+		acquire_submit.waitSemaphoreCount = 1;
+		acquire_submit.pWaitSemaphores = &_timeline;
+		acquire_submit.pWaitDstStageMask = &wait_stage;
+		acquire_submit.signalSemaphoreCount = 1;
+		acquire_submit.pSignalSemaphores = &_timeline;
+
+		VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &acquire_submit, VK_NULL_HANDLE));
+	}
+
+	_submittedValue = batch._value;
+	_inFlight.push_back(std::move(batch));
+	_current = Batch{};
+
+	return _submittedValue;
+}
+
+void vk_upload::UploadQueue::collect()
+{
+	if (_inFlight.empty()) {
+		return;
+	}
+
+	uint64_t completed;
+	VK_CHECK(vkGetSemaphoreCounterValue(_device, _timeline, &completed));
+
+	while (!_inFlight.empty() && _inFlight.front()._value <= completed) {
+		Batch& batch = _inFlight.front();
+
+		for (auto& staging_buffer : batch._stagingBuffers) {
+			vmaDestroyBuffer(_allocator, staging_buffer._buffer, staging_buffer._allocation);
+		}
+
+		vkFreeCommandBuffers(_device, _transferPool, 1, &batch._transferCmd);
+		if (batch._graphicsCmd != VK_NULL_HANDLE) {
+			vkFreeCommandBuffers(_device, _graphicsPool, 1, &batch._graphicsCmd);
+		}
+
+		_inFlight.pop_front();
+	}
+}
+
+void vk_upload::UploadQueue::wait(uint64_t value)
+{
+	if (value == 0) {
+		return;
+	}
+
+	VkSemaphoreWaitInfo wait_info{};
+	wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	wait_info.pNext = nullptr;
+	wait_info.semaphoreCount = 1;
+	wait_info.pSemaphores = &_timeline;
+	wait_info.pValues = &value;
+
+	VK_CHECK(vkWaitSemaphores(_device, &wait_info, UINT64_MAX));
+}
+
+VkSemaphore vk_upload::UploadQueue::getSemaphore() const
+{
+	return _timeline;
+}
+
+uint64_t vk_upload::UploadQueue::getSubmittedValue() const
+{
+	return _submittedValue;
+}
+
+bool vk_upload::UploadQueue::isDedicated() const
+{
+	return _transferFamily != _graphicsFamily;
+}
+
+vk_upload::UploadQueue::Batch& vk_upload::UploadQueue::getBatch()
+{
+	if (!_recording) {
+		_current = Batch{};
+		_current._transferCmd = allocateCommandBuffer(_transferPool);
+		_recording = true;
+	}
+
+	return _current;
+}
+
+VkCommandBuffer vk_upload::UploadQueue::allocateCommandBuffer(VkCommandPool pool)
+{
+	VkCommandBuffer cmd;
+	VkCommandBufferAllocateInfo buffer_alloc_info = vk_init::commandBufferAllocateInfo(pool, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	VK_CHECK(vkAllocateCommandBuffers(_device, &buffer_alloc_info, &cmd));
+
+	VkCommandBufferBeginInfo begin_info = vk_init::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+	return cmd;
+}
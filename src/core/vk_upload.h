@@ -0,0 +1,86 @@
+#pragma once
+
+#include "vk_types.h"
+#include "vk_mem_alloc.h"
+
+#include <vector>
+#include <deque>
+
+namespace vk_upload {
+
+	/* Batches staging copies into a single submission, on a dedicated transfer queue when there is one.
+	   Batch completion is tracked with a timeline semaphore, staging memory is freed once the gpu is done with it */
+	class UploadQueue {
+	public:
+		void init(VkDevice device, VmaAllocator allocator, uint32_t graphicsFamily, VkQueue graphicsQueue, uint32_t transferFamily, VkQueue transferQueue);
+		void destroy();
+
+		//Data is copied into staging memory right away, the gpu copy is recorded into the current batch
+		void uploadBuffer(const void* data, size_t size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+
+		//Image ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+		//levelOffsets[i] is the byte offset of level i in pixels, rows tightly packed.
+		//For block compressed formats every offset has to be a multiple of the block size
+		void uploadImage(const void* pixels, size_t size, VkImage image, VkExtent3D extent, const std::vector<size_t>& levelOffsets = { 0 });
+
+		//Same, with level i read from levels[i] (e.g. straight out of a file mapping), levels are packed into staging here
+		void uploadImage(const std::vector<const void*>& levels, const std::vector<size_t>& levelSizes, VkImage image, VkExtent3D extent);
+
+		//Submit the current batch, returns the timeline value signaled once it's consumed
+		uint64_t submit();
+
+		//Free staging memory of completed batches, doesn't block
+		void collect();
+
+		//Block until the timeline reaches value
+		void wait(uint64_t value);
+
+		VkSemaphore getSemaphore() const;
+
+		//Timeline value of the last submitted batch, rendering waits on this
+		uint64_t getSubmittedValue() const;
+
+		bool isDedicated() const;
+
+	private:
+		struct Batch {
+			VkCommandBuffer _transferCmd{ VK_NULL_HANDLE };
+			//Queue family ownership acquire, only used with a dedicated transfer queue
+			VkCommandBuffer _graphicsCmd{ VK_NULL_HANDLE };
+
+			std::vector<vk_types::AllocatedBuffer> _stagingBuffers;
+			std::vector<VkBufferMemoryBarrier> _bufferAcquires;
+			std::vector<VkImageMemoryBarrier> _imageAcquires;
+
+			uint64_t _value{ 0 };
+		};
+
+		Batch& getBatch();
+
+		//Layout transitions + one copy region per level out of stagingBuffer
+		void recordImageCopy(Batch& batch, VkBuffer stagingBuffer, VkImage image, VkExtent3D extent, const std::vector<size_t>& levelOffsets);
+
+		VkCommandBuffer allocateCommandBuffer(VkCommandPool pool);
+
+		VkDevice _device;
+		VmaAllocator _allocator;
+
+		uint32_t _graphicsFamily;
+		VkQueue _graphicsQueue;
+		VkCommandPool _graphicsPool;
+
+		uint32_t _transferFamily;
+		VkQueue _transferQueue;
+		VkCommandPool _transferPool;
+
+		VkSemaphore _timeline;
+		uint64_t _submittedValue{ 0 };
+
+		//Batch being recorded
+		Batch _current{};
+		bool _recording{ false };
+
+		//Submitted, waiting on the timeline
+		std::deque<Batch> _inFlight;
+	};
+}
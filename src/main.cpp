@@ -1,15 +1,22 @@
 #include "core/vk_app.h"
+#include "core/vk_args.h"
 
 
-int main(){
+int main(int argc, char** argv){
+
+	AppConfig config{};
+
+	if (!vk_args::parseAppArgs(argc, argv, config)) {
+		return 1;
+	}
 
 	VkApp app{};
 
-	app.init();
+	app.init(config);
 
 	app.run();
 
 	app.cleanup();
 
 	return 0;
-}
\ No newline at end of file
+}
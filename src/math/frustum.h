@@ -0,0 +1,77 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "math/vec.h"
+#include "math/matrix.h"
+#include "math/scalar.h"
+
+
+namespace math {
+
+	/*Frustum*/
+
+	/*Six planes (a,b,c,d) with unit normals pointing inside, a point p is inside a plane when dot(n,p) + d >= 0*/
+
+	template<typename T>
+	class TFrustum {
+	public:
+		enum Plane {
+			PLANE_LEFT,
+			PLANE_RIGHT,
+			PLANE_BOTTOM,
+			PLANE_TOP,
+			PLANE_NEAR,
+			PLANE_FAR,
+			PLANE_COUNT
+		};
+
+		constexpr TFrustum() {}
+
+		//Gribb/Hartmann plane extraction from proj * view, clip space depth in [0,1] (Vulkan)
+		static constexpr TFrustum fromMatrix(const TMat4<T>& m)
+		{
+			auto row = [&m](int i) { return TVec4<T>{ m[0][i],m[1][i],m[2][i],m[3][i] }; };
+			TVec4<T> r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+			TFrustum f{};
+			f.planes[PLANE_LEFT] = normalizePlane(r3 + r0);
+			f.planes[PLANE_RIGHT] = normalizePlane(r3 - r0);
+			f.planes[PLANE_BOTTOM] = normalizePlane(r3 + r1);
+			f.planes[PLANE_TOP] = normalizePlane(r3 - r1);
+			f.planes[PLANE_NEAR] = normalizePlane(r2);
+			f.planes[PLANE_FAR] = normalizePlane(r3 - r2);
+			return f;
+		}
+
+		constexpr TVec4<T> operator[](size_t index) const { assert(index < PLANE_COUNT); return planes[index]; }
+
+		//Conservative: spheres crossing a corner outside two planes still pass
+		constexpr bool intersectsSphere(const TVec3<T>& center, T radius) const
+		{
+			for (int i = 0; i < PLANE_COUNT; i++) {
+				const TVec4<T>& p = planes[i];
+				if (p[0] * center.x() + p[1] * center.y() + p[2] * center.z() + p[3] < -radius) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/*Planes as 6 * (a,b,c,d) floats for the simd kernels*/
+		const T* getRawData() const { return planes[0].getRawData(); }
+
+	private:
+		static constexpr TVec4<T> normalizePlane(const TVec4<T>& p)
+		{
+			T length = scalar::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+			return TVec4<T>{ p[0] / length,p[1] / length,p[2] / length,p[3] / length };
+		}
+
+		TVec4<T> planes[PLANE_COUNT];
+	};
+
+	using Frustum = TFrustum<float>;
+
+}
+
+#endif
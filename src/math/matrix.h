@@ -2,8 +2,12 @@
 #define MATRIX_H
 
 #include <iostream>
+#include <cassert>
+#include <type_traits>
 
 #include "math/vec.h"
+#include "math/scalar.h"
+#include "math/simd.h"
 
 
 namespace math {
@@ -12,77 +16,411 @@ namespace math {
 
 	/*Note: data[i][j] is the (j,i) entry of the matrix due to column-major order*/
 
-	class Mat4 {
+	template<typename T>
+	class TMat4 {
 	public:
-		Mat4(
-			float m11 = 1.0, float m12 = 0.0, float m13 = 0.0, float m14 = 0.0,
-			float m21 = 0.0, float m22 = 1.0, float m23 = 0.0, float m24 = 0.0,
-			float m31 = 0.0, float m32 = 0.0, float m33 = 1.0, float m34 = 0.0,
-			float m41 = 0.0, float m42 = 0.0, float m43 = 0.0, float m44 = 1.0
-		);
-
-		Mat4(
-			const Vec4& c0,
-			const Vec4& c1,
-			const Vec4& c2,
-			const Vec4& c3
-		);
+		using Vec = TVec4<T>;
+
+		constexpr TMat4(
+			T m11 = T(1), T m12 = T(0), T m13 = T(0), T m14 = T(0),
+			T m21 = T(0), T m22 = T(1), T m23 = T(0), T m24 = T(0),
+			T m31 = T(0), T m32 = T(0), T m33 = T(1), T m34 = T(0),
+			T m41 = T(0), T m42 = T(0), T m43 = T(0), T m44 = T(1)
+		) :
+			cols{
+				Vec{m11,m12,m13,m14},
+				Vec{m21,m22,m23,m24},
+				Vec{m31,m32,m33,m34},
+				Vec{m41,m42,m43,m44}
+			}
+		{
+		}
+
+		constexpr TMat4(
+			const Vec& c0,
+			const Vec& c1,
+			const Vec& c2,
+			const Vec& c3
+		) :
+			cols{ c0,c1,c2,c3 }
+		{
+		}
 
 		/*Matrix element read/write access*/
-		Vec4 operator[](size_t index) const;
-		Vec4& operator[](size_t index);
+		constexpr Vec operator[](size_t index) const { assert(index < 4); return cols[index]; }
+		constexpr Vec& operator[](size_t index) { assert(index < 4); return cols[index]; }
 
 		/*Matrix algebra*/
-		Mat4 operator+(const Mat4& rhs) const;
-		Mat4 operator-(const Mat4& rhs) const;
-		Vec4 operator*(const Vec4& rhs) const;
-		Mat4 operator*(const Mat4& rhs) const;
-		Mat4 operator*(const float rhs) const;
-		Mat4 transpose() const;
+		constexpr TMat4 operator+(const TMat4& rhs) const
+		{
+			return TMat4{ cols[0] + rhs.cols[0],cols[1] + rhs.cols[1],cols[2] + rhs.cols[2],cols[3] + rhs.cols[3] };
+		}
+
+		constexpr TMat4 operator-(const TMat4& rhs) const
+		{
+			return TMat4{ cols[0] - rhs.cols[0],cols[1] - rhs.cols[1],cols[2] - rhs.cols[2],cols[3] - rhs.cols[3] };
+		}
+
+		constexpr Vec operator*(const Vec& rhs) const
+		{
+			if constexpr (std::is_same_v<T, float>) {
+				if (!LIGHTBX_IS_CONSTANT_EVALUATED()) {
+					Vec v{};
+					simd::mat4MulVec4(getRawData(), rhs.getRawData(), v.getRawData());
+					return v;
+				}
+			}
+			return cols[0] * rhs[0] + cols[1] * rhs[1] + cols[2] * rhs[2] + cols[3] * rhs[3];
+		}
+
+		constexpr TMat4 operator*(const TMat4& rhs) const
+		{
+			if constexpr (std::is_same_v<T, float>) {
+				if (!LIGHTBX_IS_CONSTANT_EVALUATED()) {
+					TMat4 m{};
+					simd::mat4Mul(getRawData(), rhs.getRawData(), m.getRawData());
+					return m;
+				}
+			}
+			return TMat4{ (*this) * rhs.cols[0],(*this) * rhs.cols[1],(*this) * rhs.cols[2],(*this) * rhs.cols[3] };
+		}
+
+		constexpr TMat4 operator*(const T rhs) const
+		{
+			return TMat4{ cols[0] * rhs,cols[1] * rhs,cols[2] * rhs,cols[3] * rhs };
+		}
+
+		constexpr TMat4 transpose() const
+		{
+			if constexpr (std::is_same_v<T, float>) {
+				if (!LIGHTBX_IS_CONSTANT_EVALUATED()) {
+					TMat4 m{};
+					simd::mat4Transpose(getRawData(), m.getRawData());
+					return m;
+				}
+			}
+			TMat4 m{};
+			for (int i = 0; i < 4; i++) {
+				for (int j = 0; j < 4; j++) {
+					m.cols[i][j] = cols[j][i];
+				}
+			}
+			return m;
+		}
+
+		constexpr T determinant() const
+		{
+			auto a = [this](int r, int c) { return cols[c][r]; };
+
+			T s0 = a(0, 0) * a(1, 1) - a(0, 1) * a(1, 0);
+			T s1 = a(0, 0) * a(1, 2) - a(0, 2) * a(1, 0);
+			T s2 = a(0, 0) * a(1, 3) - a(0, 3) * a(1, 0);
+			T s3 = a(0, 1) * a(1, 2) - a(0, 2) * a(1, 1);
+			T s4 = a(0, 1) * a(1, 3) - a(0, 3) * a(1, 1);
+			T s5 = a(0, 2) * a(1, 3) - a(0, 3) * a(1, 2);
+
+			T c0 = a(2, 0) * a(3, 1) - a(2, 1) * a(3, 0);
+			T c1 = a(2, 0) * a(3, 2) - a(2, 2) * a(3, 0);
+			T c2 = a(2, 0) * a(3, 3) - a(2, 3) * a(3, 0);
+			T c3 = a(2, 1) * a(3, 2) - a(2, 2) * a(3, 1);
+			T c4 = a(2, 1) * a(3, 3) - a(2, 3) * a(3, 1);
+			T c5 = a(2, 2) * a(3, 3) - a(2, 3) * a(3, 2);
 
+			return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+		}
 
-		/*Get raw data location for sending to GPU*/
-		float* getRawData();
+		//General inverse from 2x2 sub-determinants, singular matrices give the identity
+		constexpr TMat4 inverse() const
+		{
+			auto a = [this](int r, int c) { return cols[c][r]; };
+
+			T s0 = a(0, 0) * a(1, 1) - a(0, 1) * a(1, 0);
+			T s1 = a(0, 0) * a(1, 2) - a(0, 2) * a(1, 0);
+			T s2 = a(0, 0) * a(1, 3) - a(0, 3) * a(1, 0);
+			T s3 = a(0, 1) * a(1, 2) - a(0, 2) * a(1, 1);
+			T s4 = a(0, 1) * a(1, 3) - a(0, 3) * a(1, 1);
+			T s5 = a(0, 2) * a(1, 3) - a(0, 3) * a(1, 2);
+
+			T c0 = a(2, 0) * a(3, 1) - a(2, 1) * a(3, 0);
+			T c1 = a(2, 0) * a(3, 2) - a(2, 2) * a(3, 0);
+			T c2 = a(2, 0) * a(3, 3) - a(2, 3) * a(3, 0);
+			T c3 = a(2, 1) * a(3, 2) - a(2, 2) * a(3, 1);
+			T c4 = a(2, 1) * a(3, 3) - a(2, 3) * a(3, 1);
+			T c5 = a(2, 2) * a(3, 3) - a(2, 3) * a(3, 2);
+
+			T det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+			if (det == T(0)) {
+				return TMat4{};
+			}
+			T invDet = T(1) / det;
+
+			//Columns of the inverse
+			return TMat4{
+				Vec{
+					( a(1, 1) * c5 - a(1, 2) * c4 + a(1, 3) * c3) * invDet,
+					(-a(1, 0) * c5 + a(1, 2) * c2 - a(1, 3) * c1) * invDet,
+					( a(1, 0) * c4 - a(1, 1) * c2 + a(1, 3) * c0) * invDet,
+					(-a(1, 0) * c3 + a(1, 1) * c1 - a(1, 2) * c0) * invDet
+				},
+				Vec{
+					(-a(0, 1) * c5 + a(0, 2) * c4 - a(0, 3) * c3) * invDet,
+					( a(0, 0) * c5 - a(0, 2) * c2 + a(0, 3) * c1) * invDet,
+					(-a(0, 0) * c4 + a(0, 1) * c2 - a(0, 3) * c0) * invDet,
+					( a(0, 0) * c3 - a(0, 1) * c1 + a(0, 2) * c0) * invDet
+				},
+				Vec{
+					( a(3, 1) * s5 - a(3, 2) * s4 + a(3, 3) * s3) * invDet,
+					(-a(3, 0) * s5 + a(3, 2) * s2 - a(3, 3) * s1) * invDet,
+					( a(3, 0) * s4 - a(3, 1) * s2 + a(3, 3) * s0) * invDet,
+					(-a(3, 0) * s3 + a(3, 1) * s1 - a(3, 2) * s0) * invDet
+				},
+				Vec{
+					(-a(2, 1) * s5 + a(2, 2) * s4 - a(2, 3) * s3) * invDet,
+					( a(2, 0) * s5 - a(2, 2) * s2 + a(2, 3) * s1) * invDet,
+					(-a(2, 0) * s4 + a(2, 1) * s2 - a(2, 3) * s0) * invDet,
+					( a(2, 0) * s3 - a(2, 1) * s1 + a(2, 2) * s0) * invDet
+				}
+			};
+		}
+
+		//Inverse of a model matrix (bottom row 0 0 0 1): invert the 3x3 part, then the translation
+		constexpr TMat4 affineInverse() const
+		{
+			TMat4 m = linearInverse();
+			TVec3<T> t{ cols[3][0],cols[3][1],cols[3][2] };
+			m.cols[3] = Vec{
+				-(m.cols[0][0] * t[0] + m.cols[1][0] * t[1] + m.cols[2][0] * t[2]),
+				-(m.cols[0][1] * t[0] + m.cols[1][1] * t[1] + m.cols[2][1] * t[2]),
+				-(m.cols[0][2] * t[0] + m.cols[1][2] * t[1] + m.cols[2][2] * t[2]),
+				T(1)
+			};
+			return m;
+		}
+
+		//Inverse transpose of the 3x3 part, padded to a Mat4 so it matches a std140/std430 mat4 (or mat3 columns)
+		constexpr TMat4 normalMatrix() const
+		{
+			TMat4 m = linearInverse();
+			TMat4 n{};
+			for (int i = 0; i < 3; i++) {
+				for (int j = 0; j < 3; j++) {
+					n.cols[i][j] = m.cols[j][i];
+				}
+			}
+			return n;
+		}
+
+		/*Get raw data location for sending to GPU (columns are contiguous)*/
+		T* getRawData() { return cols[0].getRawData(); }
+		const T* getRawData() const { return cols[0].getRawData(); }
 
 		/*Static methods for generating common matrices*/
-		static Mat4 identity();
-		static Mat4 lookAt(const Vec3& eye,const Vec3& center,const Vec3& up);
-		
+		static constexpr TMat4 identity() { return TMat4{}; }
+
+		static constexpr TMat4 lookAt(const TVec3<T>& eye, const TVec3<T>& center, const TVec3<T>& up)
+		{
+			auto front = (center - eye).normalize();
+			auto right = front.cross(up).normalize();
+			auto newUp = right.cross(front).normalize();
+
+			TMat4 m{};
+			m[0] = Vec{ right.x(),newUp.x(),-front.x(),T(0) };
+			m[1] = Vec{ right.y(),newUp.y(),-front.y(),T(0) };
+			m[2] = Vec{ right.z(),newUp.z(),-front.z(),T(0) };
+			m[3] = Vec{ -eye.dot(right),-eye.dot(newUp),eye.dot(front) };
+			return m;
+		}
+
 		//Scale
-		static Mat4 fromScale(const Vec3& v);
-		static Mat4 fromScale(float x, float y, float z);
+		static constexpr TMat4 fromScale(const TVec3<T>& v) { return fromScale(v.x(), v.y(), v.z()); }
+		static constexpr TMat4 fromScale(T x, T y, T z)
+		{
+			return TMat4{
+				Vec{x,T(0),T(0),T(0)},
+				Vec{T(0),y,T(0),T(0)},
+				Vec{T(0),T(0),z,T(0)},
+				Vec{T(0),T(0),T(0),T(1)}
+			};
+		}
 
 		//Rotation
-		static Mat4 fromRotateXAxis(float angle);
-		static Mat4 fromRotateYAxis(float angle);
-		static Mat4 fromRotateZAxis(float angle);
-		static Mat4 fromAxisAngle(float angle, const Vec3& axis);
-		//TODO: rotation from quaternion
+		static constexpr TMat4 fromRotateXAxis(T angle)
+		{
+			T c = scalar::cos(angle);
+			T s = scalar::sin(angle);
+
+			return TMat4{
+				Vec{T(1),T(0),T(0),T(0)},
+				Vec{T(0),c,s,T(0)},
+				Vec{T(0),-s,c,T(0)},
+				Vec{T(0),T(0),T(0),T(1)}
+			};
+		}
+
+		static constexpr TMat4 fromRotateYAxis(T angle)
+		{
+			T c = scalar::cos(angle);
+			T s = scalar::sin(angle);
+
+			return TMat4{
+				Vec{c,T(0),-s,T(0)},
+				Vec{T(0),T(1),T(0),T(0)},
+				Vec{s,T(0),c,T(0)},
+				Vec{T(0),T(0),T(0),T(1)}
+			};
+		}
+
+		static constexpr TMat4 fromRotateZAxis(T angle)
+		{
+			T c = scalar::cos(angle);
+			T s = scalar::sin(angle);
+
+			return TMat4{
+				Vec{c,s,T(0),T(0)},
+				Vec{-s,c,T(0),T(0)},
+				Vec{T(0),T(0),T(1),T(0)},
+				Vec{T(0),T(0),T(0),T(1)}
+			};
+		}
+
+		//Rodrigues' rotation formula, axis must be unit length
+		static constexpr TMat4 fromAxisAngle(T angle, const TVec3<T>& axis)
+		{
+			T c = scalar::cos(angle);
+			T s = scalar::sin(angle);
+			T k = T(1) - c;
+			T x = axis.x(), y = axis.y(), z = axis.z();
+
+			return TMat4{
+				Vec{c + x * x * k, y * x * k + z * s, z * x * k - y * s, T(0)},
+				Vec{x * y * k - z * s, c + y * y * k, z * y * k + x * s, T(0)},
+				Vec{x * z * k + y * s, y * z * k - x * s, c + z * z * k, T(0)},
+				Vec{T(0),T(0),T(0),T(1)}
+			};
+		}
+		//From a quaternion: TQuat::toMat4 (quat.h)
 
 		//Translation
-		static Mat4 fromTranslation(const Vec3& v);
-		static Mat4 fromTranslation(float x, float y, float z);
+		static constexpr TMat4 fromTranslation(const TVec3<T>& v) { return fromTranslation(v.x(), v.y(), v.z()); }
+		static constexpr TMat4 fromTranslation(T x, T y, T z)
+		{
+			return TMat4{
+				Vec{T(1),T(0),T(0),T(0)},
+				Vec{T(0),T(1),T(0),T(0)},
+				Vec{T(0),T(0),T(1),T(0)},
+				Vec{x,y,z,T(1)}
+			};
+		}
 
 		//Projection matrices
-		static Mat4 orthographicProjection(float left, float right, float bottom, float top, float near, float far);
-		static Mat4 orthographicProjectionVk(float left, float right, float bottom, float top, float near, float far);
+		static constexpr TMat4 orthographicProjection(T left, T right, T bottom, T top, T near, T far)
+		{
+			TMat4 m{};
+			m[0][0] = T(2) / (right - left);
+			m[1][1] = T(2) / (top - bottom);
+			m[2][2] = T(-2) / (far - near);
+			m[3][0] = -(right + left) / (right - left);
+			m[3][1] = -(top + bottom) / (top - bottom);
+			m[3][2] = -(far + near) / (far - near);
+			return m;
+		}
+
+		static constexpr TMat4 orthographicProjectionVk(T left, T right, T bottom, T top, T near, T far)
+		{
+			TMat4 m{};
+			m[0][0] = T(2) / (right - left);
+			m[1][1] = T(-2) / (bottom - top);
+			m[2][2] = T(-1) / (far - near);
+			m[3][0] = -(right + left) / (right - left);
+			m[3][1] = -(top + bottom) / (bottom - top);
+			m[3][2] = -near / (far - near);
+			return m;
+		}
 
 
-		static Mat4 perspectiveProjection(float fovy, float aspectRatio, float near, float far);
-		static Mat4 perspectiveProjectionVk(float fovy, float aspectRatio, float near, float far);
+		static constexpr TMat4 perspectiveProjection(T fovy, T aspectRatio, T near, T far)
+		{
+			TMat4 m{};
+			T ty = scalar::tan(fovy * T(0.5));
+			T tx = ty * aspectRatio;
+			m[0][0] = T(1) / tx;
+			m[1][1] = T(1) / ty;
+			m[2][2] = -(far + near) / (far - near);
+			m[3][2] = -T(2) * far * near / (far - near);
+			m[2][3] = T(-1);
+			m[3][3] = T(0);
+
+			return m;
+		}
+
+		static constexpr TMat4 perspectiveProjectionVk(T fovy, T aspectRatio, T near, T far)
+		{
+			TMat4 m{};
+			T ty = scalar::tan(fovy * T(0.5));
+			T tx = ty * aspectRatio;
+			m[0][0] = T(1) / tx;
+			m[1][1] = T(-1) / ty;
+			m[2][2] = -far / (far - near);
+			m[3][2] = -far * near / (far - near);
+			m[2][3] = T(-1);
+			m[3][3] = T(0);
+
+			return m;
+		}
 
 
 
 	private:
-		union {
-			Vec4 cols[4] = {};
-			float data[16];
-		};
+		//Inverse of the upper 3x3 block by cofactors, rest is identity
+		constexpr TMat4 linearInverse() const
+		{
+			auto a = [this](int r, int c) { return cols[c][r]; };
+
+			T c00 = a(1, 1) * a(2, 2) - a(1, 2) * a(2, 1);
+			T c01 = a(1, 2) * a(2, 0) - a(1, 0) * a(2, 2);
+			T c02 = a(1, 0) * a(2, 1) - a(1, 1) * a(2, 0);
+
+			T det = a(0, 0) * c00 + a(0, 1) * c01 + a(0, 2) * c02;
+			if (det == T(0)) {
+				return TMat4{};
+			}
+			T invDet = T(1) / det;
+
+			return TMat4{
+				Vec{ c00 * invDet, c01 * invDet, c02 * invDet, T(0) },
+				Vec{
+					(a(0, 2) * a(2, 1) - a(0, 1) * a(2, 2)) * invDet,
+					(a(0, 0) * a(2, 2) - a(0, 2) * a(2, 0)) * invDet,
+					(a(0, 1) * a(2, 0) - a(0, 0) * a(2, 1)) * invDet,
+					T(0)
+				},
+				Vec{
+					(a(0, 1) * a(1, 2) - a(0, 2) * a(1, 1)) * invDet,
+					(a(0, 2) * a(1, 0) - a(0, 0) * a(1, 2)) * invDet,
+					(a(0, 0) * a(1, 1) - a(0, 1) * a(1, 0)) * invDet,
+					T(0)
+				},
+				Vec{ T(0),T(0),T(0),T(1) }
+			};
+		}
+
+		Vec cols[4];
 
 	};
 
-	std::ostream& operator<<(std::ostream& out, const Mat4& v);
+	template<typename T>
+	std::ostream& operator<<(std::ostream& out, const TMat4<T>& v)
+	{
+		out << "| " << v[0][0] << " " << v[1][0] << " " << v[2][0] << " " << v[3][0] << " |\n";
+		out << "| " << v[0][1] << " " << v[1][1] << " " << v[2][1] << " " << v[3][1] << " |\n";
+		out << "| " << v[0][2] << " " << v[1][2] << " " << v[2][2] << " " << v[3][2] << " |\n";
+		out << "| " << v[0][3] << " " << v[1][3] << " " << v[2][3] << " " << v[3][3] << " |\n";
+
+		return out;
+	}
+
+	using Mat4 = TMat4<float>;
 
 }
 
-#endif
\ No newline at end of file
+#endif
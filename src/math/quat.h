@@ -1,6 +1,159 @@
 #ifndef QUAT_H
 #define QUAT_H
 
+#include <iostream>
+#include <cmath>
 
+#include "math/vec.h"
+#include "math/matrix.h"
+#include "math/scalar.h"
 
-#endif
\ No newline at end of file
+
+namespace math {
+
+	/*Quat*/
+
+	/*Note: stored as (x,y,z,w) with w the scalar part, rotations assume unit length*/
+
+	template<typename T>
+	class TQuat {
+	public:
+		constexpr TQuat(T x = T(0), T y = T(0), T z = T(0), T w = T(1)) : data{ x,y,z,w } {}
+
+		/*Member access*/
+		constexpr T x() const { return data[0]; }
+		constexpr T y() const { return data[1]; }
+		constexpr T z() const { return data[2]; }
+		constexpr T w() const { return data[3]; }
+		constexpr TVec3<T> xyz() const { return TVec3<T>{ data[0],data[1],data[2] }; }
+		constexpr T operator[](size_t index) const { assert(index < 4); return data[index]; }
+		constexpr T& operator[](size_t index) { assert(index < 4); return data[index]; }
+
+		/*Algebra*/
+		constexpr TQuat operator+(const TQuat& rhs) const { return TQuat{ data[0] + rhs.data[0],data[1] + rhs.data[1],data[2] + rhs.data[2],data[3] + rhs.data[3] }; }
+		constexpr TQuat operator-(const TQuat& rhs) const { return TQuat{ data[0] - rhs.data[0],data[1] - rhs.data[1],data[2] - rhs.data[2],data[3] - rhs.data[3] }; }
+		constexpr TQuat operator*(T rhs) const { return TQuat{ data[0] * rhs,data[1] * rhs,data[2] * rhs,data[3] * rhs }; }
+		constexpr TQuat operator-() const { return TQuat{ -data[0],-data[1],-data[2],-data[3] }; }
+		constexpr bool operator==(const TQuat& rhs) const { return data[0] == rhs.data[0] && data[1] == rhs.data[1] && data[2] == rhs.data[2] && data[3] == rhs.data[3]; }
+
+		//Composition: (a * b) rotates by b first, then by a (same order as Mat4)
+		constexpr TQuat operator*(const TQuat& rhs) const
+		{
+			return TQuat{
+				data[3] * rhs.data[0] + data[0] * rhs.data[3] + data[1] * rhs.data[2] - data[2] * rhs.data[1],
+				data[3] * rhs.data[1] - data[0] * rhs.data[2] + data[1] * rhs.data[3] + data[2] * rhs.data[0],
+				data[3] * rhs.data[2] + data[0] * rhs.data[1] - data[1] * rhs.data[0] + data[2] * rhs.data[3],
+				data[3] * rhs.data[3] - data[0] * rhs.data[0] - data[1] * rhs.data[1] - data[2] * rhs.data[2]
+			};
+		}
+		constexpr TQuat& operator*=(const TQuat& rhs) { return *this = *this * rhs; }
+
+		constexpr T dot(const TQuat& rhs) const { return data[0] * rhs.data[0] + data[1] * rhs.data[1] + data[2] * rhs.data[2] + data[3] * rhs.data[3]; }
+		constexpr T norm2() const { return dot(*this); }
+		constexpr T norm() const { return scalar::sqrt(norm2()); }
+		constexpr TQuat normalize() const { return *this * (T(1) / norm()); }
+		constexpr TQuat conjugate() const { return TQuat{ -data[0],-data[1],-data[2],data[3] }; }
+		constexpr TQuat inverse() const { return conjugate() * (T(1) / norm2()); }
+
+		//Rotate a vector by a unit quaternion, v' = v + 2w(u x v) + 2u x (u x v)
+		constexpr TVec3<T> rotate(const TVec3<T>& v) const
+		{
+			TVec3<T> u = xyz();
+			TVec3<T> t = u.cross(v) * T(2);
+			return v + t * data[3] + u.cross(t);
+		}
+
+		//Rotation matrix of a unit quaternion
+		constexpr TMat4<T> toMat4() const
+		{
+			T xx = data[0] * data[0], yy = data[1] * data[1], zz = data[2] * data[2];
+			T xy = data[0] * data[1], xz = data[0] * data[2], yz = data[1] * data[2];
+			T wx = data[3] * data[0], wy = data[3] * data[1], wz = data[3] * data[2];
+
+			return TMat4<T>{
+				TVec4<T>{T(1) - T(2) * (yy + zz), T(2) * (xy + wz), T(2) * (xz - wy), T(0)},
+				TVec4<T>{T(2) * (xy - wz), T(1) - T(2) * (xx + zz), T(2) * (yz + wx), T(0)},
+				TVec4<T>{T(2) * (xz + wy), T(2) * (yz - wx), T(1) - T(2) * (xx + yy), T(0)},
+				TVec4<T>{T(0), T(0), T(0), T(1)}
+			};
+		}
+
+		/*Static methods for generating common rotations*/
+		static constexpr TQuat identity() { return TQuat{}; }
+
+		//Axis must be unit length
+		static constexpr TQuat fromAxisAngle(T angle, const TVec3<T>& axis)
+		{
+			T s = scalar::sin(angle * T(0.5));
+			return TQuat{ axis.x() * s,axis.y() * s,axis.z() * s,scalar::cos(angle * T(0.5)) };
+		}
+
+		//Rotation part of a matrix without scale (Shepperd's method, branch on the largest diagonal term)
+		static constexpr TQuat fromMat4(const TMat4<T>& m)
+		{
+			T trace = m[0][0] + m[1][1] + m[2][2];
+
+			if (trace > T(0)) {
+				T s = scalar::sqrt(trace + T(1)) * T(2);
+				return TQuat{ (m[1][2] - m[2][1]) / s,(m[2][0] - m[0][2]) / s,(m[0][1] - m[1][0]) / s,s * T(0.25) };
+			}
+			if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+				T s = scalar::sqrt(T(1) + m[0][0] - m[1][1] - m[2][2]) * T(2);
+				return TQuat{ s * T(0.25),(m[1][0] + m[0][1]) / s,(m[2][0] + m[0][2]) / s,(m[1][2] - m[2][1]) / s };
+			}
+			if (m[1][1] > m[2][2]) {
+				T s = scalar::sqrt(T(1) + m[1][1] - m[0][0] - m[2][2]) * T(2);
+				return TQuat{ (m[1][0] + m[0][1]) / s,s * T(0.25),(m[2][1] + m[1][2]) / s,(m[2][0] - m[0][2]) / s };
+			}
+			T s = scalar::sqrt(T(1) + m[2][2] - m[0][0] - m[1][1]) * T(2);
+			return TQuat{ (m[2][0] + m[0][2]) / s,(m[2][1] + m[1][2]) / s,s * T(0.25),(m[0][1] - m[1][0]) / s };
+		}
+
+	private:
+		T data[4];
+	};
+
+	/*Interpolation, both take the shortest arc*/
+
+	//Normalized linear interpolation, cheap and fine for small steps (not constant speed)
+	template<typename T>
+	constexpr TQuat<T> nlerp(const TQuat<T>& a, const TQuat<T>& b, T t)
+	{
+		TQuat<T> end = a.dot(b) < T(0) ? -b : b;
+		return (a * (T(1) - t) + end * t).normalize();
+	}
+
+	//Spherical linear interpolation, constant angular speed
+	template<typename T>
+	TQuat<T> slerp(const TQuat<T>& a, const TQuat<T>& b, T t)
+	{
+		T cosTheta = a.dot(b);
+		TQuat<T> end = b;
+		if (cosTheta < T(0)) {
+			cosTheta = -cosTheta;
+			end = -b;
+		}
+
+		//Nearly parallel: sin(theta) goes to 0, nlerp is indistinguishable
+		if (cosTheta > T(1) - T(NEARLY_ZERO)) {
+			return nlerp(a, end, t);
+		}
+
+		T theta = std::acos(cosTheta);
+		T sinTheta = std::sin(theta);
+		T wa = std::sin((T(1) - t) * theta) / sinTheta;
+		T wb = std::sin(t * theta) / sinTheta;
+		return a * wa + end * wb;
+	}
+
+	template<typename T>
+	std::ostream& operator<<(std::ostream& out, const TQuat<T>& q)
+	{
+		return out << "[" << q.x() << "," << q.y() << "," << q.z() << "," << q.w() << "]\n";
+	}
+
+	using Quat = TQuat<float>;
+
+}
+
+#endif
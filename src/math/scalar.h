@@ -0,0 +1,106 @@
+#ifndef SCALAR_H
+#define SCALAR_H
+
+#include <cmath>
+
+/* Lets constexpr functions pick a compile time path, runtime code keeps using libm/simd */
+#if defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1925)
+#define LIGHTBX_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#else
+//Unknown compiler: always take the constexpr path, still correct just slower
+#define LIGHTBX_IS_CONSTANT_EVALUATED() true
+#endif
+
+namespace math {
+
+	namespace scalar {
+
+		constexpr double PI_D = 3.14159265358979323846;
+
+		/* Compile time versions, only used during constant evaluation */
+
+		constexpr double constexprSqrt(double x)
+		{
+			if (!(x > 0.0)) {
+				return x == 0.0 ? 0.0 : NAN;
+			}
+
+			//Newton iteration from a guess within a factor of 2
+			double guess = x > 1.0 ? x : 1.0;
+			for (int i = 0; i < 64; i++) {
+				double next = 0.5 * (guess + x / guess);
+				if (next == guess) {
+					break;
+				}
+				guess = next;
+			}
+			return guess;
+		}
+
+		//Reduce to [-pi,pi], then Taylor series
+		constexpr double constexprSin(double x)
+		{
+			double k = static_cast<double>(static_cast<long long>(x / (2.0 * PI_D)));
+			x -= k * 2.0 * PI_D;
+			if (x > PI_D) {
+				x -= 2.0 * PI_D;
+			}
+			else if (x < -PI_D) {
+				x += 2.0 * PI_D;
+			}
+
+			double term = x;
+			double sum = x;
+			for (int n = 1; n < 20; n++) {
+				term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+				sum += term;
+			}
+			return sum;
+		}
+
+		constexpr double constexprCos(double x)
+		{
+			return constexprSin(x + 0.5 * PI_D);
+		}
+
+		/* Dispatch */
+
+		template<typename T>
+		constexpr T sqrt(T x)
+		{
+			if (LIGHTBX_IS_CONSTANT_EVALUATED()) {
+				return static_cast<T>(constexprSqrt(x));
+			}
+			return std::sqrt(x);
+		}
+
+		template<typename T>
+		constexpr T sin(T x)
+		{
+			if (LIGHTBX_IS_CONSTANT_EVALUATED()) {
+				return static_cast<T>(constexprSin(x));
+			}
+			return std::sin(x);
+		}
+
+		template<typename T>
+		constexpr T cos(T x)
+		{
+			if (LIGHTBX_IS_CONSTANT_EVALUATED()) {
+				return static_cast<T>(constexprCos(x));
+			}
+			return std::cos(x);
+		}
+
+		template<typename T>
+		constexpr T tan(T x)
+		{
+			if (LIGHTBX_IS_CONSTANT_EVALUATED()) {
+				return static_cast<T>(constexprSin(x) / constexprCos(x));
+			}
+			return std::tan(x);
+		}
+	}
+}
+
+#endif
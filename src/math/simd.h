@@ -0,0 +1,292 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/* Vec4/Mat4 kernels on raw floats (column-major, 16 floats per matrix).
+   SSE is used on x86 unless LIGHTBX_NO_SIMD is defined, AVX/FMA when the compiler targets them.
+   Loads/stores are unaligned so any float storage works */
+
+#if !defined(LIGHTBX_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define LIGHTBX_SIMD_SSE 1
+#include <immintrin.h>
+#if defined(__AVX__)
+#define LIGHTBX_SIMD_AVX 1
+#endif
+#if defined(__FMA__)
+#define LIGHTBX_SIMD_FMA 1
+#endif
+#endif
+
+#include <cmath>
+#include <cstddef>
+
+namespace math {
+
+	namespace simd {
+
+#ifdef LIGHTBX_SIMD_SSE
+		inline __m128 madd(__m128 a, __m128 b, __m128 c)
+		{
+#ifdef LIGHTBX_SIMD_FMA
+			return _mm_fmadd_ps(a, b, c);
+#else
+			return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+		}
+
+		//Dot product in every lane
+		inline __m128 dot4(__m128 a, __m128 b)
+		{
+			__m128 m = _mm_mul_ps(a, b);
+			m = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+			return _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+		}
+
+		//Linear combination of a's columns weighted by v
+		inline __m128 mulColumns(const float* a, __m128 v)
+		{
+			__m128 r = _mm_mul_ps(_mm_loadu_ps(a), _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+			r = madd(_mm_loadu_ps(a + 4), _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), r);
+			r = madd(_mm_loadu_ps(a + 8), _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), r);
+			return madd(_mm_loadu_ps(a + 12), _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), r);
+		}
+#endif
+
+		inline float vec4Dot(const float* a, const float* b)
+		{
+#ifdef LIGHTBX_SIMD_SSE
+			return _mm_cvtss_f32(dot4(_mm_loadu_ps(a), _mm_loadu_ps(b)));
+#else
+			return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+#endif
+		}
+
+		inline void vec4Normalize(const float* v, float* out)
+		{
+#ifdef LIGHTBX_SIMD_SSE
+			__m128 x = _mm_loadu_ps(v);
+			_mm_storeu_ps(out, _mm_div_ps(x, _mm_sqrt_ps(dot4(x, x))));
+#else
+			float norm = std::sqrt(vec4Dot(v, v));
+			for (int i = 0; i < 4; i++) {
+				out[i] = v[i] / norm;
+			}
+#endif
+		}
+
+		//out = m * v, out may alias v
+		inline void mat4MulVec4(const float* m, const float* v, float* out)
+		{
+#ifdef LIGHTBX_SIMD_SSE
+			_mm_storeu_ps(out, mulColumns(m, _mm_loadu_ps(v)));
+#else
+			float r[4];
+			for (int i = 0; i < 4; i++) {
+				r[i] = m[i] * v[0] + m[4 + i] * v[1] + m[8 + i] * v[2] + m[12 + i] * v[3];
+			}
+			for (int i = 0; i < 4; i++) {
+				out[i] = r[i];
+			}
+#endif
+		}
+
+		//out = a * b, out may alias a or b
+		inline void mat4Mul(const float* a, const float* b, float* out)
+		{
+#if defined(LIGHTBX_SIMD_AVX)
+			//Two result columns per 256 bit register: lanes hold columns j and j+1
+			__m256 a0 = _mm256_broadcast_ps((const __m128*)(a));
+			__m256 a1 = _mm256_broadcast_ps((const __m128*)(a + 4));
+			__m256 a2 = _mm256_broadcast_ps((const __m128*)(a + 8));
+			__m256 a3 = _mm256_broadcast_ps((const __m128*)(a + 12));
+
+			__m256 b01 = _mm256_loadu_ps(b);
+			__m256 b23 = _mm256_loadu_ps(b + 8);
+
+			__m256 r01 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(0, 0, 0, 0)));
+			__m256 r23 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(0, 0, 0, 0)));
+#ifdef LIGHTBX_SIMD_FMA
+			r01 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(1, 1, 1, 1)), r01);
+			r23 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(1, 1, 1, 1)), r23);
+			r01 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(2, 2, 2, 2)), r01);
+			r23 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(2, 2, 2, 2)), r23);
+			r01 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(3, 3, 3, 3)), r01);
+			r23 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(3, 3, 3, 3)), r23);
+#else
+			r01 = _mm256_add_ps(r01, _mm256_mul_ps(a1, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(1, 1, 1, 1))));
+			r23 = _mm256_add_ps(r23, _mm256_mul_ps(a1, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(1, 1, 1, 1))));
+			r01 = _mm256_add_ps(r01, _mm256_mul_ps(a2, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(2, 2, 2, 2))));
+			r23 = _mm256_add_ps(r23, _mm256_mul_ps(a2, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(2, 2, 2, 2))));
+			r01 = _mm256_add_ps(r01, _mm256_mul_ps(a3, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(3, 3, 3, 3))));
+			r23 = _mm256_add_ps(r23, _mm256_mul_ps(a3, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(3, 3, 3, 3))));
+#endif
+			_mm256_storeu_ps(out, r01);
+			_mm256_storeu_ps(out + 8, r23);
+#elif defined(LIGHTBX_SIMD_SSE)
+			__m128 r0 = mulColumns(a, _mm_loadu_ps(b));
+			__m128 r1 = mulColumns(a, _mm_loadu_ps(b + 4));
+			__m128 r2 = mulColumns(a, _mm_loadu_ps(b + 8));
+			__m128 r3 = mulColumns(a, _mm_loadu_ps(b + 12));
+			_mm_storeu_ps(out, r0);
+			_mm_storeu_ps(out + 4, r1);
+			_mm_storeu_ps(out + 8, r2);
+			_mm_storeu_ps(out + 12, r3);
+#else
+			float r[16];
+			for (int j = 0; j < 4; j++) {
+				mat4MulVec4(a, b + 4 * j, r + 4 * j);
+			}
+			for (int i = 0; i < 16; i++) {
+				out[i] = r[i];
+			}
+#endif
+		}
+
+		//out may alias m
+		inline void mat4Transpose(const float* m, float* out)
+		{
+#ifdef LIGHTBX_SIMD_SSE
+			__m128 c0 = _mm_loadu_ps(m);
+			__m128 c1 = _mm_loadu_ps(m + 4);
+			__m128 c2 = _mm_loadu_ps(m + 8);
+			__m128 c3 = _mm_loadu_ps(m + 12);
+			_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+			_mm_storeu_ps(out, c0);
+			_mm_storeu_ps(out + 4, c1);
+			_mm_storeu_ps(out + 8, c2);
+			_mm_storeu_ps(out + 12, c3);
+#else
+			float r[16];
+			for (int i = 0; i < 4; i++) {
+				for (int j = 0; j < 4; j++) {
+					r[4 * i + j] = m[4 * j + i];
+				}
+			}
+			for (int i = 0; i < 16; i++) {
+				out[i] = r[i];
+			}
+#endif
+		}
+
+		//Model (T * R * S) and normal (R * S^-1) matrices for 4 instances stored as SoA (each input pointer reads 4 floats).
+		//Instance i's model goes to model + i * stride, its normal to normal + i * stride (skipped if normal is null)
+		inline void composeTRS4(
+			const float* tx, const float* ty, const float* tz,
+			const float* qx, const float* qy, const float* qz, const float* qw,
+			const float* sx, const float* sy, const float* sz,
+			float* model, float* normal, size_t stride)
+		{
+#ifdef LIGHTBX_SIMD_SSE
+			//Lanes are instances
+			__m128 x = _mm_loadu_ps(qx), y = _mm_loadu_ps(qy), z = _mm_loadu_ps(qz), w = _mm_loadu_ps(qw);
+			__m128 one = _mm_set1_ps(1.0f);
+			__m128 two = _mm_set1_ps(2.0f);
+			__m128 zero = _mm_setzero_ps();
+
+			__m128 x2 = _mm_mul_ps(x, two), y2 = _mm_mul_ps(y, two), z2 = _mm_mul_ps(z, two);
+			__m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+			__m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+			__m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+			//Rotation columns
+			__m128 r[3][3] = {
+				{ _mm_sub_ps(one, _mm_add_ps(yy, zz)), _mm_add_ps(xy, wz), _mm_sub_ps(xz, wy) },
+				{ _mm_sub_ps(xy, wz), _mm_sub_ps(one, _mm_add_ps(xx, zz)), _mm_add_ps(yz, wx) },
+				{ _mm_add_ps(xz, wy), _mm_sub_ps(yz, wx), _mm_sub_ps(one, _mm_add_ps(xx, yy)) }
+			};
+			__m128 s[3] = { _mm_loadu_ps(sx), _mm_loadu_ps(sy), _mm_loadu_ps(sz) };
+
+			//Transpose (x,y,z,w) lane registers into one column per instance
+			auto storeColumn = [stride](float* dst, int col, __m128 c0, __m128 c1, __m128 c2, __m128 c3) {
+				_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+				_mm_storeu_ps(dst + 4 * col, c0);
+				_mm_storeu_ps(dst + stride + 4 * col, c1);
+				_mm_storeu_ps(dst + 2 * stride + 4 * col, c2);
+				_mm_storeu_ps(dst + 3 * stride + 4 * col, c3);
+			};
+
+			for (int col = 0; col < 3; col++) {
+				storeColumn(model, col, _mm_mul_ps(r[col][0], s[col]), _mm_mul_ps(r[col][1], s[col]), _mm_mul_ps(r[col][2], s[col]), zero);
+			}
+			storeColumn(model, 3, _mm_loadu_ps(tx), _mm_loadu_ps(ty), _mm_loadu_ps(tz), one);
+
+			if (normal) {
+				for (int col = 0; col < 3; col++) {
+					__m128 inv = _mm_div_ps(one, s[col]);
+					storeColumn(normal, col, _mm_mul_ps(r[col][0], inv), _mm_mul_ps(r[col][1], inv), _mm_mul_ps(r[col][2], inv), zero);
+				}
+				storeColumn(normal, 3, zero, zero, zero, one);
+			}
+#else
+			for (int i = 0; i < 4; i++) {
+				float x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+				float r[3][3] = {
+					{ 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y) },
+					{ 2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x) },
+					{ 2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y) }
+				};
+				float s[3] = { sx[i], sy[i], sz[i] };
+
+				float* m = model + i * stride;
+				for (int col = 0; col < 3; col++) {
+					m[4 * col] = r[col][0] * s[col];
+					m[4 * col + 1] = r[col][1] * s[col];
+					m[4 * col + 2] = r[col][2] * s[col];
+					m[4 * col + 3] = 0.0f;
+				}
+				m[12] = tx[i];
+				m[13] = ty[i];
+				m[14] = tz[i];
+				m[15] = 1.0f;
+
+				if (normal) {
+					float* n = normal + i * stride;
+					for (int col = 0; col < 3; col++) {
+						n[4 * col] = r[col][0] / s[col];
+						n[4 * col + 1] = r[col][1] / s[col];
+						n[4 * col + 2] = r[col][2] / s[col];
+						n[4 * col + 3] = 0.0f;
+					}
+					n[12] = 0.0f;
+					n[13] = 0.0f;
+					n[14] = 0.0f;
+					n[15] = 1.0f;
+				}
+			}
+#endif
+		}
+
+		//Frustum test for 4 spheres stored as SoA, planes are 6 * (a,b,c,d) with inward normals.
+		//Bit i of the result is set when sphere i is at least partly inside
+		inline int spheresInFrustum4(const float* planes, const float* x, const float* y, const float* z, const float* radius)
+		{
+#ifdef LIGHTBX_SIMD_SSE
+			__m128 px = _mm_loadu_ps(x), py = _mm_loadu_ps(y), pz = _mm_loadu_ps(z);
+			__m128 r = _mm_loadu_ps(radius);
+			__m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int i = 0; i < 6; i++) {
+				const float* p = planes + 4 * i;
+				__m128 d = madd(_mm_set1_ps(p[0]), px, _mm_set1_ps(p[3]));
+				d = madd(_mm_set1_ps(p[1]), py, d);
+				d = madd(_mm_set1_ps(p[2]), pz, d);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+			}
+			return _mm_movemask_ps(inside);
+#else
+			int mask = 0;
+			for (int j = 0; j < 4; j++) {
+				bool inside = true;
+				for (int i = 0; i < 6 && inside; i++) {
+					const float* p = planes + 4 * i;
+					inside = p[0] * x[j] + p[1] * y[j] + p[2] * z[j] + p[3] >= -radius[j];
+				}
+				mask |= inside ? (1 << j) : 0;
+			}
+			return mask;
+#endif
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "math/vec.h"
+#include "math/matrix.h"
+#include "math/quat.h"
+
+
+namespace math {
+
+	/*Transform*/
+
+	/*Translation, rotation, scale (applied scale first), 40 bytes instead of a 64 byte Mat4*/
+
+	template<typename T>
+	struct TTransform {
+		TVec3<T> translation{};
+		TQuat<T> rotation{};
+		TVec3<T> scale{ T(1),T(1),T(1) };
+
+		//Apply to a point
+		constexpr TVec3<T> apply(const TVec3<T>& p) const
+		{
+			return rotation.rotate(TVec3<T>{ p.x() * scale.x(),p.y() * scale.y(),p.z() * scale.z() }) + translation;
+		}
+
+		//T * R * S without the matrix products
+		constexpr TMat4<T> toMat4() const
+		{
+			TMat4<T> m = rotation.toMat4();
+			m[0] = m[0] * scale.x();
+			m[1] = m[1] * scale.y();
+			m[2] = m[2] * scale.z();
+			m[0][3] = T(0);
+			m[1][3] = T(0);
+			m[2][3] = T(0);
+			m[3] = TVec4<T>{ translation.x(),translation.y(),translation.z(),T(1) };
+			return m;
+		}
+
+		//Inverse transpose of toMat4(), rotation with inverted scale
+		constexpr TMat4<T> normalMatrix() const
+		{
+			TTransform n{ TVec3<T>{},rotation,TVec3<T>{ T(1) / scale.x(),T(1) / scale.y(),T(1) / scale.z() } };
+			return n.toMat4();
+		}
+
+		//Exact only for uniform scale (non uniform scale under rotation is not a TRS)
+		constexpr TTransform operator*(const TTransform& rhs) const
+		{
+			return TTransform{
+				apply(rhs.translation),
+				rotation * rhs.rotation,
+				TVec3<T>{ scale.x() * rhs.scale.x(),scale.y() * rhs.scale.y(),scale.z() * rhs.scale.z() }
+			};
+		}
+
+		static constexpr TTransform identity() { return TTransform{}; }
+
+		//Renormalize the rotation after many compositions
+		constexpr TTransform& orthonormalize() { rotation = rotation.normalize(); return *this; }
+	};
+
+	using Transform = TTransform<float>;
+
+}
+
+#endif
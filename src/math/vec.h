@@ -2,162 +2,201 @@
 #define VEC_H
 
 #include <iostream>
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+#include "math/scalar.h"
+#include "math/simd.h"
 
 namespace math {
 
-	const float NEARLY_ZERO = 0.00001f;
+	constexpr float NEARLY_ZERO = 0.00001f;
 
 	/*Vec2*/
 
-	class Vec2 {
+	template<typename T>
+	class TVec2 {
 	public:
-		Vec2(float x = 0.0, float y = 0.0);
+		constexpr TVec2(T x = T(0), T y = T(0)) : data{ x,y } {}
 
 		/*Member access*/
-		float x() const;
-		float y() const;
-		float r() const;
-		float g() const;
-		float operator[](size_t index) const;
-		float& operator[](size_t index);
+		constexpr T x() const { return data[0]; }
+		constexpr T y() const { return data[1]; }
+		constexpr T r() const { return data[0]; }
+		constexpr T g() const { return data[1]; }
+		constexpr T operator[](size_t index) const { assert(index < 2); return data[index]; }
+		constexpr T& operator[](size_t index) { assert(index < 2); return data[index]; }
 
 
 		/*Vector space operations*/
-		Vec2 operator+(const Vec2& rhs) const;
-		Vec2 operator+=(const Vec2& rhs);
-		Vec2 operator-(const Vec2& rhs) const;
-		Vec2 operator-=(const Vec2& rhs);
-		Vec2 operator*(float rhs) const;
-		Vec2 operator*=(float rhs);
-		Vec2 operator/(float rhs) const;
-		Vec2 operator/=(float rhs);
-		bool operator==(const Vec2& rhs) const;
-		Vec2 operator-() const;
+		constexpr TVec2 operator+(const TVec2& rhs) const { return TVec2{ data[0] + rhs.data[0],data[1] + rhs.data[1] }; }
+		constexpr TVec2& operator+=(const TVec2& rhs) { return *this = *this + rhs; }
+		constexpr TVec2 operator-(const TVec2& rhs) const { return TVec2{ data[0] - rhs.data[0],data[1] - rhs.data[1] }; }
+		constexpr TVec2& operator-=(const TVec2& rhs) { return *this = *this - rhs; }
+		constexpr TVec2 operator*(T rhs) const { return TVec2{ data[0] * rhs,data[1] * rhs }; }
+		constexpr TVec2& operator*=(T rhs) { return *this = *this * rhs; }
+		constexpr TVec2 operator/(T rhs) const { return TVec2{ data[0] / rhs,data[1] / rhs }; }
+		constexpr TVec2& operator/=(T rhs) { return *this = *this / rhs; }
+		constexpr bool operator==(const TVec2& rhs) const { return data[0] == rhs.data[0] && data[1] == rhs.data[1]; }
+		constexpr TVec2 operator-() const { return TVec2{ -data[0],-data[1] }; }
 
 		/*Get raw data location for sending to GPU*/
-		float* getRawData();
+		constexpr T* getRawData() { return data; }
+		constexpr const T* getRawData() const { return data; }
 
 		/*Inner product and cross product*/
-		float dot(const Vec2& rhs) const;
-		float norm2() const;
-		float norm() const;
-		Vec2 normalize() const;
+		constexpr T dot(const TVec2& rhs) const { return data[0] * rhs.data[0] + data[1] * rhs.data[1]; }
+		constexpr T norm2() const { return dot(*this); }
+		constexpr T norm() const { return scalar::sqrt(norm2()); }
+		constexpr TVec2 normalize() const { return *this / norm(); }
 
 
 	private:
-		union {
-			struct {
-				float mX, mY;
-			};
-			float data[2] = {};
-		};
+		T data[2];
 	};
 
-	std::ostream& operator<<(std::ostream& out, const Vec2& v);
+	template<typename T>
+	std::ostream& operator<<(std::ostream& out, const TVec2<T>& v)
+	{
+		return out << "[" << v.x() << "," << v.y() << "]\n";
+	}
 
 
 	/*Vec3*/
 
-	class Vec3 {
+	template<typename T>
+	class TVec3 {
 	public:
-		Vec3(float x = 0.0, float y = 0.0, float z = 0.0);
+		constexpr TVec3(T x = T(0), T y = T(0), T z = T(0)) : data{ x,y,z } {}
 
 		/*Member access*/
-		float x() const;
-		float y() const;
-		float z() const;
-		float r() const;
-		float g() const;
-		float b() const;
-		float operator[](size_t index) const;
-		float& operator[](size_t index);
+		constexpr T x() const { return data[0]; }
+		constexpr T y() const { return data[1]; }
+		constexpr T z() const { return data[2]; }
+		constexpr T r() const { return data[0]; }
+		constexpr T g() const { return data[1]; }
+		constexpr T b() const { return data[2]; }
+		constexpr T operator[](size_t index) const { assert(index < 3); return data[index]; }
+		constexpr T& operator[](size_t index) { assert(index < 3); return data[index]; }
 
 
 		/*Vector space operations*/
-		Vec3 operator+(const Vec3& rhs) const;
-		Vec3 operator+=(const Vec3& rhs);
-		Vec3 operator-(const Vec3& rhs) const;
-		Vec3 operator-=(const Vec3& rhs);
-		Vec3 operator*(float rhs) const;
-		Vec3 operator*=(float rhs);
-		Vec3 operator/(float rhs) const;
-		Vec3 operator/=(float rhs);
-		bool operator==(const Vec3& rhs) const;
-		Vec3 operator-() const;
+		constexpr TVec3 operator+(const TVec3& rhs) const { return TVec3{ data[0] + rhs.data[0],data[1] + rhs.data[1],data[2] + rhs.data[2] }; }
+		constexpr TVec3& operator+=(const TVec3& rhs) { return *this = *this + rhs; }
+		constexpr TVec3 operator-(const TVec3& rhs) const { return TVec3{ data[0] - rhs.data[0],data[1] - rhs.data[1],data[2] - rhs.data[2] }; }
+		constexpr TVec3& operator-=(const TVec3& rhs) { return *this = *this - rhs; }
+		constexpr TVec3 operator*(T rhs) const { return TVec3{ data[0] * rhs,data[1] * rhs,data[2] * rhs }; }
+		constexpr TVec3& operator*=(T rhs) { return *this = *this * rhs; }
+		constexpr TVec3 operator/(T rhs) const { return TVec3{ data[0] / rhs,data[1] / rhs,data[2] / rhs }; }
+		constexpr TVec3& operator/=(T rhs) { return *this = *this / rhs; }
+		constexpr bool operator==(const TVec3& rhs) const { return data[0] == rhs.data[0] && data[1] == rhs.data[1] && data[2] == rhs.data[2]; }
+		constexpr TVec3 operator-() const { return TVec3{ -data[0],-data[1],-data[2] }; }
 
 		/*Get raw data location for sending to GPU*/
-		float* getRawData();
+		constexpr T* getRawData() { return data; }
+		constexpr const T* getRawData() const { return data; }
 
 		/*Inner product and cross product*/
-		float dot(const Vec3& rhs) const;
-		Vec3 cross(const Vec3& rhs) const;
-		float norm2() const;
-		float norm() const;
-		Vec3 normalize() const;
+		constexpr T dot(const TVec3& rhs) const { return data[0] * rhs.data[0] + data[1] * rhs.data[1] + data[2] * rhs.data[2]; }
+		constexpr TVec3 cross(const TVec3& rhs) const
+		{
+			return TVec3{
+				data[1] * rhs.data[2] - data[2] * rhs.data[1],
+				data[2] * rhs.data[0] - data[0] * rhs.data[2],
+				data[0] * rhs.data[1] - data[1] * rhs.data[0]
+			};
+		}
+		constexpr T norm2() const { return dot(*this); }
+		constexpr T norm() const { return scalar::sqrt(norm2()); }
+		constexpr TVec3 normalize() const { return *this / norm(); }
 
 
 	private:
-		union {
-			struct {
-				float mX, mY, mZ;
-			};
-			float data[3] = {};
-		};
+		T data[3];
 	};
 
-	std::ostream& operator<<(std::ostream& out, const Vec3& v);
+	template<typename T>
+	std::ostream& operator<<(std::ostream& out, const TVec3<T>& v)
+	{
+		return out << "[" << v.x() << "," << v.y() << "," << v.z() << "]\n";
+	}
 
 	/*Vec4*/
 
-	class Vec4 {
+	template<typename T>
+	class TVec4 {
 	public:
-		Vec4(float x = 0.0, float y = 0.0, float z = 0.0,float w = 1.0);
+		constexpr TVec4(T x = T(0), T y = T(0), T z = T(0), T w = T(1)) : data{ x,y,z,w } {}
 
 		/*Member access*/
-		float x() const;
-		float y() const;
-		float z() const;
-		float w() const;
-		float r() const;
-		float g() const;
-		float b() const;
-		float a() const;
-		float operator[](size_t index) const;
-		float& operator[](size_t index);
+		constexpr T x() const { return data[0]; }
+		constexpr T y() const { return data[1]; }
+		constexpr T z() const { return data[2]; }
+		constexpr T w() const { return data[3]; }
+		constexpr T r() const { return data[0]; }
+		constexpr T g() const { return data[1]; }
+		constexpr T b() const { return data[2]; }
+		constexpr T a() const { return data[3]; }
+		constexpr T operator[](size_t index) const { assert(index < 4); return data[index]; }
+		constexpr T& operator[](size_t index) { assert(index < 4); return data[index]; }
 
 
 		/*Vector space operations*/
-		Vec4 operator+(const Vec4& rhs) const;
-		void operator+=(const Vec4& rhs);
-		Vec4 operator-(const Vec4& rhs) const;
-		void operator-=(const Vec4& rhs);
-		Vec4 operator*(float rhs) const;
-		void operator*=(float rhs);
-		Vec4 operator/(float rhs) const;
-		void operator/=(float rhs);
-		bool operator==(const Vec4& rhs) const;
-		Vec4 operator-() const;
+		constexpr TVec4 operator+(const TVec4& rhs) const { return TVec4{ data[0] + rhs.data[0],data[1] + rhs.data[1],data[2] + rhs.data[2],data[3] + rhs.data[3] }; }
+		constexpr TVec4& operator+=(const TVec4& rhs) { return *this = *this + rhs; }
+		constexpr TVec4 operator-(const TVec4& rhs) const { return TVec4{ data[0] - rhs.data[0],data[1] - rhs.data[1],data[2] - rhs.data[2],data[3] - rhs.data[3] }; }
+		constexpr TVec4& operator-=(const TVec4& rhs) { return *this = *this - rhs; }
+		constexpr TVec4 operator*(T rhs) const { return TVec4{ data[0] * rhs,data[1] * rhs,data[2] * rhs,data[3] * rhs }; }
+		constexpr TVec4& operator*=(T rhs) { return *this = *this * rhs; }
+		constexpr TVec4 operator/(T rhs) const { return TVec4{ data[0] / rhs,data[1] / rhs,data[2] / rhs,data[3] / rhs }; }
+		constexpr TVec4& operator/=(T rhs) { return *this = *this / rhs; }
+		constexpr bool operator==(const TVec4& rhs) const { return data[0] == rhs.data[0] && data[1] == rhs.data[1] && data[2] == rhs.data[2] && data[3] == rhs.data[3]; }
+		constexpr TVec4 operator-() const { return TVec4{ -data[0],-data[1],-data[2],-data[3] }; }
 
 		/*Get raw data location for sending to GPU*/
-		float* getRawData();
+		constexpr T* getRawData() { return data; }
+		constexpr const T* getRawData() const { return data; }
 
 		/*Inner product and cross product*/
-		float dot(const Vec4& rhs) const;
-		float norm2() const;
-		float norm() const;
-		Vec4 normalize() const;
+		constexpr T dot(const TVec4& rhs) const
+		{
+			//Simd kernels at runtime, plain arithmetic during constant evaluation
+			if constexpr (std::is_same_v<T, float>) {
+				if (!LIGHTBX_IS_CONSTANT_EVALUATED()) {
+					return simd::vec4Dot(data, rhs.data);
+				}
+			}
+			return data[0] * rhs.data[0] + data[1] * rhs.data[1] + data[2] * rhs.data[2] + data[3] * rhs.data[3];
+		}
+		constexpr T norm2() const { return dot(*this); }
+		constexpr T norm() const { return scalar::sqrt(norm2()); }
+		constexpr TVec4 normalize() const
+		{
+			if constexpr (std::is_same_v<T, float>) {
+				if (!LIGHTBX_IS_CONSTANT_EVALUATED()) {
+					TVec4 v{};
+					simd::vec4Normalize(data, v.data);
+					return v;
+				}
+			}
+			return *this / norm();
+		}
 
 
 	private:
-		union {
-			struct {
-				float mX, mY, mZ,mW;
-			};
-			float data[4] = {};
-		};
+		T data[4];
 	};
 
-	std::ostream& operator<<(std::ostream& out, const Vec4& v);
+	template<typename T>
+	std::ostream& operator<<(std::ostream& out, const TVec4<T>& v)
+	{
+		return out << "[" << v.x() << "," << v.y() << "," << v.z() << "," << v.w() << "]\n";
+	}
+
+	using Vec2 = TVec2<float>;
+	using Vec3 = TVec3<float>;
+	using Vec4 = TVec4<float>;
 
 	/*Color3,Color4*/
 	using Color3 = Vec3;
@@ -167,4 +206,4 @@ namespace math {
 
 
 
-#endif
\ No newline at end of file
+#endif
@@ -70,12 +70,15 @@ void vk_primitives::camera::FlyCamera::reset(math::Vec3& center, double radius)
     mUp = math::Vec3(0.0, 1.0, 0.0);
     mForward = math::Vec3(0.0, 0.0, -1.0);
     mRight = math::Vec3(1.0, 0.0, 0.0);
+    recomputeFrame();
 }
 
 math::Mat4 vk_primitives::camera::FlyCamera::getViewMatrix() const
 {
-    math::Vec3 center = mEye + mForward;
-    return math::Mat4::lookAt(mEye, center, mUp);
+    //Inverse of translate(eye) * rotate(orientation)
+    math::Mat4 view = mOrientation.conjugate().toMat4();
+    view[3] = view * math::Vec4(-mEye.x(), -mEye.y(), -mEye.z(), 1.0);
+    return view;
 }
 
 math::Vec3 vk_primitives::camera::FlyCamera::getEye() const {
@@ -84,13 +87,14 @@ math::Vec3 vk_primitives::camera::FlyCamera::getEye() const {
 
 
 void vk_primitives::camera::FlyCamera::recomputeFrame() {
-    float sp = sin(mPhi);
-    float cp = cos(mPhi);
-    float st = sin(mTheta);
-    float ct = cos(mTheta);
-    mForward = math::Vec3(sp * ct, cp, -sp * st);
-
-    mRight = mForward.cross(mUp).normalize();
+    //theta = phi = pi/2 looks down -z
+    math::Quat yaw = math::Quat::fromAxisAngle(mTheta - static_cast<float>(0.5 * M_PI), math::Vec3(0.0, 1.0, 0.0));
+    math::Quat pitch = math::Quat::fromAxisAngle(static_cast<float>(0.5 * M_PI) - mPhi, math::Vec3(1.0, 0.0, 0.0));
+    mOrientation = (yaw * pitch).normalize();
+
+    mForward = mOrientation.rotate(math::Vec3(0.0, 0.0, -1.0));
+    mRight = mOrientation.rotate(math::Vec3(1.0, 0.0, 0.0));
+    mUp = mOrientation.rotate(math::Vec3(0.0, 1.0, 0.0));
 }
 
 
@@ -2,6 +2,7 @@
 
 #include "math/vec.h"
 #include "math/matrix.h"
+#include "math/quat.h"
 
 namespace vk_primitives{
 
@@ -67,6 +68,8 @@ namespace vk_primitives{
 
             void recomputeFrame() override;
 
+            //Yaw (theta) about world up, then pitch (phi) about the camera right axis
+            math::Quat mOrientation;
         };
 
         class ArcCamera : public Camera {
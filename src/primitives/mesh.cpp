@@ -1,5 +1,33 @@
 #include "mesh.h"
 
+#include <algorithm>
+#include <cmath>
+
+vk_primitives::mesh::VertexInputDescription vk_primitives::mesh::Vertex_F3::getVertexInputDescription()
+{
+	VertexInputDescription description{};
+
+	/* Bindings */
+	VkVertexInputBindingDescription binding0{};
+	binding0.binding = 0;
+	binding0.stride = sizeof(Vertex_F3);
+	binding0.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	description._bindingDescriptions.emplace_back(binding0);
+
+	/* Attributes */
+
+	VkVertexInputAttributeDescription position{};
+	position.binding = 0;
+	position.location = 0;
+	position.format = VK_FORMAT_R32G32B32_SFLOAT;
+	position.offset = offsetof(Vertex_F3, position);
+
+	description._attributeDescriptions.emplace_back(position);
+
+	return description;
+}
+
 vk_primitives::mesh::VertexInputDescription vk_primitives::mesh::Vertex_F3_F3::getVertexInputDescription()
 {
 	VertexInputDescription description{};
@@ -71,3 +99,31 @@ vk_primitives::mesh::VertexInputDescription vk_primitives::mesh::Vertex_F3_F3_F2
 
 	return description;;
 }
+
+std::vector<vk_primitives::mesh::Vertex_F3> vk_primitives::mesh::Vertex_F3_F3_F2::getPositions(const Vertex_F3_F3_F2* vertices, size_t count)
+{
+	std::vector<Vertex_F3> positions(count);
+	for (size_t i = 0; i < count; i++) {
+		positions[i].position = vertices[i].position;
+	}
+	return positions;
+}
+
+bool vk_primitives::mesh::Mesh::fitsIndices16() const
+{
+	return _vertices.size() <= static_cast<size_t>(UINT16_MAX) + 1;
+}
+
+std::vector<uint16_t> vk_primitives::mesh::Mesh::getIndices16() const
+{
+	return std::vector<uint16_t>(_indices.begin(), _indices.end());
+}
+
+float vk_primitives::mesh::Mesh::getBoundingRadius() const
+{
+	float radius2 = 0.0f;
+	for (const auto& vertex : _vertices) {
+		radius2 = std::max(radius2, vertex.position.norm2());
+	}
+	return std::sqrt(radius2);
+}
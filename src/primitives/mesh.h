@@ -14,6 +14,13 @@ namespace vk_primitives {
 			std::vector<VkVertexInputAttributeDescription> _attributeDescriptions;
 		};
 
+		//Position only stream for depth passes
+		struct Vertex_F3 {
+			math::Vec3 position;
+
+			static VertexInputDescription getVertexInputDescription();
+		};
+
 		struct Vertex_F3_F3 {
 			math::Vec3 position;
 			math::Vec3 color;
@@ -27,6 +34,22 @@ namespace vk_primitives {
 			math::Vec2 texCoords;
 
 			static VertexInputDescription getVertexInputDescription();
+
+			//Positions split off into their own tightly packed stream (12 instead of 32 bytes per vertex)
+			static std::vector<Vertex_F3> getPositions(const Vertex_F3_F3_F2* vertices, size_t count);
+		};
+
+		//Indexed triangle list
+		struct Mesh {
+			std::vector<Vertex_F3_F3_F2> _vertices;
+			std::vector<uint32_t> _indices;
+
+			//Every vertex can be addressed with 16 bit indices
+			bool fitsIndices16() const;
+			std::vector<uint16_t> getIndices16() const;
+
+			//Radius of the bounding sphere centered at the mesh origin
+			float getBoundingRadius() const;
 		};
 
 	}
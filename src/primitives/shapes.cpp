@@ -104,3 +104,27 @@ std::vector<uint32_t> vk_primitives::shapes::Cube::getIndexData()
 		4,1,0,4,5,1
 	};
 }
+
+vk_primitives::mesh::Mesh vk_primitives::shapes::Cube::getMesh()
+{
+	mesh::Mesh cube{};
+
+	//Linear search is fine for 36 vertices
+	for (const auto& vertex : getNonIndexedVertexData()) {
+		uint32_t index = 0;
+		while (index < cube._vertices.size()) {
+			const auto& other = cube._vertices[index];
+			if (other.position == vertex.position && other.normal == vertex.normal && other.texCoords == vertex.texCoords) {
+				break;
+			}
+			index++;
+		}
+
+		if (index == cube._vertices.size()) {
+			cube._vertices.push_back(vertex);
+		}
+		cube._indices.push_back(index);
+	}
+
+	return cube;
+}
@@ -13,6 +13,9 @@ namespace vk_primitives {
 			static std::vector<mesh::Vertex_F3_F3> getVertexData();
 			static std::vector<mesh::Vertex_F3_F3_F2> getNonIndexedVertexData();
 			static std::vector<uint32_t> getIndexData();
+
+			//Non indexed data with shared vertices welded, 24 vertices + 36 indices
+			static mesh::Mesh getMesh();
 		};
 
 	}